@@ -406,6 +406,7 @@ pos_completer_fzf_interface_init (PosCompleterInterface *iface)
   iface->feed_symbol = pos_completer_fzf_feed_symbol;
   iface->get_preedit = pos_completer_fzf_get_preedit;
   iface->set_preedit = pos_completer_fzf_set_preedit;
+  iface->set_completions = pos_completer_fzf_set_completions;
 }
 
 
@@ -71,6 +71,13 @@ pos_completer_hunspell_take_completions (PosCompleter *iface, GStrv completions)
 }
 
 
+static void
+pos_completer_hunspell_set_completions (PosCompleter *iface, GStrv completions)
+{
+  pos_completer_hunspell_take_completions (iface, g_strdupv (completions));
+}
+
+
 static const char *
 pos_completer_hunspell_get_preedit (PosCompleter *iface)
 {
@@ -334,6 +341,7 @@ pos_completer_hunspell_interface_init (PosCompleterInterface *iface)
   iface->feed_symbol = pos_completer_hunspell_feed_symbol;
   iface->get_preedit = pos_completer_hunspell_get_preedit;
   iface->set_preedit = pos_completer_hunspell_set_preedit;
+  iface->set_completions = pos_completer_hunspell_set_completions;
   iface->set_language = pos_completer_hunspell_set_language;
 }
 
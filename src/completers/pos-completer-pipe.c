@@ -365,6 +365,7 @@ pos_completer_pipe_interface_init (PosCompleterInterface *iface)
   iface->feed_symbol = pos_completer_pipe_feed_symbol;
   iface->get_preedit = pos_completer_pipe_get_preedit;
   iface->set_preedit = pos_completer_pipe_set_preedit;
+  iface->set_completions = pos_completer_pipe_set_completions;
 }
 
 
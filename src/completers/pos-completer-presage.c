@@ -20,6 +20,7 @@
 #include <gio/gio.h>
 
 #include <locale.h>
+#include <string.h>
 
 #define MAX_COMPLETIONS 3
 
@@ -63,7 +64,7 @@ struct _PosCompleterPresage {
   guint                 max_completions;
 
   presage_t             presage;
-  char                 *presage_past;
+  GString              *presage_past;
   char                 *presage_future;
 
   char                 *lang;
@@ -158,23 +159,39 @@ pos_completer_presage_get_after_text (PosCompleter *iface)
 }
 
 
+/* Whether @str holds the first @len bytes of @text */
+static gboolean
+text_equal (const char *str, const char *text, gssize len)
+{
+  if (str == NULL || text == NULL)
+    return str == text;
+
+  if (len < 0)
+    return g_str_equal (str, text);
+
+  return strncmp (str, text, len) == 0 && str[len] == '\0';
+}
+
+
 static void
 pos_completer_presage_set_surrounding_text (PosCompleter *iface,
                                             const char   *before_text,
-                                            const char   *after_text)
+                                            gssize        before_len,
+                                            const char   *after_text,
+                                            gssize        after_len)
 {
   PosCompleterPresage *self = POS_COMPLETER_PRESAGE (iface);
 
-  if (g_strcmp0 (self->after_text, after_text) == 0 &&
-      g_strcmp0 (self->before_text, before_text) == 0) {
+  if (text_equal (self->after_text, after_text, after_len) &&
+      text_equal (self->before_text, before_text, before_len)) {
     return;
   }
 
   g_free (self->after_text);
-  self->after_text = g_strdup (after_text);
+  self->after_text = after_text ? g_strndup (after_text, after_len < 0 ? G_MAXSSIZE : after_len) : NULL;
 
   g_free (self->before_text);
-  self->before_text = g_strdup (before_text);
+  self->before_text = before_text ? g_strndup (before_text, before_len < 0 ? G_MAXSSIZE : before_len) : NULL;
 
   pos_completer_presage_predict (self);
 
@@ -316,7 +333,7 @@ pos_completer_presage_finalize (GObject *object)
   g_string_free (self->preedit, TRUE);
   g_clear_pointer (&self->before_text, g_free);
   g_clear_pointer (&self->after_text, g_free);
-  g_clear_pointer (&self->presage_past, g_free);
+  g_string_free (self->presage_past, TRUE);
   g_clear_pointer (&self->presage_future, g_free);
   g_clear_pointer (&self->lang, g_free);
   presage_free (self->presage);
@@ -356,11 +373,14 @@ pos_completer_presage_get_past_stream (void *data)
 {
   PosCompleterPresage *self = POS_COMPLETER_PRESAGE (data);
 
-  g_free (self->presage_past);
-  self->presage_past = g_strdup_printf ("%s%s", self->before_text ?: "", self->preedit->str);
+  /* Called on every prediction so reuse the buffer */
+  g_string_truncate (self->presage_past, 0);
+  if (self->before_text)
+    g_string_append (self->presage_past, self->before_text);
+  g_string_append_len (self->presage_past, self->preedit->str, self->preedit->len);
 
-  g_debug ("Past: %s", self->presage_past);
-  return self->presage_past;
+  g_debug ("Past: %s", self->presage_past->str);
+  return self->presage_past->str;
 }
 
 
@@ -473,6 +493,7 @@ pos_completer_presage_interface_init (PosCompleterInterface *iface)
   iface->feed_symbol = pos_completer_presage_feed_symbol;
   iface->get_preedit = pos_completer_presage_get_preedit;
   iface->set_preedit = pos_completer_presage_set_preedit;
+  iface->set_completions = pos_completer_presage_set_completions;
   iface->get_before_text = pos_completer_presage_get_before_text;
   iface->get_after_text = pos_completer_presage_get_after_text;
   iface->set_surrounding_text = pos_completer_presage_set_surrounding_text;
@@ -485,6 +506,7 @@ pos_completer_presage_init (PosCompleterPresage *self)
 {
   self->max_completions = MAX_COMPLETIONS;
   self->preedit = g_string_new (NULL);
+  self->presage_past = g_string_new (NULL);
   self->name = "presage";
 }
 
@@ -79,6 +79,13 @@ pos_completer_varnam_take_completions (PosCompleter *iface, GStrv completions)
 }
 
 
+static void
+pos_completer_varnam_set_completions (PosCompleter *iface, GStrv completions)
+{
+  pos_completer_varnam_take_completions (iface, g_strdupv (completions));
+}
+
+
 static const char *
 pos_completer_varnam_get_preedit (PosCompleter *iface)
 {
@@ -362,6 +369,7 @@ pos_completer_varnam_interface_init (PosCompleterInterface *iface)
   iface->feed_symbol = pos_completer_varnam_feed_symbol;
   iface->get_preedit = pos_completer_varnam_get_preedit;
   iface->set_preedit = pos_completer_varnam_set_preedit;
+  iface->set_completions = pos_completer_varnam_set_completions;
   iface->set_language = pos_completer_varnam_set_language;
   iface->get_display_name = pos_completer_varnam_get_display_name;
   iface->learn_accepted = pos_completer_varnam_learn_accepted;
@@ -35,10 +35,22 @@ typedef enum {
  *   [signal@PosOskWiddget:key-up] for the old key and a
  *   [signal@PosOskWiddget:key-down] for the newly touched key. Without
  *   this flags the key press is canceled.
+ * PHOSH_OSK_FEATURE_ADAPTIVE_KEYS: When set touches close to a key's
+ *   border are resolved to the key that is more likely to be typed
+ *   next according to the current completer. The visible layout doesn't
+ *   change.
+ * PHOSH_OSK_FEATURE_SWIPE: When set swiping over character keys is decoded
+ *   into words (shape writing) instead of typing the individual keys.
+ * PHOSH_OSK_FEATURE_UNIFIED_KEYMAP: When set a single keymap covering all
+ *   configured layouts is sent to the compositor so switching layouts
+ *   doesn't require a keymap change.
  */
 typedef enum {
-  PHOSH_OSK_FEATURE_DEFAULT  = 0,        /*< skip >*/
-  PHOSH_OSK_FEATURE_KEY_DRAG = (1 << 0), /*< nick=key-drag >*/
+  PHOSH_OSK_FEATURE_DEFAULT        = 0,        /*< skip >*/
+  PHOSH_OSK_FEATURE_KEY_DRAG       = (1 << 0), /*< nick=key-drag >*/
+  PHOSH_OSK_FEATURE_ADAPTIVE_KEYS  = (1 << 1), /*< nick=adaptive-keys >*/
+  PHOSH_OSK_FEATURE_SWIPE          = (1 << 2), /*< nick=swipe >*/
+  PHOSH_OSK_FEATURE_UNIFIED_KEYMAP = (1 << 3), /*< nick=unified-keymap >*/
 } PhoshOskFeatures;
 
 G_END_DECLS
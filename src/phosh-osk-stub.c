@@ -41,12 +41,14 @@
  * @POS_DEBUG_FLAG_FORCE_SHOW: Ignore the `screen-keyboard-enabled` GSetting and always enable the OSK
  * @POS_DEBUG_FLAG_FORCE_COMPLETEION: Force text completion to on
  * @POS_DEBUG_FLAG_DEBUG_SURFACE: Enable the debug surface
+ * @POS_DEBUG_FLAG_LATENCY: Trace keystroke latencies, dump them and input method stats on `SIGUSR1`
  */
 typedef enum _PosDebugFlags {
   POS_DEBUG_FLAG_NONE              = 0,
   POS_DEBUG_FLAG_FORCE_SHOW        = 1 << 0,
   POS_DEBUG_FLAG_FORCE_COMPLETEION = 1 << 1,
   POS_DEBUG_FLAG_DEBUG_SURFACE     = 1 << 2,
+  POS_DEBUG_FLAG_LATENCY           = 1 << 3,
 } PosDebugFlags;
 
 
@@ -91,6 +93,27 @@ quit_cb (gpointer user_data)
 }
 
 
+static gboolean
+dump_latency_cb (gpointer user_data)
+{
+  g_autofree char *latencies = pos_latency_dump ();
+
+  g_message ("%s", latencies);
+
+  if (_input_surface) {
+    g_autoptr (PosInputMethod) im = NULL;
+    const PosInputMethodStats *stats;
+
+    g_object_get (_input_surface, "input-method", &im, NULL);
+    stats = pos_input_method_get_stats (im);
+    g_message ("Input method: %u actions in %u commits (%u forced flushes)",
+               stats->n_actions, stats->n_commits, stats->n_forced_flushes);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+
 static void
 respond_to_end_session (GDBusProxy *proxy, gboolean shutdown)
 {
@@ -462,6 +485,8 @@ static GDebugKey debug_keys[] =
     .value = POS_DEBUG_FLAG_FORCE_COMPLETEION,},
   { .key = "debug-surface",
     .value = POS_DEBUG_FLAG_DEBUG_SURFACE,},
+  { .key = "latency",
+    .value = POS_DEBUG_FLAG_LATENCY,},
 };
 
 static PosDebugFlags
@@ -532,6 +557,11 @@ main (int argc, char *argv[])
   g_unix_signal_add (SIGTERM, quit_cb, loop);
   g_unix_signal_add (SIGINT, quit_cb, loop);
 
+  if (_debug_flags & POS_DEBUG_FLAG_LATENCY) {
+    pos_latency_set_enabled (TRUE);
+    g_unix_signal_add (SIGUSR1, dump_latency_cb, NULL);
+  }
+
   g_main_loop_run (loop);
 
   if (_input_surface)
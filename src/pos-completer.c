@@ -12,10 +12,10 @@
 
 #include "pos-completer.h"
 #include "pos-completer-priv.h"
+#include "pos-latency.h"
+#include "pos-symbol.h"
 #include "util.h"
 
-#include <ctype.h>
-
 /**
  * PosCompleter:
  *
@@ -38,25 +38,6 @@
 
 G_DEFINE_INTERFACE (PosCompleter, pos_completer, G_TYPE_OBJECT)
 
-/* TODO: all the brackets, also language dependent */
-static const char * const completion_end_symbols[] = {
-  /* whitespace */
-  " ",
-  "\t",
-  "\n",
-  /* non-whitespace */
-  ".",
-  ",",
-  ";",
-  ":",
-  "?",
-  "!",
-  "(", ")",
-  "{", "}",
-  "[", "]",
-  NULL,
-};
-
 
 GQuark
 pos_completer_error_quark (void)
@@ -192,12 +173,16 @@ gboolean
 pos_completer_feed_symbol (PosCompleter *self, const char *symbol)
 {
   PosCompleterInterface *iface;
+  gboolean handled;
 
   g_return_val_if_fail (POS_IS_COMPLETER (self), FALSE);
 
   iface = POS_COMPLETER_GET_IFACE (self);
   g_return_val_if_fail (iface->feed_symbol != NULL, FALSE);
-  return iface->feed_symbol (self, symbol);
+  handled = iface->feed_symbol (self, symbol);
+  pos_latency_mark (POS_LATENCY_STAGE_COMPLETER);
+
+  return handled;
 }
 
 /**
@@ -219,6 +204,31 @@ pos_completer_get_completions (PosCompleter *self)
   return completions;
 }
 
+/**
+ * pos_completer_set_completions:
+ * @self: the completer
+ * @completions:(nullable): the completions
+ *
+ * Replaces the current completions. This allows users of the completer
+ * to offer candidates from other sources (e.g. words decoded from a
+ * swipe) via the [property@Completer:completions] property.
+ */
+void
+pos_completer_set_completions (PosCompleter *self, GStrv completions)
+{
+  PosCompleterInterface *iface;
+
+  g_return_if_fail (POS_IS_COMPLETER (self));
+
+  iface = POS_COMPLETER_GET_IFACE (self);
+  if (iface->set_completions == NULL) {
+    g_debug ("Completer %s can't take completions", pos_completer_get_name (self));
+    return;
+  }
+
+  iface->set_completions (self, completions);
+}
+
 /**
  * pos_completer_get_preedit:
  * @self: the completer
@@ -311,16 +321,21 @@ pos_completer_get_after_text (PosCompleter *self)
 /**
  * pos_completer_set_surrounding_text:
  * @self: the completer
- * @before_text: the text before the cursor
- * @after_text: the text after the cursor
+ * @before_text:(nullable): the text before the cursor
+ * @before_len: the length of @before_text in bytes or -1 if it's `NUL` terminated
+ * @after_text:(nullable): the text after the cursor
+ * @after_len: the length of @after_text in bytes or -1 if it's `NUL` terminated
  *
  * Set the text before and after the current cursor position. This can
- * be used by the completer to improve the prediction.
+ * be used by the completer to improve the prediction. The texts can
+ * be views into a larger buffer, completers copy what they keep.
  */
 void
 pos_completer_set_surrounding_text (PosCompleter *self,
                                     const char   *before_text,
-                                    const char   *after_text)
+                                    gssize        before_len,
+                                    const char   *after_text,
+                                    gssize        after_len)
 {
   PosCompleterInterface *iface;
 
@@ -331,7 +346,7 @@ pos_completer_set_surrounding_text (PosCompleter *self,
   if (iface->set_surrounding_text == NULL)
     return;
 
-  return iface->set_surrounding_text (self, before_text, after_text);
+  return iface->set_surrounding_text (self, before_text, before_len, after_text, after_len);
 }
 
 /**
@@ -371,6 +386,24 @@ pos_completer_set_language (PosCompleter *self,
 
 /* Used by completers to simplify implenetations */
 
+/*
+ * Gets the flags of @symbol without interning it, text that isn't a
+ * known symbol is classified by its code point.
+ */
+static PosSymbolFlags
+get_symbol_flags (const char *symbol, PosSymbol *id)
+{
+  *id = pos_symbol_lookup (symbol);
+  if (*id)
+    return pos_symbol_get_flags (*id);
+
+  if (*symbol && *g_utf8_next_char (symbol) == '\0')
+    return pos_symbol_get_unichar_flags (g_utf8_get_char (symbol));
+
+  return POS_SYMBOL_FLAG_NONE;
+}
+
+
 /**
  * pos_completer_add_preedit:
  * @self: the completer
@@ -393,12 +426,14 @@ pos_completer_set_language (PosCompleter *self,
 gboolean
 pos_completer_add_preedit (PosCompleter *self, GString *preedit, const char *symbol)
 {
-  gboolean is_ws;
+  PosSymbol id;
+  PosSymbolFlags flags;
 
   g_return_val_if_fail (POS_IS_COMPLETER (self), FALSE);
   g_return_val_if_fail (symbol, FALSE);
 
-  if (g_strcmp0 (symbol, "KEY_BACKSPACE") == 0 && preedit->len) {
+  flags = get_symbol_flags (symbol, &id);
+  if (id == POS_SYMBOL_KEY_BACKSPACE && preedit->len) {
     /* Remove last utf-8 character */
     const char *last = &preedit->str[preedit->len];
     const char *prev = g_utf8_find_prev_char (preedit->str, last);
@@ -408,18 +443,18 @@ pos_completer_add_preedit (PosCompleter *self, GString *preedit, const char *sym
   }
 
   /* Return/Enter is special, see above. */
-  if (g_strcmp0 (symbol, "KEY_ENTER") == 0) {
+  if (id == POS_SYMBOL_KEY_ENTER) {
     return TRUE;
   }
 
   /* Ignore all other special keys */
-  if (g_str_has_prefix (symbol, "KEY_"))
+  if (flags & POS_SYMBOL_FLAG_SPECIAL)
     return FALSE;
 
   g_string_append (preedit, symbol);
 
-  if (pos_completer_symbol_is_word_separator (symbol, &is_ws)) {
-    if (is_ws == FALSE)
+  if (flags & POS_SYMBOL_FLAG_SEPARATOR) {
+    if (!(flags & POS_SYMBOL_FLAG_WHITESPACE))
       g_string_append (preedit, " ");
     return TRUE;
   }
@@ -457,6 +492,98 @@ pos_completer_learn_accepted (PosCompleter *self, const char *word)
   return iface->learn_accepted (self, word);
 }
 
+
+/**
+ * pos_completer_next_chars_from_words:
+ * @prefix:(nullable): The prefix typed so far
+ * @words: The candidate words
+ * @weights:(nullable): The weight of each word. If %NULL words are
+ *   weighted by their rank.
+ *
+ * Estimates how likely each character is to be typed next by looking at
+ * the character following @prefix in all @words starting with @prefix.
+ * Matching is case insensitive and the characters are lower cased.
+ *
+ * Returns:(transfer full): A table mapping characters to their probability as `double *`
+ */
+GHashTable *
+pos_completer_next_chars_from_words (const char         *prefix,
+                                     const char * const *words,
+                                     const double       *weights)
+{
+  g_autoptr (GHashTable) next_chars = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                             g_free, g_free);
+  g_autofree char *folded_prefix = g_utf8_casefold (prefix ?: "", -1);
+  gsize prefix_len = strlen (folded_prefix);
+  GHashTableIter iter;
+  double *prob, total = 0.0;
+
+  for (int i = 0; words && words[i]; i++) {
+    g_autofree char *folded = g_utf8_casefold (words[i], -1);
+    double weight = weights ? weights[i] : 1.0 / (i + 1);
+    const char *next;
+    char *c;
+
+    if (!g_str_has_prefix (folded, folded_prefix) || folded[prefix_len] == '\0')
+      continue;
+
+    next = &folded[prefix_len];
+    c = g_utf8_strdown (next, g_utf8_next_char (next) - next);
+
+    prob = g_hash_table_lookup (next_chars, c);
+    if (prob == NULL) {
+      prob = g_new0 (double, 1);
+      g_hash_table_insert (next_chars, c, prob);
+    } else {
+      g_free (c);
+    }
+    *prob += weight;
+    total += weight;
+  }
+
+  if (total <= 0.0)
+    return g_steal_pointer (&next_chars);
+
+  g_hash_table_iter_init (&iter, next_chars);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&prob))
+    *prob /= total;
+
+  return g_steal_pointer (&next_chars);
+}
+
+
+/**
+ * pos_completer_get_next_chars:
+ * @self: the completer
+ *
+ * Gets the probabilities of the characters that might be typed next
+ * given the current preedit. Completers that have a language model can
+ * provide these directly, otherwise they're estimated from the current
+ * completions. This should be called when the completions change rather than
+ * when a key is pressed as completers might need to consult their engine.
+ *
+ * Returns:(transfer full): A table mapping lower cased characters to
+ *   their probability as `double *`
+ */
+GHashTable *
+pos_completer_get_next_chars (PosCompleter *self)
+{
+  PosCompleterInterface *iface;
+  g_auto (GStrv) completions = NULL;
+
+  g_return_val_if_fail (POS_IS_COMPLETER (self), NULL);
+
+  iface = POS_COMPLETER_GET_IFACE (self);
+  if (iface->get_next_chars)
+    return iface->get_next_chars (self);
+
+  completions = pos_completer_get_completions (self);
+  return pos_completer_next_chars_from_words (pos_completer_get_preedit (self),
+                                              (const char * const *)completions,
+                                              NULL);
+}
+
+
 /**
  * pos_completer_symbol_is_word_separator:
  * @symbol: the symbol to check
@@ -471,26 +598,13 @@ pos_completer_learn_accepted (PosCompleter *self, const char *word)
 gboolean
 pos_completer_symbol_is_word_separator (const char *symbol, gboolean *is_ws)
 {
-  static int nl = -1;
+  PosSymbol id;
+  PosSymbolFlags flags = get_symbol_flags (symbol, &id);
 
-  if (nl < 0) {
-    for (nl = 0; completion_end_symbols[nl]; nl++) {
-      if (!isspace (completion_end_symbols[nl][0]))
-        break;
-    }
-  }
   if (is_ws != NULL)
-    *is_ws = FALSE;
-
-  /* TODO: use hash table - or rather just use isalnum? */
-  for (int i = 0; completion_end_symbols[i]; i++) {
-    if (strcmp (symbol, completion_end_symbols[i]) == 0) {
-      if (i < nl && is_ws != NULL)
-        *is_ws = TRUE;
-      return TRUE;
-    }
-  }
-  return FALSE;
+    *is_ws = !!(flags & POS_SYMBOL_FLAG_WHITESPACE);
+
+  return !!(flags & POS_SYMBOL_FLAG_SEPARATOR);
 }
 
 /**
@@ -508,8 +622,7 @@ pos_completer_symbol_is_word_separator (const char *symbol, gboolean *is_ws)
 gboolean
 pos_completer_grab_last_word (const char *text, char **new_text, char **word)
 {
-  gsize len;
-  g_autofree char *symbol = NULL;
+  const char *last;
 
   g_return_val_if_fail (new_text && *new_text == NULL, FALSE);
   g_return_val_if_fail (word && *word == NULL, FALSE);
@@ -518,22 +631,23 @@ pos_completer_grab_last_word (const char *text, char **new_text, char **word)
   if (STR_IS_NULL_OR_EMPTY (text))
     return FALSE;
 
-  /* text ends with whitespace */
-  len = g_utf8_strlen (text, -1);
-  symbol = g_utf8_substring (text, len-1, len);
-  if (pos_completer_symbol_is_word_separator (symbol, NULL))
-    return FALSE;
-
   /* Get last word in text */
-  for (glong start = len - 1; start >= 0; start--) {
-    g_free (symbol);
-    symbol = g_utf8_substring (text, start, start+1);
-
-    if (pos_completer_symbol_is_word_separator (symbol, NULL)) {
-      *word = g_strdup (g_utf8_offset_to_pointer (text, start+1));
-      *new_text = g_utf8_substring (text, 0, start+1);
-      return TRUE;
-    }
+  last = g_utf8_find_prev_char (text, text + strlen (text));
+  for (const char *p = last; p; p = g_utf8_find_prev_char (text, p)) {
+    const char *next;
+
+    /* Client text, don't intern it */
+    if (!(pos_symbol_get_unichar_flags (g_utf8_get_char (p)) & POS_SYMBOL_FLAG_SEPARATOR))
+      continue;
+
+    /* text ends with whitespace */
+    if (p == last)
+      return FALSE;
+
+    next = g_utf8_next_char (p);
+    *word = g_strdup (next);
+    *new_text = g_strndup (text, next - text);
+    return TRUE;
   }
 
   /* No whitespace in text */
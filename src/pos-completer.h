@@ -50,14 +50,18 @@ struct _PosCompleterInterface
   const char *   (*get_before_text) (PosCompleter *self);
   const char *   (*get_after_text) (PosCompleter *self);
   void           (*set_surrounding_text) (PosCompleter *self,
-                                          const char *before_text,
-                                          const char *after_text);
+                                          const char   *before_text,
+                                          gssize        before_len,
+                                          const char   *after_text,
+                                          gssize        after_len);
   gboolean       (*set_language) (PosCompleter  *self,
                                   const char    *lang,
                                   const char    *region,
                                   GError       **error);
   char *         (*get_display_name) (PosCompleter *self);
   void           (*learn_accepted) (PosCompleter *self, const char *word);
+  GHashTable *   (*get_next_chars) (PosCompleter *self);
+  void           (*set_completions) (PosCompleter *self, GStrv completions);
 };
 
 /* Used by completion users */
@@ -69,14 +73,21 @@ void           pos_completer_set_preedit (PosCompleter *self, const char *preedi
 const char    *pos_completer_get_before_text (PosCompleter *self);
 const char    *pos_completer_get_after_text (PosCompleter *self);
 void           pos_completer_set_surrounding_text (PosCompleter *self,
-                                                   const char *before_text,
-                                                   const char *after_text);
+                                                   const char   *before_text,
+                                                   gssize        before_len,
+                                                   const char   *after_text,
+                                                   gssize        after_len);
 gboolean       pos_completer_set_language (PosCompleter  *self,
                                            const char    *lang,
                                            const char    *region,
                                            GError       **error);
 char          *pos_completer_get_display_name (PosCompleter *self);
 void           pos_completer_learn_accepted (PosCompleter *self, const char *word);
+GHashTable    *pos_completer_get_next_chars (PosCompleter *self);
+void           pos_completer_set_completions (PosCompleter *self, GStrv completions);
+GHashTable    *pos_completer_next_chars_from_words (const char         *prefix,
+                                                    const char * const *words,
+                                                    const double       *weights);
 
 GStrv          pos_completer_capitalize_by_template (const char *template,
                                                      const GStrv completions);
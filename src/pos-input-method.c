@@ -13,6 +13,7 @@
 #include "pos-enums.h"
 #include "pos-enum-types.h"
 #include "pos-input-method.h"
+#include "pos-latency.h"
 
 #include "input-method-unstable-v2-client-protocol.h"
 
@@ -40,6 +41,28 @@ static guint signals[N_SIGNALS];
 static void pos_im_state_free (PosImState *state);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (PosImState, pos_im_state_free);
 
+/**
+ * PosImTransaction:
+ * @commit_string: The text to commit or %NULL
+ * @preedit: The preedit or %NULL for none
+ * @preedit_cstart: Start of the preedit's cursor
+ * @preedit_cend: End of the preedit's cursor
+ * @delete_before: Bytes to delete before the cursor
+ * @delete_after: Bytes to delete after the cursor
+ * @n_actions: Number of actions merged into this transaction
+ *
+ * The requests that get applied by a single `commit`.
+ */
+typedef struct {
+  char  *commit_string;
+  char  *preedit;
+  guint  preedit_cstart;
+  guint  preedit_cend;
+  guint  delete_before;
+  guint  delete_after;
+  guint  n_actions;
+} PosImTransaction;
+
 /**
  * PosInputMethod:
  *
@@ -50,6 +73,11 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC (PosImState, pos_im_state_free);
  * The properties reflect applied state which is only updated
  * when the input method receives the `done` event form the
  * compositor.
+ *
+ * Each commit makes the compositor and client apply state and resend
+ * the surrounding text. So instead of sending a `commit` for each
+ * committed action the actions are merged into a batch that is sent
+ * with a single `commit` right before the next frame.
  */
 struct _PosInputMethod {
   GObject  parent;
@@ -62,6 +90,11 @@ struct _PosInputMethod {
   PosImState *submitted;
 
   guint       serial;
+
+  PosImTransaction    action;
+  PosImTransaction    batch;
+  guint               flush_id;
+  PosInputMethodStats stats;
 };
 G_DEFINE_TYPE (PosInputMethod, pos_input_method, G_TYPE_OBJECT)
 
@@ -69,7 +102,7 @@ G_DEFINE_TYPE (PosInputMethod, pos_input_method, G_TYPE_OBJECT)
 static void
 pos_im_state_free (PosImState *state)
 {
-  g_clear_pointer (&state->surrounding_text, g_free);
+  g_clear_pointer (&state->surrounding_text, pos_surrounding_text_unref);
   g_free (state);
 }
 
@@ -79,12 +112,72 @@ pos_im_state_dup (PosImState *state)
 {
   PosImState *new = g_memdup2 (state, sizeof (PosImState));
 
-  new->surrounding_text = g_strdup (state->surrounding_text);
+  /* The text is immutable so pending and submitted state can share it */
+  if (state->surrounding_text)
+    new->surrounding_text = pos_surrounding_text_ref (state->surrounding_text);
 
   return new;
 }
 
 
+static void
+pos_im_transaction_clear (PosImTransaction *transaction)
+{
+  g_free (transaction->commit_string);
+  g_free (transaction->preedit);
+  *transaction = (PosImTransaction) { 0 };
+}
+
+
+/*
+ * Merge @action into @batch so that sending @batch has the same effect
+ * as sending both one after another. Returns %FALSE if that's not
+ * possible.
+ */
+static gboolean
+pos_im_transaction_merge (PosImTransaction *batch, PosImTransaction *action)
+{
+  /* The protocol deletes before inserting the commit string */
+  if ((action->delete_before || action->delete_after) && batch->commit_string)
+    return FALSE;
+
+  batch->delete_before += action->delete_before;
+  batch->delete_after += action->delete_after;
+
+  if (batch->commit_string && action->commit_string) {
+    char *commit_string = g_strconcat (batch->commit_string, action->commit_string, NULL);
+
+    g_free (batch->commit_string);
+    batch->commit_string = commit_string;
+  } else if (action->commit_string) {
+    batch->commit_string = g_steal_pointer (&action->commit_string);
+  }
+
+  /* Each commit replaces the preedit so the last one wins */
+  g_free (batch->preedit);
+  batch->preedit = g_steal_pointer (&action->preedit);
+  batch->preedit_cstart = action->preedit_cstart;
+  batch->preedit_cend = action->preedit_cend;
+
+  batch->n_actions++;
+  pos_im_transaction_clear (action);
+
+  return TRUE;
+}
+
+
+static gboolean
+on_flush_idle (gpointer data)
+{
+  PosInputMethod *self = POS_INPUT_METHOD (data);
+
+  self->flush_id = 0;
+  pos_input_method_flush (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+
 static void
 handle_activate (void                       *data,
                  struct zwp_input_method_v2 *zwp_input_method_v2)
@@ -97,7 +190,7 @@ handle_activate (void                       *data,
     return;
 
   self->pending->active = TRUE;
-  g_clear_pointer (&self->pending->surrounding_text, g_free);
+  g_clear_pointer (&self->pending->surrounding_text, pos_surrounding_text_unref);
   self->pending->text_change_cause = POS_INPUT_METHOD_TEXT_CHANGE_CAUSE_IM;
   self->pending->purpose = POS_INPUT_METHOD_PURPOSE_NORMAL;
   self->pending->hint = POS_INPUT_METHOD_HINT_NONE;
@@ -129,17 +222,17 @@ handle_surrounding_text (void                       *data,
                          uint32_t                    anchor)
 {
   PosInputMethod *self = POS_INPUT_METHOD (data);
+  PosSurroundingText *pending = self->pending->surrounding_text;
 
   g_debug ("%s: '%s', cursor %d, anchor: %d", __func__, text, cursor, anchor);
-  if (g_strcmp0 (self->pending->surrounding_text, text) == 0 &&
-      self->pending->cursor == cursor &&
-      self->pending->anchor == anchor)
+  if (pending &&
+      pos_surrounding_text_get_cursor (pending) == cursor &&
+      pos_surrounding_text_get_anchor (pending) == anchor &&
+      g_strcmp0 (pos_surrounding_text_get_text (pending, NULL), text) == 0)
     return;
 
-  g_free (self->pending->surrounding_text);
-  self->pending->surrounding_text = g_strdup (text);
-  self->pending->cursor = cursor;
-  self->pending->anchor = anchor;
+  g_clear_pointer (&self->pending->surrounding_text, pos_surrounding_text_unref);
+  self->pending->surrounding_text = pos_surrounding_text_new (text, cursor, anchor);
   g_signal_emit (self, signals[PENDING_CHANGED], 0, self->pending);
 }
 
@@ -188,19 +281,28 @@ handle_done (void                       *data,
   g_autoptr (PosImState) current = self->submitted;
 
   g_debug ("%s", __func__);
+  pos_latency_mark (POS_LATENCY_STAGE_DONE);
 
   self->serial++;
   g_object_freeze_notify (G_OBJECT (self));
 
   self->submitted = pos_im_state_dup (self->pending);
 
-  if (current->active != self->submitted->active)
+  if (current->active != self->submitted->active) {
+    /* Anything not sent yet was meant for the text input that's gone now */
+    g_clear_handle_id (&self->flush_id, g_source_remove);
+    pos_im_transaction_clear (&self->action);
+    pos_im_transaction_clear (&self->batch);
     g_object_notify_by_pspec (G_OBJECT (self), props[PROP_ACTIVE]);
+  }
 
-  if (g_strcmp0 (current->surrounding_text, self->submitted->surrounding_text) ||
-      current->cursor != self->submitted->cursor ||
-      current->anchor != self->submitted->anchor)
+  if (!pos_surrounding_text_equal (current->surrounding_text, self->submitted->surrounding_text)) {
+    if (self->submitted->surrounding_text) {
+      pos_surrounding_text_set_previous (self->submitted->surrounding_text,
+                                         current->surrounding_text);
+    }
     g_object_notify_by_pspec (G_OBJECT (self), props[PROP_SURROUNDING_TEXT]);
+  }
 
   if (current->text_change_cause != self->submitted->text_change_cause)
     g_object_notify_by_pspec (G_OBJECT (self), props[PROP_TEXT_CHANGE_CAUSE]);
@@ -271,7 +373,9 @@ pos_input_method_get_property (GObject    *object,
     g_value_set_boolean (value, self->submitted->active);
     break;
   case PROP_SURROUNDING_TEXT:
-    g_value_set_string (value, self->submitted->surrounding_text);
+    g_value_set_string (value, self->submitted->surrounding_text ?
+                        pos_surrounding_text_get_text (self->submitted->surrounding_text, NULL) :
+                        NULL);
     break;
   case PROP_TEXT_CHANGE_CAUSE:
     g_value_set_enum (value, self->submitted->text_change_cause);
@@ -310,6 +414,9 @@ pos_input_method_finalize (GObject *object)
 {
   PosInputMethod *self = POS_INPUT_METHOD(object);
 
+  g_clear_handle_id (&self->flush_id, g_source_remove);
+  pos_im_transaction_clear (&self->action);
+  pos_im_transaction_clear (&self->batch);
   g_clear_pointer (&self->submitted, pos_im_state_free);
   g_clear_pointer (&self->pending, pos_im_state_free);
   g_clear_pointer (&self->input_method, zwp_input_method_v2_destroy);
@@ -491,13 +598,35 @@ pos_input_method_get_hint (PosInputMethod *self)
 const char *
 pos_input_method_get_surrounding_text (PosInputMethod *self, guint *anchor, guint *cursor)
 {
+  PosSurroundingText *surrounding_text;
+
   g_return_val_if_fail (POS_IS_INPUT_METHOD (self), NULL);
 
+  surrounding_text = self->submitted->surrounding_text;
+
   if (anchor)
-    *anchor = self->submitted->anchor;
+    *anchor = surrounding_text ? pos_surrounding_text_get_anchor (surrounding_text) : 0;
 
   if (cursor)
-    *cursor = self->submitted->cursor;
+    *cursor = surrounding_text ? pos_surrounding_text_get_cursor (surrounding_text) : 0;
+
+  return surrounding_text ? pos_surrounding_text_get_text (surrounding_text, NULL) : NULL;
+}
+
+/**
+ * pos_input_method_get_surrounding:
+ * @self: The input method
+ *
+ * Gets the applied surrounding text. Use this over
+ * [method@InputMethod.get_surrounding_text] to get views into the text
+ * or what changed since the last `done` event.
+ *
+ * Returns:(transfer none)(nullable): The surrounding text
+ */
+PosSurroundingText *
+pos_input_method_get_surrounding (PosInputMethod *self)
+{
+  g_return_val_if_fail (POS_IS_INPUT_METHOD (self), NULL);
 
   return self->submitted->surrounding_text;
 }
@@ -514,14 +643,17 @@ pos_input_method_get_serial (PosInputMethod *self)
  * pos_input_method_send_string:
  * @self: The input method
  * @string: The text to send
- * @commit: Whether to invoke `commit` request as well
+ * @commit: Whether to commit the current action as well
  *
  * This sends the given text via a `commit_string` request.
  */
 void
 pos_input_method_send_string (PosInputMethod *self, const char *string, gboolean commit)
 {
-  zwp_input_method_v2_commit_string (self->input_method, string);
+  g_return_if_fail (POS_IS_INPUT_METHOD (self));
+
+  g_free (self->action.commit_string);
+  self->action.commit_string = g_strdup (string);
   if (commit)
     pos_input_method_commit (self);
 }
@@ -532,7 +664,7 @@ pos_input_method_send_string (PosInputMethod *self, const char *string, gboolean
  * @preedit: The preedit to send
  * @cstart: The start of the cursor
  * @cend: The end of the cursor
- * @commit: Whether to invoke `commit` request as well
+ * @commit: Whether to commit the current action as well
  *
  * This sends the given text via a `set_preedit_string` request.
  */
@@ -540,7 +672,12 @@ void
 pos_input_method_send_preedit (PosInputMethod *self, const char *preedit,
                                guint cstart, guint cend, gboolean commit)
 {
-  zwp_input_method_v2_set_preedit_string (self->input_method, preedit, cstart, cend);
+  g_return_if_fail (POS_IS_INPUT_METHOD (self));
+
+  g_free (self->action.preedit);
+  self->action.preedit = g_strdup (preedit);
+  self->action.preedit_cstart = cstart;
+  self->action.preedit_cend = cend;
   if (commit)
     pos_input_method_commit (self);
 }
@@ -550,7 +687,7 @@ pos_input_method_send_preedit (PosInputMethod *self, const char *preedit,
  * @self: The input method
  * @before_length: Number of bytes before cursor to delete
  * @after_length: Number of bytes after cursor to delete
- * @commit: Whether to invoke `commit` request as well
+ * @commit: Whether to commit the current action as well
  *
  * This deletes text around the cursor using the `delete_surrounding_text` request.
  */
@@ -560,7 +697,10 @@ pos_input_method_delete_surrounding_text (PosInputMethod *self,
                                           guint after_length,
                                           gboolean commit)
 {
-  zwp_input_method_v2_delete_surrounding_text (self->input_method, before_length, after_length);
+  g_return_if_fail (POS_IS_INPUT_METHOD (self));
+
+  self->action.delete_before = before_length;
+  self->action.delete_after = after_length;
   if (commit)
     pos_input_method_commit (self);
 }
@@ -569,12 +709,86 @@ pos_input_method_delete_surrounding_text (PosInputMethod *self,
  * pos_input_method_commit:
  * @self: The input method
  *
- * Sends a `commit` request to the compositor so that any pending
- * `commit_string`, `set_preedit_string` and `delete_surrounding_text`.
- * changes get applied.
+ * Commits the current action so that any pending `commit_string`,
+ * `set_preedit_string` and `delete_surrounding_text` changes get
+ * applied. The action is batched with other actions and sent to the
+ * compositor with a single `commit` request right before the next
+ * frame. Use [method@InputMethod.flush] to send it right away.
  */
 void
 pos_input_method_commit (PosInputMethod *self)
 {
+  g_return_if_fail (POS_IS_INPUT_METHOD (self));
+
+  pos_latency_mark (POS_LATENCY_STAGE_COMMIT);
+  self->stats.n_actions++;
+
+  if (!pos_im_transaction_merge (&self->batch, &self->action)) {
+    self->stats.n_forced_flushes++;
+    pos_input_method_flush (self);
+    pos_im_transaction_merge (&self->batch, &self->action);
+  }
+
+  if (self->flush_id)
+    return;
+
+  /* Before GTK redraws */
+  self->flush_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE + 10, on_flush_idle, self, NULL);
+  g_source_set_name_by_id (self->flush_id, "[pos-im-flush]");
+}
+
+/**
+ * pos_input_method_flush:
+ * @self: The input method
+ *
+ * Sends all committed actions to the compositor right away. Use this
+ * before sending input by other means (e.g. the virtual keyboard)
+ * to keep things in order.
+ */
+void
+pos_input_method_flush (PosInputMethod *self)
+{
+  PosImTransaction *batch = &self->batch;
+
+  g_return_if_fail (POS_IS_INPUT_METHOD (self));
+
+  g_clear_handle_id (&self->flush_id, g_source_remove);
+
+  if (batch->n_actions == 0)
+    return;
+
+  if (batch->delete_before || batch->delete_after) {
+    zwp_input_method_v2_delete_surrounding_text (self->input_method,
+                                                 batch->delete_before,
+                                                 batch->delete_after);
+  }
+  if (batch->commit_string)
+    zwp_input_method_v2_commit_string (self->input_method, batch->commit_string);
+  if (batch->preedit) {
+    zwp_input_method_v2_set_preedit_string (self->input_method, batch->preedit,
+                                            batch->preedit_cstart, batch->preedit_cend);
+  }
   zwp_input_method_v2_commit (self->input_method, self->serial);
+  pos_latency_mark (POS_LATENCY_STAGE_FLUSH);
+
+  self->stats.n_commits++;
+
+  pos_im_transaction_clear (batch);
+}
+
+/**
+ * pos_input_method_get_stats:
+ * @self: The input method
+ *
+ * Gets statistics about how actions got batched. Useful for
+ * debugging.
+ *
+ * Returns: The statistics
+ */
+const PosInputMethodStats *
+pos_input_method_get_stats (PosInputMethod *self)
+{
+  g_return_val_if_fail (POS_IS_INPUT_METHOD (self), NULL);
+
+  return &self->stats;
 }
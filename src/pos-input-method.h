@@ -7,6 +7,7 @@
 #pragma once
 
 #include "pos-enums.h"
+#include "pos-surrounding-text.h"
 
 #include <glib-object.h>
 
@@ -14,14 +15,27 @@ G_BEGIN_DECLS
 
 typedef struct _PosImState {
   gboolean  active;
-  char     *surrounding_text;
-  guint     anchor;
-  guint     cursor;
+  PosSurroundingText *surrounding_text;
   PosInputMethodTextChangeCause text_change_cause;
   PosInputMethodPurpose purpose;
   PosInputMethodHint hint;
 } PosImState;
 
+/**
+ * PosInputMethodStats:
+ * @n_actions: Number of committed actions
+ * @n_commits: Number of `commit` requests sent to the compositor
+ * @n_forced_flushes: Number of times a batch had to be sent early as
+ *   an action couldn't be merged into it
+ *
+ * Statistics about batching committed actions.
+ */
+typedef struct {
+  guint n_actions;
+  guint n_commits;
+  guint n_forced_flushes;
+} PosInputMethodStats;
+
 #define POS_TYPE_INPUT_METHOD (pos_input_method_get_type ())
 
 G_DECLARE_FINAL_TYPE (PosInputMethod, pos_input_method, POS, INPUT_METHOD, GObject)
@@ -34,6 +48,7 @@ PosInputMethodHint             pos_input_method_get_hint (PosInputMethod *self);
 const char                    *pos_input_method_get_surrounding_text (PosInputMethod *self,
                                                                       guint *anchor,
                                                                       guint *cursor);
+PosSurroundingText            *pos_input_method_get_surrounding (PosInputMethod *self);
 guint                          pos_input_method_get_serial (PosInputMethod *self);
 
 void                           pos_input_method_send_string (PosInputMethod *self,
@@ -49,4 +64,6 @@ void                          pos_input_method_delete_surrounding_text (PosInput
                                                                         guint after_length,
                                                                         gboolean commit);
 void                          pos_input_method_commit (PosInputMethod *self);
+void                          pos_input_method_flush (PosInputMethod *self);
+const PosInputMethodStats    *pos_input_method_get_stats (PosInputMethod *self);
 G_END_DECLS
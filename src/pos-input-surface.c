@@ -19,12 +19,16 @@
 #include "pos-completer-manager.h"
 #include "pos-completion-bar.h"
 #include "pos-input-surface.h"
+#include "pos-latency.h"
 #include "pos-logind-session.h"
 #include "pos-main.h"
+#include "pos-osk-key.h"
 #include "pos-osk-widget.h"
 #include "pos-settings-panel.h"
 #include "pos-shortcuts-bar.h"
 #include "pos-style-manager.h"
+#include "pos-swipe-decoder.h"
+#include "pos-symbol.h"
 #include "pos-vk-driver.h"
 #include "pos-virtual-keyboard.h"
 #include "pos-vk-driver.h"
@@ -49,6 +53,9 @@
 #define POS_INPUT_SURFACE_IS_LANG_LAYOUT(widget) \
   (POS_IS_OSK_WIDGET ((widget)) && GTK_WIDGET ((widget)) != self->osk_terminal)
 
+/* How much of the surrounding text completers get to see (in bytes) */
+#define COMPLETION_CONTEXT_LEN 256
+
 /**
  * POS_INPUT_SURFACE_IS_TERMINAL_LAYOUT:
  * @layout: The layout to check
@@ -108,6 +115,8 @@ struct _PosInputSurface {
 
   /* Wayland input-method */
   PosInputMethod          *input_method;
+  /* Bytes deleted before the cursor that aren't in the surrounding text yet */
+  guint                    unapplied_deletion;
 
   /* OSK */
   GHashTable              *osks;
@@ -121,6 +130,9 @@ struct _PosInputSurface {
 
   /* TODO: this should be an interface for different keyboard drivers */
   PosVkDriver             *keyboard_driver;
+  /* Keymap covering all language layouts, see PHOSH_OSK_FEATURE_UNIFIED_KEYMAP */
+  char                    *unified_keymap_id;
+  GStrv                    unified_keymap_symbols;
 
   PosStyleManager         *style_manager;
 
@@ -137,6 +149,11 @@ struct _PosInputSurface {
   gboolean                 completion_enabled;
   PhoshOskCompletionModeFlags completion_mode;
 
+  /* Shape writing */
+  PosSwipeDecoder         *swipe_decoder;
+  /* Without an input method there's no surrounding text to check for separators */
+  gboolean                 vk_swiped_last;
+
   /* Clipboard */
   PosClipboardManager    *clipboard_manager;
 
@@ -189,6 +206,8 @@ on_shortcut_activated (PosInputSurface *self, PosShortcut *shortcut, PosShortcut
   g_return_if_fail (POS_IS_INPUT_SURFACE (self));
   g_return_if_fail (POS_IS_SHORTCUTS_BAR (bar));
 
+  /* Keep keys in order with text committed via the input method */
+  pos_input_method_flush (self->input_method);
   pos_vk_driver_key_press_gdk (self->keyboard_driver,
                                pos_shortcut_get_key (shortcut),
                                pos_shortcut_get_modifiers (shortcut) | self->latched_modifiers);
@@ -314,6 +333,23 @@ on_completer_preedit_changed (PosInputSurface *self)
 }
 
 
+static void
+pos_input_surface_update_next_chars (PosInputSurface *self)
+{
+  GtkWidget *osk_widget = hdy_deck_get_visible_child (self->deck);
+  g_autoptr (GHashTable) next_chars = NULL;
+
+  if (POS_IS_OSK_WIDGET (osk_widget) == FALSE)
+    return;
+
+  if ((self->osk_features & PHOSH_OSK_FEATURE_ADAPTIVE_KEYS) &&
+      pos_input_surface_is_completion_mode (self))
+    next_chars = pos_completer_get_next_chars (self->completer);
+
+  pos_osk_widget_set_next_chars (POS_OSK_WIDGET (osk_widget), next_chars);
+}
+
+
 static void
 on_completer_completions_changed (PosInputSurface *self)
 {
@@ -321,6 +357,8 @@ on_completer_completions_changed (PosInputSurface *self)
 
   pos_completion_bar_set_completions (POS_COMPLETION_BAR (self->completion_bar),
                                       completions);
+  pos_latency_mark (POS_LATENCY_STAGE_COMPLETIONS);
+  pos_input_surface_update_next_chars (self);
 }
 
 
@@ -376,17 +414,21 @@ static void
 on_osk_key_symbol (PosInputSurface *self, const char *symbol, GtkWidget *osk_widget)
 {
   gboolean handled;
+  PosSymbol id;
 
   g_return_if_fail (POS_IS_INPUT_SURFACE (self));
   g_return_if_fail (osk_widget == NULL || POS_IS_OSK_WIDGET (osk_widget));
 
   g_debug ("Key: '%s' symbol", symbol);
+  pos_latency_mark (POS_LATENCY_STAGE_SYMBOL);
+  self->vk_swiped_last = FALSE;
 
   /* Latched modifiers, send as virtual-keyboard */
   if (self->latched_modifiers) {
     PosKeycodeModifier modifier;
 
     modifier = pos_vk_driver_convert_modifiers (self->keyboard_driver, self->latched_modifiers);
+    pos_input_method_flush (self->input_method);
     pos_vk_driver_key_down (self->keyboard_driver, symbol, modifier);
     pos_vk_driver_key_up (self->keyboard_driver, symbol);
     pos_input_surface_unlatch_modifiers (self);
@@ -405,7 +447,10 @@ on_osk_key_symbol (PosInputSurface *self, const char *symbol, GtkWidget *osk_wid
       return;
   }
 
-  if (g_str_has_prefix (symbol, "KEY_")) {
+  /* Layout symbols are known already, anything else is text */
+  id = pos_symbol_lookup (symbol);
+  if (id && pos_symbol_get_flags (id) & POS_SYMBOL_FLAG_SPECIAL) {
+    pos_input_method_flush (self->input_method);
     pos_vk_driver_key_down (self->keyboard_driver, symbol, POS_KEYCODE_MODIFIER_NONE);
     pos_vk_driver_key_up (self->keyboard_driver, symbol);
   } else {
@@ -417,6 +462,223 @@ on_osk_key_symbol (PosInputSurface *self, const char *symbol, GtkWidget *osk_wid
 }
 
 
+/* Number of bytes to delete before @end: the last character or word */
+static guint
+count_delete_bytes (const char *text, guint end, gboolean words)
+{
+  const char *p = text + end;
+  gboolean in_word = FALSE;
+
+  if (end == 0)
+    return 0;
+
+  if (!words)
+    return p - g_utf8_find_prev_char (text, p);
+
+  /* Like ctrl+backspace: skip anything that isn't a word, then the word */
+  while (p > text) {
+    const char *prev = g_utf8_find_prev_char (text, p);
+    gunichar c = g_utf8_get_char (prev);
+    gboolean is_word = g_unichar_isalnum (c) || c == '_';
+
+    if (in_word && !is_word)
+      break;
+
+    in_word |= is_word;
+    p = prev;
+  }
+
+  return (text + end) - p;
+}
+
+
+/*
+ * Queue deleting the character or word before the cursor based on
+ * the surrounding text. The input method batches the deletions of a
+ * frame into a single request. Returns %FALSE if the deletion can't be
+ * handled that way (e.g. the client doesn't send surrounding text).
+ */
+static gboolean
+pos_input_surface_queue_deletion (PosInputSurface *self, gboolean words)
+{
+  const char *text;
+  guint anchor, cursor, deleted, n_bytes;
+
+  text = pos_input_method_get_surrounding_text (self->input_method, &anchor, &cursor);
+  if (text == NULL)
+    return FALSE;
+
+  deleted = self->unapplied_deletion;
+  /* Deleting a selection is up to the client */
+  if (anchor != cursor && deleted == 0)
+    return FALSE;
+
+  if (deleted >= cursor)
+    return TRUE;
+
+  n_bytes = count_delete_bytes (text, cursor - deleted, words);
+  g_debug ("Deleting %u bytes", n_bytes);
+  pos_input_method_delete_surrounding_text (self->input_method, n_bytes, 0, TRUE);
+  self->unapplied_deletion += n_bytes;
+
+  return TRUE;
+}
+
+
+/*
+ * Account for the deletions the new surrounding text reflects. Anything
+ * else changing the text makes the deletions not applied yet unknown
+ * so they're dropped.
+ */
+static void
+pos_input_surface_update_unapplied_deletion (PosInputSurface *self, PosSurroundingText *text)
+{
+  guint n_removed, n_inserted;
+
+  if (self->unapplied_deletion == 0)
+    return;
+
+  if (text == NULL ||
+      !pos_surrounding_text_get_delta (text, NULL, &n_removed, &n_inserted) ||
+      n_inserted || n_removed == 0 || n_removed > self->unapplied_deletion) {
+    self->unapplied_deletion = 0;
+    return;
+  }
+
+  self->unapplied_deletion -= n_removed;
+}
+
+
+static void
+on_osk_delete_repeat (PosInputSurface *self, gboolean words, GtkWidget *osk_widget)
+{
+  const char *backspace = pos_symbol_to_string (POS_SYMBOL_KEY_BACKSPACE);
+
+  g_return_if_fail (POS_IS_INPUT_SURFACE (self));
+  g_return_if_fail (POS_IS_OSK_WIDGET (osk_widget));
+
+  if (self->latched_modifiers) {
+    on_osk_key_symbol (self, backspace, osk_widget);
+    return;
+  }
+
+  /* virtual-keyboard, no input method */
+  if (!pos_input_method_get_active (self->input_method)) {
+    self->vk_swiped_last = FALSE;
+    pos_vk_driver_key_down (self->keyboard_driver, backspace,
+                            words ? POS_KEYCODE_MODIFIER_CTRL : POS_KEYCODE_MODIFIER_NONE);
+    pos_vk_driver_key_up (self->keyboard_driver, backspace);
+    return;
+  }
+
+  /* Delete from preedit first */
+  if (pos_input_surface_is_completion_mode (self) &&
+      !STR_IS_NULL_OR_EMPTY (pos_completer_get_preedit (self->completer))) {
+    if (words)
+      pos_completer_set_preedit (self->completer, NULL);
+    else
+      pos_completer_feed_symbol (self->completer, backspace);
+    return;
+  }
+
+  if (pos_input_surface_queue_deletion (self, words))
+    return;
+
+  on_osk_key_symbol (self, backspace, osk_widget);
+}
+
+
+static void
+on_osk_cursor_motion (PosInputSurface *self, int dx, int dy, GtkWidget *osk_widget)
+{
+  g_return_if_fail (POS_IS_INPUT_SURFACE (self));
+  g_return_if_fail (POS_IS_OSK_WIDGET (osk_widget));
+
+  self->vk_swiped_last = FALSE;
+  pos_input_method_flush (self->input_method);
+  /* All steps of a frame go out as one batch */
+  if (dx) {
+    pos_vk_driver_key_press_repeated (self->keyboard_driver,
+                                      dx < 0 ? POS_OSK_SYMBOL_LEFT : POS_OSK_SYMBOL_RIGHT,
+                                      ABS (dx));
+  }
+  if (dy) {
+    pos_vk_driver_key_press_repeated (self->keyboard_driver,
+                                      dy < 0 ? POS_OSK_SYMBOL_UP : POS_OSK_SYMBOL_DOWN,
+                                      ABS (dy));
+  }
+
+  if (pos_input_surface_is_completer_active (self))
+    pos_completer_set_preedit (self->completer, NULL);
+}
+
+
+static void set_keymap_delayed (PosInputSurface *self);
+
+
+/* Whether the text before the cursor needs a space before a swiped word */
+static gboolean
+pos_input_surface_swipe_needs_separator (PosInputSurface *self)
+{
+  PosSurroundingText *surrounding_text = pos_input_method_get_surrounding (self->input_method);
+  const char *before, *last;
+  gsize len;
+
+  if (surrounding_text == NULL)
+    return FALSE;
+
+  before = pos_surrounding_text_get_before (surrounding_text, 8, &len);
+  last = g_utf8_find_prev_char (before, before + len);
+  if (last == NULL)
+    return FALSE;
+
+  return !g_unichar_isspace (g_utf8_get_char (last));
+}
+
+
+static void
+on_osk_swipe (PosInputSurface *self, GStrv words, GtkWidget *osk_widget)
+{
+  g_return_if_fail (POS_IS_INPUT_SURFACE (self));
+  g_return_if_fail (POS_IS_OSK_WIDGET (osk_widget));
+  g_return_if_fail (words && words[0]);
+
+  g_debug ("Swiped '%s'", words[0]);
+
+  /* virtual-keyboard, no input method */
+  if (!pos_input_method_get_active (self->input_method)) {
+    g_autofree char *text = NULL;
+
+    /* Separate consecutive swiped words like with an input method */
+    text = g_strconcat (self->vk_swiped_last ? " " : "", words[0], NULL);
+    self->vk_swiped_last = TRUE;
+    if (pos_vk_driver_type_string (self->keyboard_driver, text))
+      set_keymap_delayed (self);
+    return;
+  }
+
+  self->vk_swiped_last = FALSE;
+
+  /* A swipe always starts a new word */
+  if (pos_input_surface_is_completion_mode (self) &&
+      !STR_IS_NULL_OR_EMPTY (pos_completer_get_preedit (self->completer))) {
+    pos_input_surface_submit_current_preedit (self);
+    pos_input_method_send_string (self->input_method, " ", TRUE);
+  } else if (pos_input_surface_swipe_needs_separator (self)) {
+    pos_input_method_send_string (self->input_method, " ", TRUE);
+  }
+
+  if (!pos_input_surface_is_completion_mode (self)) {
+    pos_input_method_send_string (self->input_method, words[0], TRUE);
+    return;
+  }
+
+  /* Offer the best match as preedit and the others in the completion bar */
+  pos_completer_set_preedit (self->completer, words[0]);
+  pos_completer_set_completions (self->completer, words);
+}
+
+
 static void
 set_keymap (PosInputSurface *self)
 {
@@ -435,6 +697,11 @@ set_keymap (PosInputSurface *self)
   osk = POS_OSK_WIDGET (child);
   if (osk == POS_OSK_WIDGET (self->osk_terminal)) {
     pos_vk_driver_set_terminal_keymap (self->keyboard_driver);
+  } else if (self->unified_keymap_id) {
+    /* Same id for all layouts so switching between them is a no-op */
+    pos_vk_driver_set_keymap_symbols (self->keyboard_driver,
+                                      self->unified_keymap_id,
+                                      (const char * const *)self->unified_keymap_symbols);
   } else {
     pos_vk_driver_set_keymap_symbols (self->keyboard_driver,
                                       pos_osk_widget_get_layout_id (osk),
@@ -443,6 +710,73 @@ set_keymap (PosInputSurface *self)
 }
 
 
+static int
+compare_layout_id (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (pos_osk_widget_get_layout_id ((PosOskWidget *)a),
+                    pos_osk_widget_get_layout_id ((PosOskWidget *)b));
+}
+
+
+/*
+ * Build the union of the symbols of all language layouts so one keymap
+ * can serve them all. Falls back to per layout keymaps when the union
+ * doesn't fit.
+ */
+static void
+pos_input_surface_update_unified_keymap (PosInputSurface *self)
+{
+  g_autoptr (GPtrArray) layout_ids = g_ptr_array_new ();
+  g_autoptr (GHashTable) seen = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autoptr (GStrvBuilder) builder = g_strv_builder_new ();
+  g_autoptr (GString) id = g_string_new ("unified");
+  g_auto (GStrv) symbols = NULL;
+  GHashTableIter iter;
+  PosOskWidget *osk;
+  guint n_symbols = 0;
+
+  g_clear_pointer (&self->unified_keymap_id, g_free);
+  g_clear_pointer (&self->unified_keymap_symbols, g_strfreev);
+
+  if (!(self->osk_features & PHOSH_OSK_FEATURE_UNIFIED_KEYMAP) || self->keyboard_driver == NULL)
+    return;
+
+  /* Sort by layout id so the same layouts always give the same keymap */
+  g_hash_table_iter_init (&iter, self->osks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&osk)) {
+    if (POS_INPUT_SURFACE_IS_LANG_LAYOUT (osk))
+      g_ptr_array_add (layout_ids, osk);
+  }
+  g_ptr_array_sort_values (layout_ids, compare_layout_id);
+
+  for (guint i = 0; i < layout_ids->len; i++) {
+    const char *const *layout_symbols;
+
+    osk = g_ptr_array_index (layout_ids, i);
+    g_string_append_printf (id, "+%s", pos_osk_widget_get_layout_id (osk));
+
+    layout_symbols = pos_osk_widget_get_symbols (osk);
+    for (int j = 0; layout_symbols && layout_symbols[j]; j++) {
+      if (!g_hash_table_add (seen, (gpointer)layout_symbols[j]))
+        continue;
+
+      g_strv_builder_add (builder, layout_symbols[j]);
+      n_symbols++;
+    }
+  }
+
+  if (n_symbols > pos_vk_driver_get_max_symbols (self->keyboard_driver)) {
+    g_warning ("%u symbols don't fit into a single keymap, using one per layout", n_symbols);
+    return;
+  }
+
+  symbols = g_strv_builder_end (builder);
+  g_debug ("Unified keymap '%s' with %u symbols", id->str, n_symbols);
+  self->unified_keymap_id = g_string_free (g_steal_pointer (&id), FALSE);
+  self->unified_keymap_symbols = g_steal_pointer (&symbols);
+}
+
+
 static void
 set_keymap_delayed (PosInputSurface *self)
 {
@@ -475,7 +809,9 @@ on_osk_popover_shown (PosInputSurface *self, GStrv *symbols, GtkWidget *osk_widg
   g_return_if_fail (POS_IS_INPUT_SURFACE (self));
   g_return_if_fail (POS_IS_OSK_WIDGET (osk_widget));
 
-  pos_vk_driver_set_overlay_keymap (self->keyboard_driver, (const char * const *)symbols);
+  /* Prefer the layout's spare keycodes over switching keymaps */
+  if (!pos_vk_driver_ensure_symbols (self->keyboard_driver, (const char * const *)symbols))
+    pos_vk_driver_set_overlay_keymap (self->keyboard_driver, (const char * const *)symbols);
 }
 
 
@@ -503,9 +839,9 @@ clipboard_paste_activated (GSimpleAction *action,
   if (pos_input_method_get_active (self->input_method)) {
     pos_input_surface_submit_current_preedit (self);
     pos_input_method_send_string (self->input_method, text, TRUE);
-  } else {
-    /* TODO */
-    g_warning_once ("Pasting via vk-driver not yet supported");
+  } else if (pos_vk_driver_type_string (self->keyboard_driver, text)) {
+    /* Switches back from the overlay keymap */
+    set_keymap_delayed (self);
   }
 
   /* Close popover in case we pasted from there */
@@ -529,32 +865,9 @@ settings_activated (GSimpleAction *action, GVariant *parameter, gpointer data)
 static void
 send_emoji_via_vk (PosInputSurface *self, const char *emoji)
 {
-  g_autoptr (GPtrArray) syms_array = g_ptr_array_new_with_free_func (g_free);
-  g_autofree gunichar *items = NULL;
-
-  /* To send an emoji via the vk driver we split it into unicode symbols… */
-  items = g_utf8_to_ucs4_fast (emoji, -1, NULL);
-  for (int i = 0; items[i]; i++) {
-    char *symbol = g_new0 (char, 7);
-
-    g_unichar_to_utf8 (items[i], symbol);
-    /* TODO: Can use g_strv_builder_take with glib 2.80 */
-    g_ptr_array_add (syms_array, symbol);
-  }
-  g_ptr_array_add (syms_array, NULL);
-
-  /* …add a keymap that contains the emoji, combining characters and emoji modifiers */
-  pos_vk_driver_set_overlay_keymap (self->keyboard_driver, (const char * const*)syms_array->pdata);
-
-  /* … and type each of these symbols one by one */
-  for (int i = 0; syms_array->pdata[i]; i++) {
-    const char *symbol = syms_array->pdata[i];
-
-    pos_vk_driver_key_down (self->keyboard_driver, symbol, POS_KEYCODE_MODIFIER_NONE);
-    pos_vk_driver_key_up (self->keyboard_driver, symbol);
-  }
-
-  set_keymap_delayed (self);
+  /* Types the emoji, combining characters and emoji modifiers in one go */
+  if (pos_vk_driver_type_string (self->keyboard_driver, emoji))
+    set_keymap_delayed (self);
 }
 
 
@@ -586,7 +899,7 @@ static void
 on_emoji_picker_delete_last (PosInputSurface *self)
 {
   g_debug ("%s", __func__);
-  on_osk_key_symbol (self, "KEY_BACKSPACE", NULL);
+  on_osk_key_symbol (self, pos_symbol_to_string (POS_SYMBOL_KEY_BACKSPACE), NULL);
 }
 
 /* menu button */
@@ -759,6 +1072,24 @@ pos_input_surface_switch_completion (PosInputSurface *self, PosOskWidget *osk)
 }
 
 
+static void
+pos_input_surface_update_swipe_lexicon (PosInputSurface *self)
+{
+  g_autoptr (GError) err = NULL;
+  const char *lang = NULL;
+  const char *region = NULL;
+
+  /* Only load a lexicon when needed, drop it otherwise */
+  if ((self->osk_features & PHOSH_OSK_FEATURE_SWIPE) && self->last_layout) {
+    lang = pos_osk_widget_get_lang (POS_OSK_WIDGET (self->last_layout));
+    region = pos_osk_widget_get_region (POS_OSK_WIDGET (self->last_layout));
+  }
+
+  if (!pos_swipe_decoder_set_language (self->swipe_decoder, lang, region, &err))
+    g_warning ("Failed to load swipe lexicon: %s", err->message);
+}
+
+
 static void
 on_visible_child_changed (PosInputSurface *self)
 {
@@ -782,6 +1113,7 @@ on_visible_child_changed (PosInputSurface *self)
   if (POS_INPUT_SURFACE_IS_LANG_LAYOUT (osk)) {
     pos_input_surface_switch_completion (self, osk);
     self->last_layout = GTK_WIDGET (osk);
+    pos_input_surface_update_swipe_lexicon (self);
   }
 
   /* Recheck completion bar visibility */
@@ -977,6 +1309,9 @@ pos_input_surface_set_osk_features (PosInputSurface *self, PhoshOskFeatures osk_
 
   self->osk_features = osk_features;
   g_hash_table_foreach (self->osks, update_osk_features, self);
+  pos_input_surface_update_swipe_lexicon (self);
+  pos_input_surface_update_unified_keymap (self);
+  set_keymap (self);
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_OSK_FEATURES]);
 }
@@ -1031,6 +1366,9 @@ pos_input_surface_get_property (GObject    *object,
   PosInputSurface *self = POS_INPUT_SURFACE (object);
 
   switch (property_id) {
+  case PROP_INPUT_METHOD:
+    g_value_set_object (value, self->input_method);
+    break;
   case PROP_COMPLETER:
     g_value_set_object (value, self->completer);
     break;
@@ -1151,25 +1489,33 @@ on_im_hint_changed (PosInputSurface *self, GParamSpec *pspec, PosInputMethod *im
 static void
 on_im_surrounding_text_changed (PosInputSurface *self, GParamSpec *pspec, PosInputMethod *im)
 {
-  const char *text;
-  guint anchor, cursor;
-  g_autofree char *before = NULL;
-  g_autofree char *after = NULL;
+  PosSurroundingText *surrounding_text;
+  const char *before = NULL, *after = NULL;
+  gsize before_len = 0, after_len = 0;
 
   g_assert (POS_IS_INPUT_SURFACE (self));
   g_assert (POS_IS_INPUT_METHOD (im));
 
-  text = pos_input_method_get_surrounding_text (im, &anchor, &cursor);
+  surrounding_text = pos_input_method_get_surrounding (im);
+  pos_input_surface_update_unapplied_deletion (self, surrounding_text);
 
   if (!pos_input_surface_is_completion_mode (self))
     return;
 
-  before = g_strndup (text, cursor);
+  /* Completers only need the text close to the cursor, pass views rather than copies */
+  if (surrounding_text) {
+    before = pos_surrounding_text_get_before (surrounding_text, COMPLETION_CONTEXT_LEN,
+                                              &before_len);
 
-  if (text)
-    after = g_strdup (&(text[cursor]));
+    after = pos_surrounding_text_get_after (surrounding_text);
+    after_len = strnlen (after, COMPLETION_CONTEXT_LEN);
+    /* Don't cut characters in half */
+    while (after_len > 0 && (after[after_len] & 0xC0) == 0x80)
+      after_len--;
+  }
 
-  pos_completer_set_surrounding_text (POS_COMPLETER (self->completer), before, after);
+  pos_completer_set_surrounding_text (POS_COMPLETER (self->completer),
+                                      before, before_len, after, after_len);
 }
 
 
@@ -1182,9 +1528,10 @@ on_im_active_changed (PosInputSurface *self, GParamSpec *pspec, PosInputMethod *
   g_assert (POS_IS_INPUT_METHOD (im));
 
   active = pos_input_method_get_active (im);
+  self->unapplied_deletion = 0;
 
+  /* The input method drops actions not sent yet on its own */
   if (active) {
-    /* TODO: Reset buffered commit_string, delete_surrounding_text */
     if (pos_input_surface_is_completer_active (self)) {
       pos_completer_set_preedit (self->completer, NULL);
     }
@@ -1274,6 +1621,8 @@ pos_input_surface_finalize (GObject *object)
 
   g_clear_object (&self->logind_session);
   g_clear_object (&self->keyboard_driver);
+  g_clear_pointer (&self->unified_keymap_id, g_free);
+  g_clear_pointer (&self->unified_keymap_symbols, g_strfreev);
   g_clear_object (&self->input_method);
   g_clear_object (&self->a11y_settings);
   g_clear_object (&self->input_settings);
@@ -1282,6 +1631,7 @@ pos_input_surface_finalize (GObject *object)
   g_clear_object (&self->clipboard_manager);
   g_clear_object (&self->completer);
   g_clear_object (&self->completer_manager);
+  g_clear_object (&self->swipe_decoder);
   g_clear_object (&self->swipe_down);
   g_clear_object (&self->style_manager);
   g_clear_pointer (&self->osks, g_hash_table_destroy);
@@ -1468,6 +1818,8 @@ pos_input_surface_class_init (PosInputSurfaceClass *klass)
   gtk_widget_class_bind_template_callback (widget_class, on_num_shortcuts_changed);
   gtk_widget_class_bind_template_callback (widget_class, on_osk_key_down);
   gtk_widget_class_bind_template_callback (widget_class, on_osk_key_symbol);
+  gtk_widget_class_bind_template_callback (widget_class, on_osk_cursor_motion);
+  gtk_widget_class_bind_template_callback (widget_class, on_osk_delete_repeat);
   gtk_widget_class_bind_template_callback (widget_class, on_osk_mode_changed);
   gtk_widget_class_bind_template_callback (widget_class, on_osk_popover_shown);
   gtk_widget_class_bind_template_callback (widget_class, on_osk_popover_hidden);
@@ -1609,6 +1961,7 @@ insert_osk (PosInputSurface   *self,
     return osk_widget;
 
   osk_widget = pos_osk_widget_new (self->osk_features);
+  pos_osk_widget_set_swipe_decoder (osk_widget, self->swipe_decoder);
   if (!pos_osk_widget_set_layout (POS_OSK_WIDGET (osk_widget),
                                   name,
                                   layout_id,
@@ -1635,6 +1988,9 @@ insert_osk (PosInputSurface   *self,
                     "swapped-signal::notify::mode", G_CALLBACK (on_osk_mode_changed), self,
                     "swapped-signal::popover-shown", G_CALLBACK (on_osk_popover_shown), self,
                     "swapped-signal::popover-hidden", G_CALLBACK (on_osk_popover_hidden), self,
+                    "swapped-signal::swipe", G_CALLBACK (on_osk_swipe), self,
+                    "swapped-signal::cursor-motion", G_CALLBACK (on_osk_cursor_motion), self,
+                    "swapped-signal::delete-repeat", G_CALLBACK (on_osk_delete_repeat), self,
                     NULL);
 
   hdy_deck_insert_child_after (self->deck, GTK_WIDGET (osk_widget), NULL);
@@ -1771,6 +2127,7 @@ on_input_setting_changed (PosInputSurface *self, const char *key, GSettings *set
     insert_osk (self, "us", "us", "English (USA)", "us", NULL, NULL);
   }
 
+  pos_input_surface_update_unified_keymap (self);
   set_keymap (self);
 }
 
@@ -1824,6 +2181,7 @@ pos_input_surface_init (PosInputSurface *self)
 
   gtk_widget_init_template (GTK_WIDGET (self));
 
+  self->swipe_decoder = pos_swipe_decoder_new ();
   self->style_manager = pos_style_manager_new ();
   self->action_map = g_simple_action_group_new ();
   g_action_map_add_action_entries (G_ACTION_MAP (self->action_map),
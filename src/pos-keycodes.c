@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-keycodes"
+
+#include "pos-config.h"
+
+#include "pos-keycodes.h"
+
+#include <string.h>
+
+/**
+ * PosKeycodes:
+ *
+ * Lookup tables for the terminal keymap as compiled from
+ * `data/keymap.txt` at build time by `tools/compile-keycodes.py`.
+ *
+ * The tables are minimal perfect hashes: A key's hash picks a
+ * displacement which, hashed in again, gives the key's slot. Lookups
+ * are two hashes and one comparison. The hash function must match
+ * the one in `compile-keycodes.py`.
+ */
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+
+
+static inline guint32
+hash_mix (guint32 h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+
+  return h;
+}
+
+
+static inline guint32
+hash_str (const char *str, guint32 seed)
+{
+  guint32 h = FNV_OFFSET ^ seed;
+
+  for (const guchar *p = (const guchar *)str; *p; p++) {
+    h ^= *p;
+    h *= FNV_PRIME;
+  }
+
+  return hash_mix (h);
+}
+
+
+static inline guint32
+hash_uint (guint32 val, guint32 seed)
+{
+  guint32 h = FNV_OFFSET ^ seed;
+
+  for (int i = 0; i < 4; i++) {
+    h ^= (val >> (8 * i)) & 0xff;
+    h *= FNV_PRIME;
+  }
+
+  return hash_mix (h);
+}
+
+/**
+ * pos_keycodes_lookup_symbol:
+ * @symbol: The symbol to look up
+ *
+ * Looks up how to send the given symbol with the terminal keymap.
+ *
+ * Returns: (nullable): The keycode or %NULL if the keymap lacks @symbol
+ */
+const PosKeycode *
+pos_keycodes_lookup_symbol (const char *symbol)
+{
+  const PosKeycode *keycode;
+  guint32 disp;
+
+  g_return_val_if_fail (symbol, NULL);
+
+  disp = pos_keycodes_symbols_disp[hash_str (symbol, 0) % pos_keycodes_symbols_disp_n];
+  keycode = &pos_keycodes_symbols[hash_str (symbol, disp) % pos_keycodes_symbols_n];
+
+  return strcmp (keycode->key, symbol) == 0 ? keycode : NULL;
+}
+
+/**
+ * pos_keycodes_lookup_keyval:
+ * @keyval: The GDK keyval to look up
+ *
+ * Looks up the key the given keyval is on in the terminal keymap.
+ *
+ * Returns: The keycode or `0` if the keymap lacks @keyval
+ */
+guint
+pos_keycodes_lookup_keyval (guint keyval)
+{
+  const PosKeycodeKeyval *entry;
+  guint32 disp;
+
+  disp = pos_keycodes_keyvals_disp[hash_uint (keyval, 0) % pos_keycodes_keyvals_disp_n];
+  entry = &pos_keycodes_keyvals[hash_uint (keyval, disp) % pos_keycodes_keyvals_n];
+
+  return entry->keyval == keyval ? entry->keycode : 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "pos-vk-driver.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PosKeycode:
+ * @key: The symbol
+ * @keycode: The (evdev) keycode to send for @key
+ * @modifiers: The modifiers needed to get @key
+ *
+ * How to send a symbol via the virtual keyboard.
+ */
+typedef struct {
+  const char *key;
+  guint       keycode;
+  guint       modifiers;
+} PosKeycode;
+
+/**
+ * PosKeycodeKeyval:
+ * @keyval: The GDK keyval
+ * @keycode: The (evdev) keycode to send for @keyval
+ *
+ * The key a keyval is on in the terminal keymap.
+ */
+typedef struct {
+  guint keyval;
+  guint keycode;
+} PosKeycodeKeyval;
+
+const PosKeycode *pos_keycodes_lookup_symbol (const char *symbol);
+guint             pos_keycodes_lookup_keyval (guint keyval);
+
+/* Generated */
+extern const PosKeycode       pos_keycodes_symbols[];
+extern const guint            pos_keycodes_symbols_n;
+extern const guint32          pos_keycodes_symbols_disp[];
+extern const guint            pos_keycodes_symbols_disp_n;
+extern const PosKeycodeKeyval pos_keycodes_keyvals[];
+extern const guint            pos_keycodes_keyvals_n;
+extern const guint32          pos_keycodes_keyvals_disp[];
+extern const guint            pos_keycodes_keyvals_disp_n;
+
+G_END_DECLS
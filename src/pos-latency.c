@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-latency"
+
+#include "pos-config.h"
+
+#include "pos-latency.h"
+
+/**
+ * PosLatency:
+ *
+ * Traces how long key presses take to turn into text. Each keystroke
+ * starts with a key press. For every later stage two latencies are
+ * recorded: The time since the previous stage and the time since the
+ * key got released (as that's when the key's symbol gets processed).
+ * Only the first occurrence of a stage within a keystroke counts.
+ *
+ * The latencies go into histograms with four buckets per power of
+ * two so percentiles are off by at most 25%.
+ */
+
+/* Two bits of mantissa, values up to 2^31 µs */
+#define MANTISSA_BITS 2
+#define N_SUB_BUCKETS (1 << MANTISSA_BITS)
+#define N_BUCKETS     (N_SUB_BUCKETS * 31)
+
+typedef struct {
+  guint32 buckets[N_BUCKETS];
+  guint   count;
+  gint64  max;
+} PosLatencyHistogram;
+
+typedef struct {
+  PosLatencyHistogram step[POS_LATENCY_N_STAGES];
+  PosLatencyHistogram since_release[POS_LATENCY_N_STAGES];
+
+  /* The current keystroke */
+  gint64              press;
+  gint64              release;
+  gint64              last;
+  guint               seen;
+} PosLatencyTracer;
+
+static const char * const stage_names[POS_LATENCY_N_STAGES] = {
+  [POS_LATENCY_STAGE_PRESS] = "press",
+  [POS_LATENCY_STAGE_RELEASE] = "release",
+  [POS_LATENCY_STAGE_SYMBOL] = "symbol",
+  [POS_LATENCY_STAGE_COMPLETER] = "completer",
+  [POS_LATENCY_STAGE_COMPLETIONS] = "completions",
+  [POS_LATENCY_STAGE_COMMIT] = "commit",
+  [POS_LATENCY_STAGE_FLUSH] = "flush",
+  [POS_LATENCY_STAGE_DONE] = "done",
+};
+
+gboolean _pos_latency_enabled;
+static PosLatencyTracer *tracer;
+
+
+static guint
+get_bucket (gint64 usecs)
+{
+  guint64 val = CLAMP (usecs, 0, G_MAXINT32);
+  int exp;
+
+  if (val < N_SUB_BUCKETS)
+    return val;
+
+  exp = g_bit_nth_msf (val, -1);
+  return N_SUB_BUCKETS * (exp - MANTISSA_BITS + 1) +
+    ((val >> (exp - MANTISSA_BITS)) & (N_SUB_BUCKETS - 1));
+}
+
+
+/* The largest value that ends up in the given bucket */
+static gint64
+get_bucket_max (guint bucket)
+{
+  int exp;
+  guint64 mantissa;
+
+  if (bucket < N_SUB_BUCKETS)
+    return bucket;
+
+  exp = bucket / N_SUB_BUCKETS + MANTISSA_BITS - 1;
+  mantissa = N_SUB_BUCKETS + bucket % N_SUB_BUCKETS;
+
+  return ((mantissa + 1) << (exp - MANTISSA_BITS)) - 1;
+}
+
+
+static void
+histogram_add (PosLatencyHistogram *histogram, gint64 usecs)
+{
+  histogram->buckets[get_bucket (usecs)]++;
+  histogram->count++;
+  histogram->max = MAX (histogram->max, usecs);
+}
+
+
+static gint64
+histogram_get_percentile (PosLatencyHistogram *histogram, guint percentile)
+{
+  guint64 needed, sum = 0;
+
+  if (histogram->count == 0)
+    return 0;
+
+  needed = ((guint64)histogram->count * percentile + 99) / 100;
+  for (guint i = 0; i < N_BUCKETS; i++) {
+    sum += histogram->buckets[i];
+    if (sum >= needed)
+      return MIN (get_bucket_max (i), histogram->max);
+  }
+
+  return histogram->max;
+}
+
+
+static void
+append_histogram (GString *str, PosLatencyHistogram *histogram)
+{
+  g_string_append_printf (str, " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT
+                          " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT,
+                          histogram_get_percentile (histogram, 50),
+                          histogram_get_percentile (histogram, 95),
+                          histogram_get_percentile (histogram, 99),
+                          histogram->max);
+}
+
+/**
+ * pos_latency_set_enabled:
+ * @enabled: Whether to trace keystrokes
+ *
+ * Enables or disables tracing. Disabling drops the collected data.
+ */
+void
+pos_latency_set_enabled (gboolean enabled)
+{
+  _pos_latency_enabled = enabled;
+
+  if (enabled && tracer == NULL)
+    tracer = g_new0 (PosLatencyTracer, 1);
+  else if (!enabled)
+    g_clear_pointer (&tracer, g_free);
+}
+
+/**
+ * pos_latency_record:
+ * @stage: The stage the current keystroke reached
+ *
+ * Records the time it took the current keystroke to reach @stage. Use
+ * [func@latency_mark] instead as it's cheap when tracing is disabled.
+ */
+void
+pos_latency_record (PosLatencyStage stage)
+{
+  gint64 now;
+
+  g_return_if_fail (stage < POS_LATENCY_N_STAGES);
+
+  if (tracer == NULL)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (stage == POS_LATENCY_STAGE_PRESS) {
+    tracer->press = tracer->last = now;
+    tracer->release = 0;
+    tracer->seen = 1 << stage;
+    return;
+  }
+
+  /* Not part of a keystroke or already seen */
+  if (tracer->press == 0 || tracer->seen & (1 << stage))
+    return;
+
+  /* Only input method requests get a `done` */
+  if (stage == POS_LATENCY_STAGE_DONE && !(tracer->seen & (1 << POS_LATENCY_STAGE_FLUSH)))
+    return;
+
+  tracer->seen |= 1 << stage;
+  histogram_add (&tracer->step[stage], now - tracer->last);
+  if (stage == POS_LATENCY_STAGE_RELEASE)
+    tracer->release = now;
+  else if (tracer->release)
+    histogram_add (&tracer->since_release[stage], now - tracer->release);
+  tracer->last = now;
+}
+
+/**
+ * pos_latency_dump:
+ *
+ * Formats the collected latencies (in µs) as table.
+ *
+ * Returns:(transfer full): The table
+ */
+char *
+pos_latency_dump (void)
+{
+  GString *str;
+
+  if (tracer == NULL)
+    return g_strdup ("Latency tracing disabled");
+
+  str = g_string_new ("Keystroke latencies in µs, step: since previous stage, "
+                      "tot: since key release\n");
+  g_string_append_printf (str, "%-12s %6s %8s %8s %8s %8s %8s %8s %8s %8s\n", "stage", "n",
+                          "step p50", "p95", "p99", "max",
+                          "tot p50", "p95", "p99", "max");
+
+  for (int i = POS_LATENCY_STAGE_RELEASE; i < POS_LATENCY_N_STAGES; i++) {
+    g_string_append_printf (str, "%-12s %6u", stage_names[i], tracer->step[i].count);
+    append_histogram (str, &tracer->step[i]);
+    append_histogram (str, &tracer->since_release[i]);
+    g_string_append_c (str, '\n');
+  }
+
+  return g_string_free (str, FALSE);
+}
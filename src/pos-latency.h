@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PosLatencyStage:
+ * @POS_LATENCY_STAGE_PRESS: A key got pressed, starts a new keystroke
+ * @POS_LATENCY_STAGE_RELEASE: The key got released
+ * @POS_LATENCY_STAGE_SYMBOL: The input surface got the key's symbol
+ * @POS_LATENCY_STAGE_COMPLETER: The completer processed the symbol
+ * @POS_LATENCY_STAGE_COMPLETIONS: The completions got updated
+ * @POS_LATENCY_STAGE_COMMIT: Input got committed via the input method or
+ *   pressed via the virtual keyboard
+ * @POS_LATENCY_STAGE_FLUSH: Input method requests got sent to the compositor
+ * @POS_LATENCY_STAGE_DONE: The compositor applied the input method requests
+ *
+ * The stages of a keystroke that are traced.
+ */
+typedef enum {
+  POS_LATENCY_STAGE_PRESS,
+  POS_LATENCY_STAGE_RELEASE,
+  POS_LATENCY_STAGE_SYMBOL,
+  POS_LATENCY_STAGE_COMPLETER,
+  POS_LATENCY_STAGE_COMPLETIONS,
+  POS_LATENCY_STAGE_COMMIT,
+  POS_LATENCY_STAGE_FLUSH,
+  POS_LATENCY_STAGE_DONE,
+  POS_LATENCY_N_STAGES,
+} PosLatencyStage;
+
+extern gboolean _pos_latency_enabled;
+
+void  pos_latency_set_enabled (gboolean enabled);
+void  pos_latency_record (PosLatencyStage stage);
+char *pos_latency_dump (void);
+
+/**
+ * pos_latency_mark:
+ * @stage: The stage the current keystroke reached
+ *
+ * Records the time it took the current keystroke to reach @stage. This
+ * is a no-op unless tracing is enabled.
+ */
+static inline void
+pos_latency_mark (PosLatencyStage stage)
+{
+  if (G_UNLIKELY (_pos_latency_enabled))
+    pos_latency_record (stage);
+}
+
+G_END_DECLS
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-layout-data"
+
+#include "pos-config.h"
+
+#include "pos-layout-data.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int
+cmp_layout_id (const void *key, const void *elem)
+{
+  const PosLayoutData *data = elem;
+
+  return strcmp (key, data->id);
+}
+
+/**
+ * pos_layout_data_lookup:
+ * @layout_id: The layout id, e.g. `de` or `ch+fr`
+ *
+ * Looks up a compiled layout.
+ *
+ * Returns: (nullable): The layout data or %NULL if there's no such layout.
+ */
+const PosLayoutData *
+pos_layout_data_lookup (const char *layout_id)
+{
+  g_return_val_if_fail (layout_id, NULL);
+
+  return bsearch (layout_id, pos_layout_data, pos_layout_data_n, sizeof (PosLayoutData),
+                  cmp_layout_id);
+}
+
+/**
+ * pos_layout_data_get_n_layouts:
+ *
+ * Returns: The number of compiled in layouts
+ */
+guint
+pos_layout_data_get_n_layouts (void)
+{
+  return pos_layout_data_n;
+}
+
+/**
+ * pos_layout_data_get_nth:
+ * @n: The index of the layout
+ *
+ * Returns: The nth compiled in layout.
+ */
+const PosLayoutData *
+pos_layout_data_get_nth (guint n)
+{
+  g_return_val_if_fail (n < pos_layout_data_n, NULL);
+
+  return &pos_layout_data[n];
+}
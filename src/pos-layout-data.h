@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "pos-enums.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PosLayoutKeyData:
+ * @symbol: (nullable): The symbol emitted by the key
+ * @symbols: (nullable): %NULL terminated list of symbols shown on long press
+ * @label: (nullable): The label to show instead of the symbol
+ * @icon: (nullable): The icon to show instead of the symbol
+ * @style: (nullable): Additional style class for the key
+ * @width: The key width in key units
+ *
+ * A key as compiled from the layout description at build time.
+ */
+typedef struct {
+  const char        *symbol;
+  const char *const *symbols;
+  const char        *label;
+  const char        *icon;
+  const char        *style;
+  double             width;
+} PosLayoutKeyData;
+
+/**
+ * PosLayoutRowData:
+ * @keys: The keys in this row
+ * @n_keys: The number of keys in this row
+ *
+ * A row of keys as compiled from the layout description.
+ */
+typedef struct {
+  const PosLayoutKeyData *keys;
+  guint                   n_keys;
+} PosLayoutRowData;
+
+/**
+ * PosLayoutLevelData:
+ * @layer: The layer this level is displayed on
+ * @rows: The rows of this level
+ * @n_rows: The number of rows
+ *
+ * A level (layer) of keys as compiled from the layout description.
+ */
+typedef struct {
+  PosOskWidgetLayer       layer;
+  const PosLayoutRowData *rows;
+  guint                   n_rows;
+} PosLayoutLevelData;
+
+/**
+ * PosLayoutData:
+ * @id: The layout id, e.g. `de` or `ch+fr`
+ * @name: The display name of the layout
+ * @locale: The layout's locale, e.g. `en-GB`, `en`
+ * @levels: The levels in the order they appear in the layout description
+ * @n_levels: The number of levels
+ *
+ * A keyboard layout as compiled from the layout description at build time
+ * by `tools/compile-layouts.py`. All data is static and can be used without
+ * any further parsing.
+ */
+typedef struct {
+  const char               *id;
+  const char               *name;
+  const char               *locale;
+  const PosLayoutLevelData *levels;
+  guint                     n_levels;
+} PosLayoutData;
+
+const PosLayoutData *pos_layout_data_lookup (const char *layout_id);
+guint                pos_layout_data_get_n_layouts (void);
+const PosLayoutData *pos_layout_data_get_nth (guint n);
+
+/* Generated */
+extern const PosLayoutData pos_layout_data[];
+extern const guint         pos_layout_data_n;
+
+G_END_DECLS
@@ -12,6 +12,7 @@
 #include "pos-resources.h"
 #include "pos-main.h"
 #include "pos-osk-widget.h"
+#include "pos-text-cache.h"
 #include "pos-vk-driver.h"
 
 #include <glib/gi18n.h>
@@ -57,5 +58,6 @@ pos_init (void)
 void
 pos_uninit (void)
 {
+  pos_text_cache_clear ();
   pos_unregister_resource ();
 }
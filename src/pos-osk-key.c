@@ -21,8 +21,6 @@ enum {
   PROP_ICON,
   PROP_STYLE,
   PROP_LAYER,
-  PROP_EXPAND,
-  PROP_PRESSED,
   PROP_LAST_PROP
 };
 static GParamSpec *props[PROP_LAST_PROP];
@@ -30,72 +28,20 @@ static GParamSpec *props[PROP_LAST_PROP];
 /**
  * PosOskKey:
  *
- * A key on the osk widget
+ * A key on the osk widget. This is a view on a key stored in a
+ * #PosOskLayout's key table. The widget itself works on the table
+ * directly, the view is for users that want to inspect single keys.
  */
 struct _PosOskKey {
-  GObject           parent;
-
-  PosOskKeyUse      use;
-  double            width;
-  char             *symbol;
-  GStrv             symbols;
-  char             *label;
-  char             *icon;
-  char             *style;
-  PosOskWidgetLayer layer;
-  GdkRectangle      box;
-  gboolean          expand;
-  gboolean          pressed;
+  GObject                  parent;
+
+  PosOskLayout            *layout;
+  const PosOskLayoutLayer *layout_layer;
+  guint                    index;
 };
 G_DEFINE_TYPE (PosOskKey, pos_osk_key, G_TYPE_OBJECT)
 
 
-static void
-pos_osk_key_set_property (GObject      *object,
-                          guint         property_id,
-                          const GValue *value,
-                          GParamSpec   *pspec)
-{
-  PosOskKey *self = POS_OSK_KEY (object);
-
-  switch (property_id) {
-  case PROP_USE:
-    self->use = g_value_get_enum (value);
-    break;
-  case PROP_WIDTH:
-    pos_osk_key_set_width (self, g_value_get_double (value));
-    break;
-  case PROP_SYMBOL:
-    self->symbol = g_value_dup_string (value);
-    break;
-  case PROP_SYMBOLS:
-    self->symbols = g_value_dup_boxed (value);
-    break;
-  case PROP_LABEL:
-    self->label = g_value_dup_string (value);
-    break;
-  case PROP_ICON:
-    self->icon = g_value_dup_string (value);
-    break;
-  case PROP_STYLE:
-    self->style = g_value_dup_string (value);
-    break;
-  case PROP_LAYER:
-    self->layer = g_value_get_enum (value);
-    break;
-  case PROP_EXPAND:
-    self->expand = g_value_get_boolean (value);
-    break;
-  case PROP_PRESSED:
-    pos_osk_key_set_pressed (self, g_value_get_boolean (value));
-    break;
-  default:
-    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
-    break;
-  }
-}
-
-
 static void
 pos_osk_key_get_property (GObject    *object,
                           guint       property_id,
@@ -106,34 +52,28 @@ pos_osk_key_get_property (GObject    *object,
 
   switch (property_id) {
   case PROP_USE:
-    g_value_set_boolean (value, self->use);
+    g_value_set_enum (value, pos_osk_key_get_use (self));
     break;
   case PROP_WIDTH:
-    g_value_set_double (value, self->width);
+    g_value_set_double (value, pos_osk_key_get_width (self));
     break;
   case PROP_SYMBOL:
-    g_value_set_string (value, self->symbol);
+    g_value_set_string (value, pos_osk_key_get_symbol (self));
     break;
   case PROP_SYMBOLS:
-    g_value_set_boxed (value, self->symbols);
+    g_value_set_boxed (value, pos_osk_key_get_symbols (self));
     break;
   case PROP_LABEL:
-    g_value_set_string (value, self->label);
+    g_value_set_string (value, pos_osk_key_get_label (self));
     break;
   case PROP_ICON:
-    g_value_set_string (value, self->icon);
+    g_value_set_string (value, pos_osk_key_get_icon (self));
     break;
   case PROP_STYLE:
-    g_value_set_string (value, self->style);
+    g_value_set_string (value, pos_osk_key_get_style (self));
     break;
   case PROP_LAYER:
-    g_value_set_enum (value, self->layer);
-    break;
-  case PROP_EXPAND:
-    g_value_set_boolean (value, self->expand);
-    break;
-  case PROP_PRESSED:
-    g_value_set_boolean (value, self->pressed);
+    g_value_set_enum (value, pos_osk_key_get_layer (self));
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -146,11 +86,7 @@ pos_osk_key_finalize (GObject *object)
 {
   PosOskKey *self = POS_OSK_KEY (object);
 
-  g_clear_pointer (&self->symbols, g_strfreev);
-  g_clear_pointer (&self->symbol, g_free);
-  g_clear_pointer (&self->label, g_free);
-  g_clear_pointer (&self->icon, g_free);
-  g_clear_pointer (&self->style, g_free);
+  g_clear_pointer (&self->layout, pos_osk_layout_unref);
 
   G_OBJECT_CLASS (pos_osk_key_parent_class)->finalize (object);
 }
@@ -162,7 +98,6 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->get_property = pos_osk_key_get_property;
-  object_class->set_property = pos_osk_key_set_property;
   object_class->finalize = pos_osk_key_finalize;
 
   /**
@@ -175,8 +110,8 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                        "",
                        "",
                        POS_TYPE_OSK_KEY_USE,
-                       FALSE,
-                       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+                       POS_OSK_KEY_USE_KEY,
+                       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:width
    *
@@ -187,9 +122,9 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                          "",
                          "",
                          1.0,
-                         10.0,
+                         G_MAXDOUBLE,
                          1.0,
-                         G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+                         G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:symbol
    *
@@ -200,7 +135,7 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                          "",
                          "",
                          NULL,
-                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+                         G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:symbols
    *
@@ -211,7 +146,7 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                         "",
                         "",
                         G_TYPE_STRV,
-                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+                        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:label
    *
@@ -222,7 +157,7 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                          "",
                          "",
                          NULL,
-                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+                         G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:icon
    *
@@ -233,7 +168,7 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                          "",
                          "",
                          NULL,
-                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+                         G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:style
    *
@@ -244,7 +179,7 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                          "",
                          "",
                          NULL,
-                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+                         G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
   /**
    * PosOskKey:layer
    *
@@ -255,30 +190,8 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
                        "",
                        "",
                        POS_TYPE_OSK_WIDGET_LAYER,
-                       FALSE,
-                       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
-  /**
-   * PosOskKey:expand
-   *
-   * Whether the key expands to use free space in available in a row
-   */
-  props[PROP_EXPAND] =
-    g_param_spec_boolean ("expand",
-                          "",
-                          "",
-                          FALSE,
-                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
-  /**
-   * PosOskKey:pressed
-   *
-   * Whether the key is currently pressed
-   */
-  props[PROP_PRESSED] =
-    g_param_spec_boolean ("pressed",
-                          "",
-                          "",
-                          FALSE,
-                          G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+                       POS_OSK_WIDGET_LAYER_NORMAL,
+                       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 }
@@ -287,27 +200,34 @@ pos_osk_key_class_init (PosOskKeyClass *klass)
 static void
 pos_osk_key_init (PosOskKey *self)
 {
-  self->use = POS_OSK_KEY_USE_KEY;
-  self->width = 1.0;
-  self->layer = POS_OSK_WIDGET_LAYER_NORMAL;
 }
 
-
+/**
+ * pos_osk_key_new:
+ * @layout: The layout the key is on
+ * @layer: The layer the key is on
+ * @index: The index of the key in the layer
+ *
+ * Gets a view on a key in a layout's key table.
+ *
+ * Returns: The key
+ */
 PosOskKey *
-pos_osk_key_new (const char *symbol)
+pos_osk_key_new (PosOskLayout *layout, PosOskWidgetLayer layer, guint index)
 {
-  return POS_OSK_KEY (g_object_new (POS_TYPE_OSK_KEY, "symbol", symbol, NULL));
-}
+  PosOskKey *self;
+  const PosOskLayoutLayer *layout_layer;
 
+  g_return_val_if_fail (layout, NULL);
+  layout_layer = pos_osk_layout_get_layer (layout, layer);
+  g_return_val_if_fail (index < layout_layer->n_keys, NULL);
 
-void
-pos_osk_key_set_width (PosOskKey *self, double width)
-{
-  g_return_if_fail (POS_IS_OSK_KEY (self));
-  g_return_if_fail (width > 0.0);
+  self = POS_OSK_KEY (g_object_new (POS_TYPE_OSK_KEY, NULL));
+  self->layout = pos_osk_layout_ref (layout);
+  self->layout_layer = layout_layer;
+  self->index = index;
 
-  self->width = width;
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_WIDTH]);
+  return self;
 }
 
 
@@ -316,56 +236,52 @@ pos_osk_key_get_width (PosOskKey *self)
 {
   g_return_val_if_fail (POS_IS_OSK_KEY (self), 1.0);
 
-  return self->width;
+  return self->layout_layer->key_width[self->index];
 }
 
 
 PosOskKeyUse
 pos_osk_key_get_use (PosOskKey *self)
 {
-  g_return_val_if_fail (POS_IS_OSK_KEY (self), 1.0);
+  g_return_val_if_fail (POS_IS_OSK_KEY (self), POS_OSK_KEY_USE_KEY);
 
-  return self->use;
+  return self->layout_layer->key_use[self->index];
 }
 
 
-gboolean
-pos_osk_key_get_pressed (PosOskKey *self)
+const char *
+pos_osk_key_get_label (PosOskKey *self)
 {
-  g_return_val_if_fail (POS_IS_OSK_KEY (self), FALSE);
+  g_return_val_if_fail (POS_IS_OSK_KEY (self), NULL);
 
-  return self->pressed;
+  return self->layout_layer->key_label[self->index];
 }
 
 
-void
-pos_osk_key_set_pressed (PosOskKey *self, gboolean pressed)
+const char *
+pos_osk_key_get_symbol (PosOskKey *self)
 {
-  g_return_if_fail (POS_IS_OSK_KEY (self));
-
-  if (pressed == self->pressed)
-    return;
+  g_return_val_if_fail (POS_IS_OSK_KEY (self), NULL);
 
-  self->pressed = pressed;
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_PRESSED]);
+  return self->layout_layer->key_symbol[self->index];
 }
 
 
 const char *
-pos_osk_key_get_label (PosOskKey *self)
+pos_osk_key_get_icon (PosOskKey *self)
 {
   g_return_val_if_fail (POS_IS_OSK_KEY (self), NULL);
 
-  return self->label;
+  return self->layout_layer->key_icon[self->index];
 }
 
 
 const char *
-pos_osk_key_get_symbol (PosOskKey *self)
+pos_osk_key_get_style (PosOskKey *self)
 {
   g_return_val_if_fail (POS_IS_OSK_KEY (self), NULL);
 
-  return self->symbol;
+  return self->layout_layer->key_style[self->index];
 }
 
 
@@ -374,7 +290,7 @@ pos_osk_key_get_layer (PosOskKey *self)
 {
   g_return_val_if_fail (POS_IS_OSK_KEY (self), POS_OSK_WIDGET_LAYER_NORMAL);
 
-  return self->layer;
+  return self->layout_layer->key_layer[self->index];
 }
 
 
@@ -392,29 +308,5 @@ pos_osk_key_get_symbols (PosOskKey *self)
 {
   g_return_val_if_fail (POS_IS_OSK_KEY (self), NULL);
 
-  return self->symbols;
-}
-
-
-void
-pos_osk_key_set_box (PosOskKey *self, const GdkRectangle *box)
-{
-  memmove (&self->box, box, sizeof (self->box));
-}
-
-
-const GdkRectangle *
-pos_osk_key_get_box (PosOskKey *self)
-{
-  g_return_val_if_fail (POS_IS_OSK_KEY (self), NULL);
-
-  return &self->box;
-}
-
-gboolean
-pos_osk_key_get_expand (PosOskKey *self)
-{
-  g_return_val_if_fail (POS_IS_OSK_KEY (self), FALSE);
-
-  return self->expand;
+  return (GStrv)self->layout_layer->key_symbols[self->index];
 }
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-osk-layout"
+
+#include "pos-config.h"
+
+#include "pos-layout-data.h"
+#include "pos-osk-key.h"
+#include "pos-osk-layout.h"
+
+#include <gio/gio.h>
+
+#include <math.h>
+
+/**
+ * PosOskLayout:
+ * @id: The layout's id e.g. `de` or `ch+fr`
+ * @name: The display name of the layout, e.g. `English Great Britain`, `English Great (US)`
+ * @locale: The layout's `locale` field as parsed from the data, e.g. `en-GB`, `en`
+ *  For internal use only.
+ * @symbols: Pointers to the (interned) symbols on the layout
+ *
+ * A keyboard layout as built from the compiled in layout data. The
+ * keys are grouped in different layers that are displayed depending
+ * on modifier state.
+ *
+ * Layouts are immutable and shared between all users of the same layout
+ * so e.g. several #PosOskWidget instances using the `us` layout only
+ * build it once. Per instance state like pressed keys or geometry needs to
+ * be kept by the users.
+ */
+struct _PosOskLayout {
+  char              *id;
+  char              *name;
+  char              *locale;
+  PosOskLayoutLayer  layers[POS_OSK_WIDGET_LAST_LAYER + 1];
+  guint              n_layers;
+  guint              n_cols;
+  guint              n_rows;
+  GPtrArray         *symbols;
+};
+
+G_DEFINE_BOXED_TYPE (PosOskLayout, pos_osk_layout, pos_osk_layout_ref, pos_osk_layout_unref);
+
+/* Layouts currently in use, keyed by id. The layouts remove themselves when freed */
+static GHashTable *layouts;
+
+/**
+ * PosOskLayoutKeyDef:
+ *
+ * A key while building a layer. Once all keys are known they're
+ * moved into the layer's arrays.
+ */
+typedef struct {
+  double             width;
+  PosOskKeyUse       use;
+  PosOskWidgetLayer  layer;
+  const char        *symbol;
+  const char        *label;
+  const char        *icon;
+  const char        *style;
+  const char *const *symbols;
+  gboolean           expand;
+} PosOskLayoutKeyDef;
+
+
+static void
+pos_osk_layout_free (gpointer data)
+{
+  PosOskLayout *self = data;
+
+  g_hash_table_remove (layouts, self->id);
+  if (g_hash_table_size (layouts) == 0)
+    g_clear_pointer (&layouts, g_hash_table_destroy);
+
+  for (int l = 0; l <= POS_OSK_WIDGET_LAST_LAYER; l++) {
+    PosOskLayoutLayer *layer = &self->layers[l];
+
+    g_clear_pointer (&layer->key_width, g_free);
+    g_clear_pointer (&layer->key_use, g_free);
+    g_clear_pointer (&layer->key_layer, g_free);
+    g_clear_pointer (&layer->key_symbol, g_free);
+    g_clear_pointer (&layer->key_symbol_id, g_free);
+    g_clear_pointer (&layer->key_label, g_free);
+    g_clear_pointer (&layer->key_icon, g_free);
+    g_clear_pointer (&layer->key_style, g_free);
+    g_clear_pointer (&layer->key_symbols, g_free);
+  }
+
+  g_clear_pointer (&self->symbols, g_ptr_array_unref);
+  g_free (self->id);
+  g_free (self->name);
+  g_free (self->locale);
+}
+
+
+static void
+add_key (GArray *keys, PosOskLayoutRow *row, gboolean prepend, const PosOskLayoutKeyDef *key)
+{
+  row->width += key->width;
+  if (prepend)
+    g_array_insert_val (keys, row->first, *key);
+  else
+    g_array_append_val (keys, *key);
+  row->n_keys++;
+}
+
+
+static void
+add_common_keys_post (GArray *keys, PosOskLayoutLayer *layer, PosOskLayoutRow *row, guint rownum)
+{
+  if (rownum == layer->n_rows - 2) {
+    PosOskLayoutKeyDef key = {
+      .use = POS_OSK_KEY_USE_DELETE,
+      .symbol = g_intern_static_string ("KEY_BACKSPACE"),
+      .icon = g_intern_static_string ("edit-clear-symbolic"),
+      .width = 1.5,
+      .style = g_intern_static_string ("sys"),
+    };
+    add_key (keys, row, FALSE, &key);
+  } else if (rownum == layer->n_rows - 1) {
+    PosOskLayoutKeyDef key = {
+      .use = POS_OSK_KEY_USE_KEY,
+      .symbol = g_intern_static_string ("KEY_ENTER"),
+      .icon = g_intern_static_string ("keyboard-enter-symbolic"),
+      .width = 2.0,
+      .style = g_intern_static_string ("return"),
+    };
+    add_key (keys, row, FALSE, &key);
+  }
+}
+
+
+static void
+add_common_keys_pre (PosOskLayout      *self,
+                     GArray            *keys,
+                     PosOskLayoutLayer *layer,
+                     PosOskLayoutRow   *row,
+                     PosOskWidgetLayer  l,
+                     guint              rownum)
+{
+  if (rownum == layer->n_rows - 2) {
+    /* Only add a shift key to the normal layer if we have a caps layer */
+    if (l != POS_OSK_WIDGET_LAYER_NORMAL ||
+        self->layers[POS_OSK_WIDGET_LAYER_CAPS].width > 0.0) {
+      PosOskLayoutKeyDef key = {
+        .use = POS_OSK_KEY_USE_TOGGLE,
+        .icon = g_intern_static_string ("keyboard-shift-filled-symbolic"),
+        .width = 1.5,
+        .style = g_intern_static_string ("toggle"),
+        .layer = POS_OSK_WIDGET_LAYER_CAPS,
+      };
+      add_key (keys, row, TRUE, &key);
+    }
+  } else if (rownum == layer->n_rows - 1) {
+    PosOskLayoutKeyDef menu = {
+      .use = POS_OSK_KEY_USE_MENU,
+      .icon = g_intern_static_string ("layout-menu-symbolic"),
+      .width = 1.0,
+      .style = g_intern_static_string ("sys"),
+    };
+    PosOskLayoutKeyDef toggle = {
+      .label = g_intern_static_string ((l == POS_OSK_WIDGET_LAYER_SYMBOLS) ? "ABC" : "123"),
+      .use = POS_OSK_KEY_USE_TOGGLE,
+      .width = 1.0,
+      .layer = POS_OSK_WIDGET_LAYER_SYMBOLS,
+      .style = g_intern_static_string ("toggle"),
+    };
+
+    add_key (keys, row, TRUE, &menu);
+    add_key (keys, row, TRUE, &toggle);
+  }
+}
+
+
+static void
+get_key (const PosLayoutKeyData *key_data, PosOskLayoutKeyDef *key)
+{
+  *key = (PosOskLayoutKeyDef) {
+    .use = POS_OSK_KEY_USE_KEY,
+    .layer = POS_OSK_WIDGET_LAYER_NORMAL,
+    .symbol = g_intern_static_string (key_data->symbol),
+    .symbols = key_data->symbols,
+  };
+
+  /* The label is per widget, see pos_osk_widget_set_layout () */
+  if (g_strcmp0 (key_data->symbol, POS_OSK_SYMBOL_SPACE) == 0) {
+    key->width = 2.0;
+    key->expand = TRUE;
+    return;
+  }
+
+  key->label = g_intern_static_string (key_data->label);
+  key->icon = g_intern_static_string (key_data->icon);
+  key->style = g_intern_static_string (key_data->style);
+  key->width = key_data->width;
+}
+
+
+static void
+build_row (PosOskLayout           *self,
+           GArray                 *keys,
+           PosOskLayoutLayer      *layer,
+           const PosLayoutRowData *row_data,
+           PosOskWidgetLayer       l,
+           guint                   r)
+{
+  PosOskLayoutRow *row = &layer->rows[r];
+
+  row->first = keys->len;
+  row->n_keys = 0;
+  row->width = 0.0;
+  for (int i = 0; i < row_data->n_keys; i++) {
+    PosOskLayoutKeyDef key;
+
+    get_key (&row_data->keys[i], &key);
+    add_key (keys, row, FALSE, &key);
+    g_ptr_array_add (self->symbols, (gpointer)key.symbol);
+  }
+
+  add_common_keys_pre (self, keys, layer, row, l, r);
+  add_common_keys_post (keys, layer, row, r);
+}
+
+
+static void
+layer_take_keys (PosOskLayoutLayer *layer, GArray *keys)
+{
+  layer->n_keys = keys->len;
+  layer->key_width = g_new (double, keys->len);
+  layer->key_use = g_new (PosOskKeyUse, keys->len);
+  layer->key_layer = g_new (PosOskWidgetLayer, keys->len);
+  layer->key_symbol = g_new (const char *, keys->len);
+  layer->key_symbol_id = g_new (PosSymbol, keys->len);
+  layer->key_label = g_new (const char *, keys->len);
+  layer->key_icon = g_new (const char *, keys->len);
+  layer->key_style = g_new (const char *, keys->len);
+  layer->key_symbols = g_new (const char *const *, keys->len);
+
+  for (int k = 0; k < keys->len; k++) {
+    PosOskLayoutKeyDef *key = &g_array_index (keys, PosOskLayoutKeyDef, k);
+
+    layer->key_width[k] = key->width;
+    layer->key_use[k] = key->use;
+    layer->key_layer[k] = key->layer;
+    layer->key_symbol[k] = key->symbol;
+    layer->key_symbol_id[k] = key->symbol ? pos_symbol_from_string (key->symbol) : POS_SYMBOL_INVALID;
+    layer->key_label[k] = key->label;
+    layer->key_icon[k] = key->icon;
+    layer->key_style[k] = key->style;
+    layer->key_symbols[k] = key->symbols;
+  }
+}
+
+
+static void
+build_rows (PosOskLayout *self, const PosLayoutLevelData *level_data)
+{
+  PosOskLayoutLayer *layer = &self->layers[level_data->layer];
+  g_autoptr (GArray) keys = NULL;
+  gdouble max_width = 0.0;
+
+  g_return_if_fail (level_data->n_rows <= POS_OSK_LAYOUT_MAX_ROWS);
+
+  layer->n_rows = level_data->n_rows;
+  keys = g_array_new (FALSE, FALSE, sizeof (PosOskLayoutKeyDef));
+
+  for (int r = 0; r < layer->n_rows; r++) {
+    build_row (self, keys, layer, &level_data->rows[r], level_data->layer, r);
+    max_width = MAX (layer->rows[r].width, max_width);
+  }
+  layer->width = max_width;
+
+  /* If the row has a key that should be expanded use that one to fill
+     the maximum width */
+  for (int r = 0; r < layer->n_rows; r++) {
+    PosOskLayoutRow *row = &layer->rows[r];
+
+    for (int k = row->first; k < row->first + row->n_keys; k++) {
+      PosOskLayoutKeyDef *key = &g_array_index (keys, PosOskLayoutKeyDef, k);
+
+      if (!key->expand)
+        continue;
+
+      if (key->width > 0) {
+        double expand = layer->width - row->width;
+
+        key->width += expand;
+        row->width += expand;
+      }
+      break;
+    }
+  }
+
+  layer_take_keys (layer, keys);
+
+  /* We know the max width, now we can calculate offsets */
+  for (int r = 0; r < layer->n_rows; r++) {
+    PosOskLayoutRow *row = &layer->rows[r];
+
+    row->offset_x = 0.5 * (layer->width - row->width);
+  }
+}
+
+
+static PosOskLayout *
+pos_osk_layout_new (const PosLayoutData *data)
+{
+  PosOskLayout *self = g_atomic_rc_box_new0 (PosOskLayout);
+  double width = 0.0;
+  guint max_rows = 0;
+
+  self->id = g_strdup (data->id);
+  self->name = g_strdup (data->name);
+  self->locale = g_strdup (data->locale);
+  self->symbols = g_ptr_array_new ();
+
+  /* Walk backwards so the caps layer is known when adding the normal layer's shift key */
+  for (int l = data->n_levels - 1; l >= 0; l--) {
+    const PosLayoutLevelData *level_data = &data->levels[l];
+    PosOskLayoutLayer *layer = &self->layers[level_data->layer];
+
+    build_rows (self, level_data);
+    width = MAX (layer->width, width);
+    max_rows = MAX (max_rows, layer->n_rows);
+  }
+  g_ptr_array_add (self->symbols, NULL);
+
+  self->n_layers = data->n_levels;
+  self->n_cols = ceil (width);
+  self->n_rows = max_rows;
+
+  g_debug ("Built %ux%u layout '%s', %d layers", self->n_cols, self->n_rows, self->id,
+           self->n_layers);
+
+  return self;
+}
+
+/**
+ * pos_osk_layout_get:
+ * @id: The layout id, e.g. `de`, `ch+fr`
+ * @err: The error location
+ *
+ * Gets the layout with the given id. If the layout is already in use
+ * the existing layout is returned, otherwise it's built from the compiled
+ * in layout data.
+ *
+ * Returns:(transfer full)(nullable): The layout or %NULL on error
+ */
+PosOskLayout *
+pos_osk_layout_get (const char *id, GError **err)
+{
+  const PosLayoutData *data;
+  PosOskLayout *self;
+
+  g_return_val_if_fail (id, NULL);
+
+  if (layouts) {
+    self = g_hash_table_lookup (layouts, id);
+    if (self)
+      return pos_osk_layout_ref (self);
+  }
+
+  data = pos_layout_data_lookup (id);
+  if (data == NULL) {
+    g_set_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No layout '%s'", id);
+    return NULL;
+  }
+
+  self = pos_osk_layout_new (data);
+
+  if (layouts == NULL)
+    layouts = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (layouts, self->id, self);
+
+  return self;
+}
+
+
+PosOskLayout *
+pos_osk_layout_ref (PosOskLayout *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+
+void
+pos_osk_layout_unref (PosOskLayout *self)
+{
+  g_atomic_rc_box_release_full (self, pos_osk_layout_free);
+}
+
+
+const char *
+pos_osk_layout_get_id (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return self->id;
+}
+
+
+const char *
+pos_osk_layout_get_name (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return self->name;
+}
+
+
+const char *
+pos_osk_layout_get_locale (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return self->locale;
+}
+
+
+guint
+pos_osk_layout_get_n_layers (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, 0);
+
+  return self->n_layers;
+}
+
+/**
+ * pos_osk_layout_get_n_rows:
+ * @self: The layout
+ *
+ * Returns: The maximum number of rows of all layers
+ */
+guint
+pos_osk_layout_get_n_rows (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, 0);
+
+  return self->n_rows;
+}
+
+/**
+ * pos_osk_layout_get_n_cols:
+ * @self: The layout
+ *
+ * Returns: The maximum width of all layers in key units
+ */
+guint
+pos_osk_layout_get_n_cols (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, 0);
+
+  return self->n_cols;
+}
+
+
+const PosOskLayoutLayer *
+pos_osk_layout_get_layer (PosOskLayout *self, PosOskWidgetLayer layer)
+{
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (layer <= POS_OSK_WIDGET_LAST_LAYER,
+                        &self->layers[POS_OSK_WIDGET_LAYER_NORMAL]);
+
+  return &self->layers[layer];
+}
+
+/**
+ * pos_osk_layout_get_symbols:
+ * @self: The layout
+ *
+ * Get the symbols on this layout.
+ *
+ * Returns:(transfer none): The symbols
+ */
+const char *const *
+pos_osk_layout_get_symbols (PosOskLayout *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return (const char * const *)self->symbols->pdata;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "pos-enums.h"
+#include "pos-symbol.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define POS_OSK_LAYOUT_MAX_ROWS 5
+
+/**
+ * PosOskLayoutRow:
+ * @first: Index of the first key of this row in the layer
+ * @n_keys: Number of keys in this row
+ * @width: number in key units
+ * @offset_x: offset from the left in key units
+ *
+ * A row of keys on a #PosOskLayoutLayer.
+ */
+typedef struct {
+  guint  first;
+  guint  n_keys;
+  double width;
+  double offset_x;
+} PosOskLayoutRow;
+
+/**
+ * PosOskLayoutLayer:
+ * @rows: The rows of this layer
+ * @n_rows: The number of rows
+ * @width: The maximum width in key units
+ * @n_keys: The number of keys in this layer
+ * @key_width: The width of each key in key units
+ * @key_use: The use of each key
+ * @key_layer: The layer a %POS_OSK_KEY_USE_TOGGLE key switches to
+ * @key_symbol: The interned symbol of each key
+ * @key_symbol_id: The symbol id of each key
+ * @key_label: The interned label of each key or %NULL
+ * @key_icon: The interned icon name of each key or %NULL
+ * @key_style: The interned style class of each key or %NULL
+ * @key_symbols: The additional (long press) symbols of each key or %NULL
+ *
+ * Describes the character layout of one layer of keys. The keys are
+ * stored row by row in arrays of @n_keys elements each so walking
+ * them doesn't need any function calls or allocations. As strings are
+ * interned they can be compared by pointer.
+ */
+typedef struct {
+  PosOskLayoutRow     rows[POS_OSK_LAYOUT_MAX_ROWS];
+  guint               n_rows;
+  double              width;
+
+  guint               n_keys;
+  double             *key_width;
+  PosOskKeyUse       *key_use;
+  PosOskWidgetLayer  *key_layer;
+  const char        **key_symbol;
+  PosSymbol          *key_symbol_id;
+  const char        **key_label;
+  const char        **key_icon;
+  const char        **key_style;
+  const char *const **key_symbols;
+} PosOskLayoutLayer;
+
+#define POS_TYPE_OSK_LAYOUT (pos_osk_layout_get_type ())
+GType   pos_osk_layout_get_type      (void) G_GNUC_CONST;
+
+typedef struct _PosOskLayout PosOskLayout;
+
+PosOskLayout            *pos_osk_layout_get (const char *id, GError **err);
+PosOskLayout            *pos_osk_layout_ref (PosOskLayout *self);
+void                     pos_osk_layout_unref (PosOskLayout *self);
+const char              *pos_osk_layout_get_id (PosOskLayout *self);
+const char              *pos_osk_layout_get_name (PosOskLayout *self);
+const char              *pos_osk_layout_get_locale (PosOskLayout *self);
+guint                    pos_osk_layout_get_n_layers (PosOskLayout *self);
+guint                    pos_osk_layout_get_n_rows (PosOskLayout *self);
+guint                    pos_osk_layout_get_n_cols (PosOskLayout *self);
+const PosOskLayoutLayer *pos_osk_layout_get_layer (PosOskLayout *self, PosOskWidgetLayer layer);
+const char *const       *pos_osk_layout_get_symbols (PosOskLayout *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PosOskLayout, pos_osk_layout_unref);
+
+G_END_DECLS
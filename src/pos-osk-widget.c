@@ -13,26 +13,42 @@
 #include "phosh-osk-enums.h"
 #include "pos-enums.h"
 #include "pos-enum-types.h"
+#include "pos-latency.h"
 #include "pos-osk-key.h"
+#include "pos-osk-layout.h"
 #include "pos-osk-widget.h"
+#include "pos-swipe-decoder.h"
+#include "pos-text-cache.h"
 #include "pos-virtual-keyboard.h"
 
-#include <json-glib/json-glib.h>
 #include <pango/pangocairo.h>
 
+#include <float.h>
 #include <math.h>
 
 #define KEY_HEIGHT 50
 #define KEY_ICON_SIZE 16
 
-/* Default us layout */
-#define LAYOUT_COLS 10
-#define LAYOUT_MAX_ROWS 5
+#define NO_KEY (-1)
 
 #define MINIMUM_WIDTH 360
 
 #define KEY_REPEAT_DELAY 700
 #define KEY_REPEAT_INTERVAL 50
+/* Number of repeats after which deletion switches to whole words */
+#define KEY_REPEAT_WORD_THRESHOLD 20
+#define KEY_REPEAT_WORD_INTERVAL 150
+/* Factor applied to gtk-long-press-time */
+#define LONG_PRESS_DELAY_FACTOR 0.5
+/* Maximum number of words a swipe is decoded to */
+#define MAX_SWIPE_RESULTS 4
+
+/* Adaptive keys: Distance to a key's border (in key sizes) considered close */
+#define ADAPTIVE_MARGIN 0.35
+/* Adaptive keys: Standard deviation of touches around a key's center (in key sizes) */
+#define ADAPTIVE_SIGMA 0.45
+/* Adaptive keys: Probability assumed for characters the completer didn't predict */
+#define ADAPTIVE_FLOOR 0.01
 
 enum {
   OSK_KEY_DOWN,
@@ -41,6 +57,9 @@ enum {
   OSK_KEY_SYMBOL,
   OSK_POPOVER_SHOWN,
   OSK_POPOVER_HIDDEN,
+  OSK_SWIPE,
+  OSK_CURSOR_MOTION,
+  OSK_DELETE_REPEAT,
   N_SIGNALS
 };
 static guint signals[N_SIGNALS];
@@ -56,58 +75,122 @@ enum {
 static GParamSpec *props[PROP_LAST_PROP];
 
 /**
- * PosOskWidgetRow:
- * @width: number in key units
- * @offset_x: offset from the right in key units
+ * PosOskWidgetKeyboardLayer:
+ * @offset_x: Offset of this layer from the left side in pixels
+ * @offset_y: Offset of the first row from the top in pixels
+ * @key_width: Key width in pixels of a 1 unit wide key
+ * @key_height: key height in pixels of a 1 unit high key
+ * @boxes: The bounding boxes of the layer's keys
+ * @row_grid: The row at each pixel row of the widget or `NO_KEY`
+ * @key_grid: The key at each pixel column of the widget, one line per row
+ * @key_prob: The probability of each key to be typed next or `-1` for keys
+ *   that aren't characters. %NULL if there are no probabilities.
+ * @surface: The rendered layer with no pressed keys
+ * @surface_mode: The widget mode @surface was rendered in
+ * @valid: The area of @surface that is already rendered
  *
- * A key row on a #PosOskWidgetKeyboardLayer of the #PosOskWidget.
- * Renders the keys and reacts to touch and pointer events. Much
- * of the logic can go if we use GtkWidgets for the keys itself.
+ * The geometry of one layer of keys. The keys themselves are
+ * in the (shared) #PosOskLayout.
+ *
+ * Rendering all keys is expensive so the layer is rendered once
+ * into @surface which is then only composited. Pressed keys are drawn
+ * on top of it. The surface is dropped whenever size, scale or style
+ * change. It's filled on demand so only keys in damaged areas get
+ * rendered.
  */
 typedef struct {
-  GPtrArray *keys;
-  double     width;
-  double     offset_x;
-} PosOskWidgetRow;
+  int               offset_x;
+  int               offset_y;
+  double            key_width;
+  double            key_height;
+  GdkRectangle     *boxes;
+  gint8            *row_grid;
+  gint16           *key_grid;
+  float            *key_prob;
+  cairo_surface_t  *surface;
+  PosOskWidgetMode  surface_mode;
+  cairo_region_t   *valid;
+} PosOskWidgetKeyboardLayer;
 
 /**
- * PosOskWidgetKeyboardLayer:
- * @width: The maximum width in key units
- * @offset_x: Offset of this layer from the left side in pixels
- * @key_width: Key width in pixels of a 1 unit wide key
- * @key_height: key height in pixels of a 1 unit high key
+ * PosOskWidgetKeyStyle:
+ * @context: Style context with the key's style classes applied
+ * @font: The label font
+ * @color: The label color
+ * @margin: The key's margin
+ * @border: The key's border width
+ * @hint_font: The font of the long press hint
+ * @hint_color: The color of the long press hint
+ * @hint_margin: The margin of the long press hint
+ * @hint_border: The border width of the long press hint
  *
- * Describes the character layout of one layer of keys.
+ * The resolved style of a key for a given style class and pressed
+ * state so drawing doesn't need to match CSS for every key.
  */
 typedef struct {
-  PosOskWidgetRow rows[LAYOUT_MAX_ROWS];
-  double          width;
+  GtkStyleContext      *context;
+  PangoFontDescription *font;
+  GdkRGBA               color;
+  GtkBorder             margin;
+  GtkBorder             border;
+  PangoFontDescription *hint_font;
+  GdkRGBA               hint_color;
+  GtkBorder             hint_margin;
+  GtkBorder             hint_border;
+} PosOskWidgetKeyStyle;
 
-  int             offset_x;
-  double          key_width;
-  double          key_height;
-  guint           n_rows;
-} PosOskWidgetKeyboardLayer;
+/**
+ * PosOskWidgetIconKey:
+ * @icon: The interned icon name
+ * @size: The icon size
+ * @scale: The scale factor
+ * @color: The foreground color symbolic icons are colored with
+ *
+ * Identifies an icon in the icon cache.
+ */
+typedef struct {
+  const char *icon;
+  int         size;
+  int         scale;
+  GdkRGBA     color;
+} PosOskWidgetIconKey;
 
 /**
- * PosOskWidgetLayout:
- * @name: The display name of the layout, e.g. `English Great Britain`, `English Great (US)`
- * @locale: The layout's `locale` field as parsed from the data, e.g. `en-GB`, `en`
- *  For internal use only.
+ * PosOskWidgetPress:
+ * @self: The widget the key is pressed on
+ * @sequence: The touch sequence pressing the key, %NULL for the pointer
+ * @key: The pressed key
+ * @layer: The layer @key is on
+ * @x: The x coordinate the press started at
+ * @y: The y coordinate the press started at
+ * @repeat_id: The key repeat timer
+ * @long_press_id: The long press timer
+ * @released: Whether the key was released but processing the release
+ *   is held back until keys pressed earlier are released.
+ * @trace: The points (`PosSwipePoint`) of a swipe or %NULL when not swiping
+ * @n_repeats: How often the key repeated so far
+ * @motion_pending: Whether the press moved since the last frame
+ * @motion_x: The x coordinate the press last moved to
+ * @motion_y: The y coordinate the press last moved to
  *
- * Information about a keyboard layout as parsed from the layout
- * file. The keys are grouped in different layers that are displayed
- * depending on modifier state.
+ * A key pressed by the pointer or a touch. Several keys can be pressed
+ * at once so typing isn't interrupted when the next key is touched before
+ * the previous one is released.
  */
 typedef struct {
-  char                     *name;
-  char                     *locale;
-  PosOskWidgetKeyboardLayer layers[POS_OSK_WIDGET_LAST_LAYER + 1];
-  guint                     n_layers;
-  guint                     n_cols;
-  guint                     n_rows;
-  double                    width;
-} PosOskWidgetLayout;
+  PosOskWidget      *self;
+  GdkEventSequence  *sequence;
+  int                key;
+  PosOskWidgetLayer  layer;
+  double             x, y;
+  guint              repeat_id;
+  guint              n_repeats;
+  guint              long_press_id;
+  gboolean           released;
+  GArray            *trace;
+  gboolean           motion_pending;
+  double             motion_x, motion_y;
+} PosOskWidgetPress;
 
 /**
  * PosOskWidget:
@@ -123,13 +206,18 @@ struct _PosOskWidget {
 
   PhoshOskFeatures     features;
   int                  width, height;
-  PosOskWidgetLayout   layout;
+  PosOskLayout        *layout;
+  PosOskWidgetKeyboardLayer layers[POS_OSK_WIDGET_LAST_LAYER + 1];
 
-  GtkStyleContext     *key_context;
+  GtkWidgetPath       *key_path;
+  /* Resolved key styles by interned style class, unpressed and pressed */
+  GHashTable          *key_styles[2];
+  /* Loaded icons by PosOskWidgetIconKey */
+  GHashTable          *icons;
+  /* The theme of the widget's screen the icons got loaded from */
+  GtkIconTheme        *icon_theme;
   PosOskWidgetLayer    layer;
   PosOskWidgetMode     mode;
-  /* Contains pointers to key symbols (keys have ownership) */
-  GPtrArray           *symbols;
 
   char                *name;
   char                *display_name;
@@ -137,18 +225,35 @@ struct _PosOskWidget {
   char                *region;
   char                *layout_id;
 
-  PosOskKey           *current;
-  PosOskKey           *space;
-  GtkGestureLongPress *long_press;
+  /* The pressed keys (PosOskWidgetPress) in the order they were pressed */
+  GQueue               presses;
+  /* Index of the space key in the current layer while in cursor mode */
+  int                  space;
+  /* The currently shown char popup, if any */
   GtkWidget           *char_popup;
-  guint                repeat_id;
+  /* Char popups by the (layout owned) symbols they show */
+  GHashTable          *char_popups;
+  guint                prebuild_id;
+  PosOskWidgetLayer    prebuild_layer;
+  guint                prebuild_key;
+  PosSwipeDecoder     *swipe_decoder;
+
+  /* Motion is processed once per frame */
+  guint                tick_id;
 
   /* Cursor movement */
   GtkGesture          *cursor_drag;
   double               last_x, last_y;
+  /* Movement since the last frame */
+  double               frame_dx, frame_dy;
+  /* Accelerated movement not yet turned into cursor steps */
+  double               cursor_dx, cursor_dy;
 };
 G_DEFINE_TYPE (PosOskWidget, pos_osk_widget, GTK_TYPE_DRAWING_AREA)
 
+static void pos_osk_widget_long_press (PosOskWidget *self, PosOskWidgetPress *press);
+static void pos_osk_widget_ensure_tick (PosOskWidget *self);
+
 
 static void
 on_drag_begin (PosOskWidget *self,
@@ -161,33 +266,55 @@ on_drag_begin (PosOskWidget *self,
 
 #define KEY_DIST_X 5
 #define KEY_DIST_Y 10
+/* Horizontal movement per frame above which the cursor accelerates */
+#define CURSOR_ACCEL_THRESHOLD 8.0
+#define CURSOR_ACCEL_MAX 4.0
 
 static void
 on_drag_update (PosOskWidget *self,
                 double        off_x,
                 double        off_y)
 {
-  const char *symbol = NULL;
-  double delta_x, delta_y;
-
   if (self->mode != POS_OSK_WIDGET_MODE_CURSOR)
     return;
 
-  g_debug ("%s: %f, %f", __func__, off_x, off_y);
+  /* Just accumulate, the cursor is moved once per frame */
+  self->frame_dx += off_x - self->last_x;
+  self->frame_dy += off_y - self->last_y;
+  self->last_x = off_x;
+  self->last_y = off_y;
 
-  delta_x = self->last_x - off_x;
-  delta_y = self->last_y - off_y;
+  pos_osk_widget_ensure_tick (self);
+}
 
-  if (ABS (delta_x) > KEY_DIST_X) {
-    symbol =  delta_x > 0 ? POS_OSK_SYMBOL_LEFT : POS_OSK_SYMBOL_RIGHT;
-    self->last_x = off_x;
-  } else if (ABS (delta_y) > KEY_DIST_Y) {
-    symbol =  delta_y > 0 ? POS_OSK_SYMBOL_UP : POS_OSK_SYMBOL_DOWN;
-    self->last_y = off_y;
-  }
 
-  if (symbol)
-    g_signal_emit (self, signals[OSK_KEY_SYMBOL], 0, symbol);
+/* Turn the movement since the last frame into a single batch of cursor steps */
+static void
+pos_osk_widget_flush_cursor_motion (PosOskWidget *self)
+{
+  double gain;
+  int dx, dy;
+
+  if (G_APPROX_VALUE (self->frame_dx, 0.0, DBL_EPSILON) &&
+      G_APPROX_VALUE (self->frame_dy, 0.0, DBL_EPSILON))
+    return;
+
+  /* Fast horizontal drags move the cursor further */
+  gain = CLAMP (ABS (self->frame_dx) / CURSOR_ACCEL_THRESHOLD, 1.0, CURSOR_ACCEL_MAX);
+  self->cursor_dx += self->frame_dx * gain;
+  self->cursor_dy += self->frame_dy;
+  self->frame_dx = self->frame_dy = 0.0;
+
+  dx = self->cursor_dx / KEY_DIST_X;
+  dy = self->cursor_dy / KEY_DIST_Y;
+  self->cursor_dx -= dx * KEY_DIST_X;
+  self->cursor_dy -= dy * KEY_DIST_Y;
+
+  if (dx == 0 && dy == 0)
+    return;
+
+  g_debug ("Moving cursor by %d, %d", dx, dy);
+  g_signal_emit (self, signals[OSK_CURSOR_MOTION], 0, dx, dy);
 }
 
 
@@ -197,6 +324,7 @@ on_drag_end (PosOskWidget *self)
   if (self->mode != POS_OSK_WIDGET_MODE_CURSOR)
     return;
 
+  pos_osk_widget_flush_cursor_motion (self);
   pos_osk_widget_set_mode (self, POS_OSK_WIDGET_MODE_KEYBOARD);
 }
 
@@ -215,413 +343,60 @@ static PosOskWidgetKeyboardLayer *
 pos_osk_widget_get_keyboard_layer (PosOskWidget *self, PosOskWidgetLayer layer)
 {
   g_return_val_if_fail (layer <= POS_OSK_WIDGET_LAST_LAYER,
-                        &self->layout.layers[POS_OSK_WIDGET_LAYER_NORMAL]);
+                        &self->layers[POS_OSK_WIDGET_LAYER_NORMAL]);
 
-  return &self->layout.layers[layer];
+  return &self->layers[layer];
 }
 
 
 static PosOskWidgetKeyboardLayer *
 pos_osk_widget_get_current_layer (PosOskWidget *self)
 {
-  return &self->layout.layers[self->layer];
-}
-
-
-static PosOskWidgetRow *
-pos_osk_widget_get_layer_row (PosOskWidget *self, PosOskWidgetLayer layer, guint row)
-{
-  PosOskWidgetKeyboardLayer *l;
-
-  g_return_val_if_fail (row < LAYOUT_MAX_ROWS, 0);
-
-  l = pos_osk_widget_get_keyboard_layer (self, layer);
-  return &l->rows[row];
-}
-
-
-static PosOskWidgetRow *
-pos_osk_widget_get_row (PosOskWidget *self, guint row)
-{
-  PosOskWidgetKeyboardLayer *l;
-
-  l = pos_osk_widget_get_current_layer (self);
-  return &l->rows[row];
-}
-
-
-static guint
-pos_osk_widget_row_get_num_keys (PosOskWidgetRow *row)
-{
-  if (row->keys == NULL)
-    return 0;
-
-  return row->keys->len;
-}
-
-
-static PosOskKey *
-pos_osk_widget_row_get_key (PosOskWidgetRow *row, guint n)
-{
-  g_return_val_if_fail (n < pos_osk_widget_row_get_num_keys (row), NULL);
-
-  return g_ptr_array_index (row->keys, n);
-}
-
-
-static void
-pos_osk_widget_layout_free (PosOskWidgetLayout *layout)
-{
-  g_clear_pointer (&layout->name, g_free);
-  g_clear_pointer (&layout->locale, g_free);
-
-  for (int l = 0; l < layout->n_layers; l++) {
-    for (int r = 0; r < layout->n_rows; r++) {
-      if (layout->layers[l].rows[r].keys) {
-        g_ptr_array_free (layout->layers[l].rows[r].keys, TRUE);
-        layout->layers[l].rows[r].keys = NULL;
-      }
-    }
-  }
-}
-
-
-static void
-add_common_keys_post (PosOskWidgetRow *row, PosOskWidgetLayer layer, gint rownum, guint max_rows)
-{
-  PosOskKey *key;
-
-  if (rownum == max_rows - 2) {
-    key = g_object_new (POS_TYPE_OSK_KEY,
-                        "use", POS_OSK_KEY_USE_DELETE,
-                        "symbol", "KEY_BACKSPACE",
-                        "icon", "edit-clear-symbolic",
-                        "width", 1.5,
-                        "style", "sys",
-                        NULL);
-    row->width += pos_osk_key_get_width (key);
-    g_ptr_array_insert (row->keys, -1, key);
-  } else if (rownum == max_rows - 1) {
-    key = g_object_new (POS_TYPE_OSK_KEY,
-                        "symbol", "KEY_ENTER",
-                        "icon", "keyboard-enter-symbolic",
-                        "width", 2.0,
-                        "style", "return",
-                        NULL);
-    row->width += pos_osk_key_get_width (key);
-    g_ptr_array_insert (row->keys, -1, key);
-  }
-}
-
-
-static void
-add_common_keys_pre (PosOskWidget      *self,
-                     PosOskWidgetRow   *row,
-                     PosOskWidgetLayer  layer,
-                     gint               rownum,
-                     guint              max_rows)
-{
-  PosOskKey *key;
-  const char *label;
-
-  if (rownum == max_rows - 2) {
-    /* Only add a shift key to the normal layer if we have a caps layer */
-    if (layer != POS_OSK_WIDGET_LAYER_NORMAL ||
-        self->layout.layers[POS_OSK_WIDGET_LAYER_CAPS].width > 0.0) {
-      key = g_object_new (POS_TYPE_OSK_KEY,
-                          "use", POS_OSK_KEY_USE_TOGGLE,
-                          "icon", "keyboard-shift-filled-symbolic",
-                          "width", 1.5,
-                          "style", "toggle",
-                          "layer", POS_OSK_WIDGET_LAYER_CAPS,
-                          NULL);
-      row->width += pos_osk_key_get_width (key);
-      g_ptr_array_insert (row->keys, 0, key);
-    }
-  } else if (rownum == max_rows - 1) {
-    key = g_object_new (POS_TYPE_OSK_KEY,
-                        "use", POS_OSK_KEY_USE_MENU,
-                        "icon", "layout-menu-symbolic",
-                        "width", 1.0,
-                        "style", "sys",
-                        NULL);
-    row->width += pos_osk_key_get_width (key);
-    g_ptr_array_insert (row->keys, 0, key);
-
-    label = (layer == POS_OSK_WIDGET_LAYER_SYMBOLS) ? "ABC" : "123";
-    key = g_object_new (POS_TYPE_OSK_KEY,
-                        "label", label,
-                        "use", POS_OSK_KEY_USE_TOGGLE,
-                        "width", 1.0,
-                        "layer", POS_OSK_WIDGET_LAYER_SYMBOLS,
-                        "style", "toggle",
-                        NULL);
-    row->width += pos_osk_key_get_width (key);
-    g_ptr_array_insert (row->keys, 0, key);
-  }
+  return &self->layers[self->layer];
 }
 
 
-static PosOskKey *
-get_key (PosOskWidget *self, const char *symbol, GStrv symbols, const char *label,
-         const char *style, guint num_keys)
+static const PosOskLayoutLayer *
+pos_osk_widget_get_layout_layer (PosOskWidget *self, PosOskWidgetLayer layer)
 {
-  if (g_strcmp0 (symbol, " ") == 0) {
-    return g_object_new (POS_TYPE_OSK_KEY,
-                         "label", self->display_name,
-                         "symbol", symbol,
-                         "symbols", symbols,
-                         "width", 2.0,
-                         "expand", TRUE,
-                         NULL);
-  }
-  return g_object_new (POS_TYPE_OSK_KEY,
-                       "symbol", symbol,
-                       "symbols", symbols,
-                       "label", label,
-                       "style", style,
-                       NULL);
+  return pos_osk_layout_get_layer (self->layout, layer);
 }
 
 
-static GStrv
-parse_symbols (JsonArray *array)
+/* A name for the key suitable for debug output */
+static const char *
+pos_osk_widget_get_key_dbg (PosOskWidget *self, PosOskWidgetLayer layer, int n)
 {
-  g_autoptr (GPtrArray) syms_array = g_ptr_array_new_with_free_func (g_free);
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, layer);
 
-  if (json_array_get_length (array) == 1)
+  if (n == NO_KEY)
     return NULL;
 
-  for (int i = 1; i < json_array_get_length (array); i++) {
-    char *sym = g_strdup (json_array_get_string_element (array, i));
-
-    g_ptr_array_add (syms_array, sym);
-  }
-  g_ptr_array_add (syms_array, NULL);
-
-  return (GStrv) g_ptr_array_steal (syms_array, NULL);
+  return layout_layer->key_label[n] ?: layout_layer->key_symbol[n];
 }
 
 
 static void
-parse_row (PosOskWidget      *self,
-           PosOskWidgetRow   *row,
-           JsonArray         *arow,
-           PosOskWidgetLayer  l,
-           guint              r,
-           guint              max_rows)
-{
-  gsize num_keys;
-
-  num_keys = json_array_get_length (arow);
-  row->keys = g_ptr_array_sized_new (num_keys + 2);
-  g_ptr_array_set_free_func (row->keys, g_object_unref);
-
-  row->width = 0.0;
-  for (int i = 0; i < num_keys; i++) {
-    JsonNode *key_node;
-    g_autoptr (PosOskKey) key = NULL;
-    g_auto (GStrv) symbols = NULL;
-
-    key_node = json_array_get_element (arow, i);
-    if (JSON_NODE_HOLDS (key_node, JSON_NODE_ARRAY)) {
-      JsonArray *all_symbols = json_array_get_array_element (arow, i);
-      const char *symbol = json_array_get_string_element (all_symbols, 0);
-
-      symbols = parse_symbols (all_symbols);
-      key = get_key (self, symbol, symbols, NULL, NULL, num_keys);
-    } else if (JSON_NODE_HOLDS (key_node, JSON_NODE_OBJECT)) {
-      key = POS_OSK_KEY (json_gobject_deserialize (POS_TYPE_OSK_KEY, key_node));
-    } else {
-      g_warning ("Unparseable key in row %d pos %d", r, i);
-      continue;
-    }
-
-    row->width += pos_osk_key_get_width (key);
-    g_ptr_array_add (self->symbols, (gpointer)pos_osk_key_get_symbol (key));
-    g_ptr_array_add (row->keys, g_steal_pointer (&key));
-  }
-
-  add_common_keys_pre (self, row, l, r, max_rows);
-  add_common_keys_post (row, l, r, max_rows);
-}
-
-
-
-static gboolean
-parse_rows (PosOskWidget *self, PosOskWidgetKeyboardLayer *layer, JsonArray *rows, PosOskWidgetLayer l)
+pos_osk_widget_clear_render_cache (PosOskWidget *self)
 {
-  gsize num_rows;
-  gboolean ret = FALSE;
-  gdouble max_width = 0.0;
-
-  num_rows = json_array_get_length (rows);
-  layer->n_rows = num_rows;
-
-  for (int r = 0; r < num_rows; r++) {
-    PosOskWidgetRow *row;
-    JsonArray *arow;
-
-    row = pos_osk_widget_get_layer_row (self, l, r);
-    arow = json_array_get_array_element (rows, r);
-    if (arow == NULL) {
-      g_warning ("Failed to get row %d", r);
-      ret = FALSE;
-      continue;
-    }
-    parse_row (self, row, arow, l, r, layer->n_rows);
-
-    max_width = MAX (row->width, max_width);
-  }
-  layer->width = max_width;
-
-  /* If the row has a key that should be expanded use that one to fill
-     the maximum width */
-  for (int r = 0; r < num_rows; r++) {
-    PosOskWidgetRow *row = pos_osk_widget_get_layer_row (self, l, r);
-    PosOskKey *expand_key = NULL;
-
-    /* Find possible key to expand */
-    for (int k = 0; k < row->keys->len; k++) {
-      PosOskKey *key = g_ptr_array_index (row->keys, k);
-
-      if (pos_osk_key_get_expand (key)) {
-        expand_key = key;
-        break;
-      }
-    }
-
-    if (expand_key) {
-      float width = pos_osk_key_get_width (expand_key);
-      float expand = layer->width - row->width;
-      if (width > 0) {
-        pos_osk_key_set_width (expand_key, width + expand);
-        row->width += expand;
-      }
-    }
-  }
-
-  /* We know the max width, now we can calculate offsets */
-  for (int r = 0; r < num_rows; r++) {
-    PosOskWidgetRow *row = pos_osk_widget_get_layer_row (self, l, r);
-
-    row->offset_x = 0.5 * (layer->width - row->width);
-  }
-
-  return ret;
-}
-
-
-static gboolean
-parse_layers (PosOskWidget *self, JsonArray *layers)
-{
-  gsize len;
-  JsonArray *rows;
-  gboolean ret = FALSE;
-  double width = 0.0;
-  guint max_rows = 0;
-
-  len = json_array_get_length (layers);
-  for (int l = len-1; l >= 0; l--) {
-    PosOskWidgetKeyboardLayer *layer;
-    PosOskWidgetLayer ltype;
-    JsonObject *alayer;
-    const char *name;
-
-    if (l > POS_OSK_WIDGET_LAST_LAYER) {
-      g_warning ("Skipping layer %d", l);
-      continue;
-    }
-
-    alayer = json_array_get_object_element (layers, l);
-    if (alayer == NULL) {
-      g_warning ("Failed to get layer %d", l);
-      ret = FALSE;
-      continue;
-    }
-
-    rows = json_object_get_array_member (alayer, "rows");
-    if (rows == NULL) {
-      g_warning ("Failed to get rows for layer %d", l);
-      ret = FALSE;
-      continue;
-    }
-
-    name = json_object_get_string_member (alayer, "level");
-    if (g_strcmp0 (name, "")  == 0) {
-      ltype = POS_OSK_WIDGET_LAYER_NORMAL;
-    } else if (g_strcmp0 (name, "shift")  == 0) {
-      ltype = POS_OSK_WIDGET_LAYER_CAPS;
-    } else if (g_strcmp0 (name, "opt")  == 0) {
-      ltype = POS_OSK_WIDGET_LAYER_SYMBOLS;
-    } else if (g_strcmp0 (name, "opt+shift")  == 0) {
-      ltype = POS_OSK_WIDGET_LAYER_SYMBOLS2;
-    } else {
-      g_warning ("Unknown layer '%s' at %d", name, l);
-      ret = FALSE;
-      continue;
-    }
-
-    layer = pos_osk_widget_get_keyboard_layer (self, ltype);
-    parse_rows (self, layer, rows, ltype);
-    width = MAX (layer->width, width);
-
-    max_rows = MAX (max_rows, layer->n_rows);
+  for (int l = 0; l <= POS_OSK_WIDGET_LAST_LAYER; l++) {
+    g_clear_pointer (&self->layers[l].surface, cairo_surface_destroy);
+    g_clear_pointer (&self->layers[l].valid, cairo_region_destroy);
   }
-
-  self->layout.n_layers = len;
-  self->layout.n_cols = ceil (width);
-  self->layout.n_rows = max_rows;
-
-  g_debug ("Using %ux%u layout, %d layers", self->layout.n_cols, self->layout.n_rows, self->layout.n_layers);
-
-  return ret;
 }
 
 
-static gboolean
-parse_layout (PosOskWidget *self, const char *json, gsize size)
+static void
+pos_osk_widget_clear_geometry (PosOskWidget *self)
 {
-  g_autoptr (JsonParser) parser = NULL;
-  g_autoptr (GError) err = NULL;
-  const char *name;
-  const char *locale;
-  JsonNode *keyboard_node;
-  JsonObject *keyboard;
-  JsonArray *levels;
-
-  parser = json_parser_new ();
-  json_parser_load_from_data (parser, json, size, &err);
-
-  keyboard_node = json_parser_get_root (parser);
-
-  if (JSON_NODE_TYPE (keyboard_node) != JSON_NODE_OBJECT) {
-    g_critical ("Failed to parse layout, root node not an object");
-    return FALSE;
-  }
-  keyboard = json_node_get_object (keyboard_node);
-
-  name = json_object_get_string_member (keyboard, "name");
-  if (name == NULL) {
-    g_critical ("Failed to parse layout without name");
-    return FALSE;
-  }
-  self->layout.name = g_strdup (name);
-
-  locale = json_object_get_string_member (keyboard, "locale");
-  if (locale != NULL)
-    self->layout.locale = g_strdup (locale);
-
-  levels = json_object_get_array_member (keyboard, "levels");
-  if (levels == NULL) {
-    g_critical ("Failed to parse layout, malformed levels");
-    return FALSE;
+  for (int l = 0; l <= POS_OSK_WIDGET_LAST_LAYER; l++) {
+    g_clear_pointer (&self->layers[l].boxes, g_free);
+    g_clear_pointer (&self->layers[l].row_grid, g_free);
+    g_clear_pointer (&self->layers[l].key_grid, g_free);
+    g_clear_pointer (&self->layers[l].key_prob, g_free);
   }
-  parse_layers (self, levels);
-
-  g_ptr_array_add (self->symbols, NULL);
 
-  return TRUE;
+  pos_osk_widget_clear_render_cache (self);
 }
 
 
@@ -673,10 +448,10 @@ pos_osk_widget_get_property (GObject    *object,
 
 
 static PosOskWidgetLayer
-select_symbols2 (PosOskWidget *self, PosOskKey *key)
+select_symbols2 (PosOskWidget *self, PosOskWidgetLayer layer)
 {
   /* Only shift key can toggle symbols2 */
-  if (pos_osk_key_get_layer (key) != POS_OSK_WIDGET_LAYER_CAPS)
+  if (layer != POS_OSK_WIDGET_LAYER_CAPS)
     return self->layer;
 
   if (pos_osk_widget_get_layer (self) == POS_OSK_WIDGET_LAYER_SYMBOLS)
@@ -690,24 +465,42 @@ select_symbols2 (PosOskWidget *self, PosOskKey *key)
 
 
 static void
-pos_osk_widget_set_key_pressed (PosOskWidget *self, PosOskKey *key, gboolean pressed)
+pos_osk_widget_queue_draw_key (PosOskWidget *self, PosOskWidgetLayer layer, int n)
 {
+  PosOskWidgetKeyboardLayer *l = pos_osk_widget_get_keyboard_layer (self, layer);
   const GdkRectangle *box;
 
-  pos_osk_key_set_pressed (key, pressed);
-  box = pos_osk_key_get_box (key);
-  gtk_widget_queue_draw_area (GTK_WIDGET (self), box->x, box->y, box->width, box->height);
+  if (n == NO_KEY || layer != self->layer || l->boxes == NULL)
+    return;
+
+  box = &l->boxes[n];
+  gtk_widget_queue_draw_area (GTK_WIDGET (self), l->offset_x + box->x, box->y,
+                              box->width, box->height);
+}
+
+
+/* Toggles are pressed while their layer is active */
+static gboolean
+pos_osk_widget_is_key_toggled (PosOskWidget *self, int n)
+{
+  const PosOskLayoutLayer *layout_layer;
+
+  layout_layer = pos_osk_widget_get_layout_layer (self, self->layer);
+  if (layout_layer->key_use[n] != POS_OSK_KEY_USE_TOGGLE)
+    return FALSE;
+
+  return (self->layer == layout_layer->key_layer[n]) ||
+    (self->layer == POS_OSK_WIDGET_LAYER_SYMBOLS2);
 }
 
 
 static void
-switch_layer (PosOskWidget *self, PosOskKey *key)
+switch_layer (PosOskWidget *self, PosOskKeyUse use, PosOskWidgetLayer layer)
 {
   PosOskWidgetLayer new_layer = self->layer;
-  PosOskWidgetLayer layer = pos_osk_key_get_layer (key);
 
-  if (pos_osk_key_get_use (key) == POS_OSK_KEY_USE_TOGGLE) {
-    new_layer = select_symbols2 (self, key);
+  if (use == POS_OSK_KEY_USE_TOGGLE) {
+    new_layer = select_symbols2 (self, layer);
     if (new_layer == self->layer) {
       switch (layer) {
       case POS_OSK_WIDGET_LAYER_CAPS:
@@ -733,47 +526,159 @@ switch_layer (PosOskWidget *self, PosOskKey *key)
 }
 
 
-static PosOskKey *
+static int
+pos_osk_widget_lookup_grid (PosOskWidget *self, PosOskWidgetKeyboardLayer *layer, int row, double x)
+{
+  int col = CLAMP ((int)floor (x), 0, self->width - 1);
+
+  return layer->key_grid[row * self->width + col];
+}
+
+/*
+ * pos_osk_widget_resolve_adaptive:
+ * @self: The osk widget
+ * @layer: The current layer
+ * @x: The touch's x coordinate
+ * @y: The touch's y coordinate
+ * @row: The row that was hit
+ * @key: The key that was hit
+ *
+ * Resolve a touch close to the border of a character key to the
+ * neighbouring key that is most likely meant. Touches are assumed to
+ * scatter normally around the key center. This is weighted with the
+ * probability of the key to be typed next.
+ *
+ * Returns: The key that is most likely meant
+ */
+static int
+pos_osk_widget_resolve_adaptive (PosOskWidget              *self,
+                                 PosOskWidgetKeyboardLayer *layer,
+                                 double                     x,
+                                 double                     y,
+                                 int                        row,
+                                 int                        key)
+{
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, self->layer);
+  double margin_x = ADAPTIVE_MARGIN * layer->key_width;
+  double margin_y = ADAPTIVE_MARGIN * layer->key_height;
+  double best_score = -G_MAXDOUBLE;
+  int candidates[5];
+  int best = key;
+  int n = 0;
+
+  /* Only characters are adapted, never e.g. shift or backspace */
+  if (layer->key_prob[key] < 0)
+    return key;
+
+  candidates[n++] = key;
+  candidates[n++] = pos_osk_widget_lookup_grid (self, layer, row, x - margin_x);
+  candidates[n++] = pos_osk_widget_lookup_grid (self, layer, row, x + margin_x);
+  if (row > 0 && y - margin_y < layer->offset_y + row * layer->key_height)
+    candidates[n++] = pos_osk_widget_lookup_grid (self, layer, row - 1, x);
+  if (row < (int)layout_layer->n_rows - 1 &&
+      y + margin_y >= layer->offset_y + (row + 1) * layer->key_height)
+    candidates[n++] = pos_osk_widget_lookup_grid (self, layer, row + 1, x);
+
+  for (int i = 0; i < n; i++) {
+    int k = candidates[i];
+    const GdkRectangle *box;
+    double dx, dy, score;
+
+    if (k == NO_KEY || layer->key_prob[k] < 0)
+      continue;
+
+    box = &layer->boxes[k];
+    dx = (x - layer->offset_x - (box->x + 0.5 * box->width)) / (ADAPTIVE_SIGMA * box->width);
+    dy = (y - (box->y + 0.5 * box->height)) / (ADAPTIVE_SIGMA * box->height);
+    score = log (layer->key_prob[k] + ADAPTIVE_FLOOR) - 0.5 * (dx * dx + dy * dy);
+    if (score > best_score) {
+      best_score = score;
+      best = k;
+    }
+  }
+
+  if (best != key) {
+    g_debug ("Adaptive keys: '%s' instead of '%s'",
+             layout_layer->key_symbol[best], layout_layer->key_symbol[key]);
+  }
+
+  return best;
+}
+
+
+static int
 pos_osk_widget_locate_key (PosOskWidget *self, double x, double y)
 {
-  int row_num;
-  PosOskWidgetRow *row;
-  PosOskKey *key = NULL;
-  double pos_x;
+  int row, key;
   PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
-  guint off_y = self->height - (layer->n_rows * layer->key_height);
 
-  pos_x = x - layer->offset_x;
+  g_return_val_if_fail (self->layout, NO_KEY);
+  g_return_val_if_fail (layer->key_grid, NO_KEY);
 
-  row_num = (int)((y - off_y) / layer->key_height);
-  g_return_val_if_fail (row_num < self->layout.n_rows, NULL);
+  /* Points outside the widget (e.g. when dragging) hit the closest key */
+  row = layer->row_grid[CLAMP ((int)floor (y), 0, self->height - 1)];
+  g_return_val_if_fail (row != NO_KEY, NO_KEY);
 
-  row = pos_osk_widget_get_row (self, row_num);
-  pos_x -= row->offset_x * layer->key_width;
-  for (int k = 0; k < pos_osk_widget_row_get_num_keys (row); k++) {
-    key = pos_osk_widget_row_get_key (row, k);
+  key = pos_osk_widget_lookup_grid (self, layer, row, x);
+  if (layer->key_prob && key != NO_KEY)
+    key = pos_osk_widget_resolve_adaptive (self, layer, x, y, row, key);
 
-    pos_x -= pos_osk_key_get_width (key) * layer->key_width;
-    if (pos_x <= 0)
-      break;
+  return key;
+}
+
+
+static const char *
+pos_osk_widget_get_press_symbol (PosOskWidget *self, PosOskWidgetPress *press)
+{
+  return pos_osk_widget_get_layout_layer (self, press->layer)->key_symbol[press->key];
+}
+
+
+static PosOskWidgetPress *
+pos_osk_widget_find_press (PosOskWidget *self, GdkEventSequence *sequence)
+{
+  for (GList *l = self->presses.head; l; l = l->next) {
+    PosOskWidgetPress *press = l->data;
+
+    if (press->sequence == sequence && press->released == FALSE)
+      return press;
   }
 
-  g_return_val_if_fail (key != NULL, NULL);
+  return NULL;
+}
+
 
-  return key;
+static void
+pos_osk_widget_press_free (PosOskWidgetPress *press)
+{
+  g_clear_handle_id (&press->repeat_id, g_source_remove);
+  g_clear_handle_id (&press->long_press_id, g_source_remove);
+  g_clear_pointer (&press->trace, g_array_unref);
+  g_free (press);
 }
 
 
 static gboolean
 on_key_repeat (gpointer data)
 {
-  PosOskWidget *self = POS_OSK_WIDGET (data);
+  PosOskWidgetPress *press = data;
+  const char *symbol = pos_osk_widget_get_press_symbol (press->self, press);
+  gboolean words;
+
+  g_return_val_if_fail (symbol, G_SOURCE_REMOVE);
 
-  g_return_val_if_fail (self->current, G_SOURCE_REMOVE);
+  words = ++press->n_repeats > KEY_REPEAT_WORD_THRESHOLD;
 
-  g_signal_emit (self, signals[OSK_KEY_DOWN], 0, pos_osk_key_get_symbol (self->current));
-  g_signal_emit (self, signals[OSK_KEY_UP], 0, pos_osk_key_get_symbol (self->current));
-  g_signal_emit (self, signals[OSK_KEY_SYMBOL], 0, pos_osk_key_get_symbol (self->current));
+  g_signal_emit (press->self, signals[OSK_KEY_DOWN], 0, symbol);
+  g_signal_emit (press->self, signals[OSK_KEY_UP], 0, symbol);
+  g_signal_emit (press->self, signals[OSK_DELETE_REPEAT], 0, words);
+
+  /* Accelerate: slow down the repeat but delete whole words */
+  if (press->n_repeats == KEY_REPEAT_WORD_THRESHOLD) {
+    press->repeat_id = g_timeout_add (KEY_REPEAT_WORD_INTERVAL, on_key_repeat, press);
+    g_source_set_name_by_id (press->repeat_id, "[pos-key-repeat-words]");
+    return G_SOURCE_REMOVE;
+  }
 
   return G_SOURCE_CONTINUE;
 }
@@ -782,106 +687,140 @@ on_key_repeat (gpointer data)
 static gboolean
 on_repeat_timeout (gpointer data)
 {
-  PosOskWidget *self = POS_OSK_WIDGET (data);
+  PosOskWidgetPress *press = data;
 
-  self->repeat_id = g_timeout_add (KEY_REPEAT_INTERVAL, on_key_repeat, self);
-  g_source_set_name_by_id (self->repeat_id, "[pos-key-repeat]");
+  press->repeat_id = g_timeout_add (KEY_REPEAT_INTERVAL, on_key_repeat, press);
+  g_source_set_name_by_id (press->repeat_id, "[pos-key-repeat]");
 
   return G_SOURCE_REMOVE;
 }
 
 
 static void
-key_repeat_cancel (PosOskWidget *self)
+key_repeat_cancel (PosOskWidgetPress *press)
+{
+  g_clear_handle_id (&press->repeat_id, g_source_remove);
+}
+
+
+static void
+pos_osk_widget_key_unpress (PosOskWidget *self, PosOskWidgetPress *press)
 {
-  g_clear_handle_id (&self->repeat_id, g_source_remove);
+  pos_osk_widget_queue_draw_key (self, press->layer, press->key);
 }
 
 
+/* Drop all presses without emitting any further signals */
 static void
-pos_osk_widget_key_press_action (PosOskWidget *self, PosOskKey *key)
+pos_osk_widget_clear_presses (PosOskWidget *self)
 {
-  self->current = key;
-  pos_osk_widget_set_key_pressed (self, key, TRUE);
+  PosOskWidgetPress *press;
 
-  g_signal_emit (self, signals[OSK_KEY_DOWN], 0, pos_osk_key_get_symbol (key));
+  while ((press = g_queue_pop_head (&self->presses))) {
+    pos_osk_widget_key_unpress (self, press);
+    pos_osk_widget_press_free (press);
+  }
 }
 
 
 static gboolean
-pos_osk_widget_button_press_event (GtkWidget *widget, GdkEventButton *event)
+on_long_press_timeout (gpointer data)
 {
-  PosOskWidget *self = POS_OSK_WIDGET (widget);
-  PosOskKey *key = NULL;
+  PosOskWidgetPress *press = data;
 
-  g_debug ("Button press: %f, %f, button: %d, state: %d",
-           event->x, event->y, event->button, event->state);
+  press->long_press_id = 0;
+  pos_osk_widget_long_press (press->self, press);
 
-  if (event->type != GDK_BUTTON_PRESS)
-    return FALSE;
+  return G_SOURCE_REMOVE;
+}
 
-  key = pos_osk_widget_locate_key (self, event->x, event->y);
-  g_return_val_if_fail (key != NULL, GDK_EVENT_PROPAGATE);
 
-  if (self->current) {
-    g_warning ("Got button press event for %s while another key %s is pressed",
-               POS_OSK_KEY_DBG (key), POS_OSK_KEY_DBG (self->current));
-  }
-  pos_osk_widget_key_press_action (self, key);
+static PosOskWidgetPress *
+pos_osk_widget_key_press_action (PosOskWidget     *self,
+                                 GdkEventSequence *sequence,
+                                 int               n,
+                                 double            x,
+                                 double            y)
+{
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, self->layer);
+  PosOskWidgetPress *press = g_new0 (PosOskWidgetPress, 1);
+  int long_press_time;
+
+  press->self = self;
+  press->sequence = sequence;
+  press->key = n;
+  press->layer = self->layer;
+  press->x = x;
+  press->y = y;
+  g_queue_push_tail (&self->presses, press);
+  pos_osk_widget_queue_draw_key (self, self->layer, n);
 
-  if (pos_osk_key_get_use (key) == POS_OSK_KEY_USE_DELETE) {
-    self->repeat_id = g_timeout_add (KEY_REPEAT_DELAY, on_repeat_timeout, self);
-    g_source_set_name_by_id (self->repeat_id, "[pos-key-repeat-timeout]");
+  if (layout_layer->key_use[n] == POS_OSK_KEY_USE_DELETE) {
+    press->repeat_id = g_timeout_add (KEY_REPEAT_DELAY, on_repeat_timeout, press);
+    g_source_set_name_by_id (press->repeat_id, "[pos-key-repeat-timeout]");
   }
 
-  return GDK_EVENT_STOP;
+  g_object_get (gtk_widget_get_settings (GTK_WIDGET (self)),
+                "gtk-long-press-time", &long_press_time,
+                NULL);
+  press->long_press_id = g_timeout_add (long_press_time * LONG_PRESS_DELAY_FACTOR,
+                                        on_long_press_timeout, press);
+  g_source_set_name_by_id (press->long_press_id, "[pos-key-long-press]");
+
+  g_signal_emit (self, signals[OSK_KEY_DOWN], 0, layout_layer->key_symbol[n]);
+
+  return press;
 }
 
 
 static void
-get_popup_pos (PosOskKey *key, GdkRectangle *out)
+get_popup_pos (PosOskWidget *self, int n, GdkRectangle *out)
 {
-  const GdkRectangle *box = pos_osk_key_get_box (key);
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  const GdkRectangle *box = &layer->boxes[n];
 
-  out->x = box->x + (0.5 * box->width);
+  out->x = layer->offset_x + box->x + (0.5 * box->width);
   out->y = box->y + (0.5 * box->height);
 }
 
 
 static void
-pos_osk_widget_show_menu (PosOskWidget *self, PosOskKey *key)
+pos_osk_widget_show_menu (PosOskWidget *self, int n)
 {
   GVariantBuilder builder;
   GActionGroup *group = gtk_widget_get_action_group (GTK_WIDGET (self), "win");
   GdkRectangle rect;
 
-  get_popup_pos (key, &rect);
+  get_popup_pos (self, n, &rect);
   g_variant_builder_init (&builder, G_VARIANT_TYPE_TUPLE);
   g_variant_builder_add_value (&builder, g_variant_new ("i", rect.x));
   g_variant_builder_add_value (&builder, g_variant_new ("i", rect.y));
   g_action_group_activate_action (group, "menu", g_variant_builder_end (&builder));
-  pos_osk_key_set_pressed (key, FALSE);
 }
 
 
 static void
-pos_osk_widget_key_release_action (PosOskWidget *self, PosOskKey *key)
+pos_osk_widget_key_release_action (PosOskWidget *self, PosOskWidgetPress *press)
 {
-  switch (pos_osk_key_get_use (key)) {
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, press->layer);
+  int n = press->key;
+  PosOskKeyUse use = layout_layer->key_use[n];
+
+  switch (use) {
   case POS_OSK_KEY_USE_TOGGLE:
-    switch_layer (self, key);
+    switch_layer (self, use, layout_layer->key_layer[n]);
     break;
 
   case POS_OSK_KEY_USE_DELETE:
   case POS_OSK_KEY_USE_KEY:
-    pos_osk_widget_set_key_pressed (self, self->current, FALSE);
-    g_signal_emit (self, signals[OSK_KEY_UP], 0, pos_osk_key_get_symbol (key));
-    g_signal_emit (self, signals[OSK_KEY_SYMBOL], 0, pos_osk_key_get_symbol (key));
-    switch_layer (self, key);
+    g_signal_emit (self, signals[OSK_KEY_UP], 0, layout_layer->key_symbol[n]);
+    g_signal_emit (self, signals[OSK_KEY_SYMBOL], 0, layout_layer->key_symbol[n]);
+    switch_layer (self, use, layout_layer->key_layer[n]);
     break;
 
   case POS_OSK_KEY_USE_MENU:
-    pos_osk_widget_show_menu (self, key);
+    if (press->layer == self->layer)
+      pos_osk_widget_show_menu (self, n);
     break;
   default:
     g_assert_not_reached ();
@@ -889,75 +828,395 @@ pos_osk_widget_key_release_action (PosOskWidget *self, PosOskKey *key)
 }
 
 
-static gboolean
-pos_osk_widget_button_release_event (GtkWidget *widget, GdkEventButton *event)
+/*
+ * pos_osk_widget_flush_presses:
+ * @self: The osk widget
+ *
+ * Process released presses. When typing fast the next key is often
+ * pressed before the previous one is released. To not swap characters
+ * a release is held back until all characters pressed earlier got
+ * released too. Other keys (like shift or backspace) don't hold back
+ * releases so e.g. a held backspace doesn't block typing.
+ */
+static void
+pos_osk_widget_flush_presses (PosOskWidget *self)
 {
-  PosOskWidget *self = POS_OSK_WIDGET (widget);
-  PosOskKey *key = NULL;
+  GList *l = self->presses.head;
 
-  g_debug ("Button release: %f, %f, button: %d, state: %d",
-           event->x, event->y, event->button, event->state);
+  while (l) {
+    PosOskWidgetPress *press = l->data;
+    const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, press->layer);
 
-  key_repeat_cancel (self);
-  pos_osk_widget_set_mode (self, POS_OSK_WIDGET_MODE_KEYBOARD);
+    if (press->released) {
+      g_queue_delete_link (&self->presses, l);
+      pos_osk_widget_key_release_action (self, press);
+      pos_osk_widget_press_free (press);
+      /* Signal handlers might have changed the presses */
+      l = self->presses.head;
+      continue;
+    }
 
-  if (event->button != 1)
-    return GDK_EVENT_PROPAGATE;
+    if (layout_layer->key_use[press->key] == POS_OSK_KEY_USE_KEY)
+      break;
 
-  /* Already cancelled */
-  if (self->current == NULL)
-    return GDK_EVENT_PROPAGATE;
+    l = l->next;
+  }
+}
 
-  key = pos_osk_widget_locate_key (self, event->x, event->y);
-  g_return_val_if_fail (key != NULL, GDK_EVENT_PROPAGATE);
 
-  pos_osk_widget_key_release_action (self, key);
+static void
+pos_osk_widget_key_release (PosOskWidget *self, PosOskWidgetPress *press)
+{
+  key_repeat_cancel (press);
+  g_clear_handle_id (&press->long_press_id, g_source_remove);
+  press->released = TRUE;
+  pos_osk_widget_key_unpress (self, press);
 
-  self->current = NULL;
-  return GDK_EVENT_STOP;
+  pos_osk_widget_flush_presses (self);
 }
 
 
 static void
-pos_osk_widget_cancel_press (PosOskWidget *self)
+pos_osk_widget_cancel_press (PosOskWidget *self, PosOskWidgetPress *press)
 {
-  if (self->current == NULL)
-    return;
+  const char *symbol = pos_osk_widget_get_press_symbol (self, press);
+  /* A swipe already cancelled its key when it started */
+  gboolean swiping = press->trace != NULL;
 
-  key_repeat_cancel (self);
+  g_queue_remove (&self->presses, press);
+  pos_osk_widget_key_unpress (self, press);
+  pos_osk_widget_press_free (press);
 
-  pos_osk_widget_set_key_pressed (self, self->current, FALSE);
-  g_signal_emit (self, signals[OSK_KEY_CANCELLED], 0, pos_osk_key_get_symbol (self->current));
-  self->current = NULL;
+  if (!swiping)
+    g_signal_emit (self, signals[OSK_KEY_CANCELLED], 0, symbol);
+  pos_osk_widget_flush_presses (self);
 }
 
 
 static gboolean
-pos_osk_widget_motion_notify_event (GtkWidget *widget, GdkEventMotion *event)
+pos_osk_widget_can_swipe (PosOskWidget *self, PosOskWidgetPress *press)
 {
-  PosOskWidget *self = POS_OSK_WIDGET (widget);
-  PosOskKey *key;
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, press->layer);
 
-  if ((event->state & GDK_BUTTON1_MASK) == 0)
-    return GDK_EVENT_PROPAGATE;
+  if (!(self->features & PHOSH_OSK_FEATURE_SWIPE))
+    return FALSE;
 
-  key = pos_osk_widget_locate_key (self, event->x, event->y);
-  if (self->current && key != self->current) {
-    gboolean accept = !!(self->features & PHOSH_OSK_FEATURE_KEY_DRAG);
-
-    g_debug ("Crossed key boundary, %s", accept ? "accepting" : "canceling");
-    if (accept) {
-      /* Handle current key */
-      pos_osk_widget_key_release_action (self, self->current);
-      /* Make the new key current */
-      pos_osk_widget_key_press_action (self, key);
-      return GDK_EVENT_STOP;
-    } else {
-      pos_osk_widget_cancel_press (self);
-    }
-  }
+  if (self->swipe_decoder == NULL || pos_swipe_decoder_get_n_words (self->swipe_decoder) == 0)
+    return FALSE;
 
-  return GDK_EVENT_PROPAGATE;
+  /* Swipes start on characters with no other key held */
+  if (layout_layer->key_use[press->key] != POS_OSK_KEY_USE_KEY)
+    return FALSE;
+
+  return g_queue_get_length (&self->presses) == 1;
+}
+
+
+static void
+pos_osk_widget_add_trace_point (PosOskWidgetPress *press, double x, double y)
+{
+  PosSwipePoint point = { x, y };
+
+  g_array_append_val (press->trace, point);
+}
+
+
+static void
+pos_osk_widget_begin_swipe (PosOskWidget *self, PosOskWidgetPress *press, double x, double y)
+{
+  g_debug ("Starting swipe at %s", pos_osk_widget_get_key_dbg (self, press->layer, press->key));
+
+  key_repeat_cancel (press);
+  g_clear_handle_id (&press->long_press_id, g_source_remove);
+  pos_osk_widget_key_unpress (self, press);
+
+  press->trace = g_array_new (FALSE, FALSE, sizeof (PosSwipePoint));
+  pos_osk_widget_add_trace_point (press, press->x, press->y);
+  pos_osk_widget_add_trace_point (press, x, y);
+
+  g_signal_emit (self, signals[OSK_KEY_CANCELLED], 0,
+                 pos_osk_widget_get_press_symbol (self, press));
+}
+
+
+static void
+pos_osk_widget_end_swipe (PosOskWidget *self, PosOskWidgetPress *press)
+{
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, press->layer);
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_keyboard_layer (self, press->layer);
+  g_autoptr (GArray) keys = g_array_sized_new (FALSE, FALSE, sizeof (PosSwipeKey),
+                                               layout_layer->n_keys);
+  g_auto (GStrv) words = NULL;
+
+  g_queue_remove (&self->presses, press);
+
+  /* The keys' centers from the current geometry */
+  for (int k = 0; layer->boxes && k < layout_layer->n_keys; k++) {
+    const GdkRectangle *box = &layer->boxes[k];
+    PosSwipeKey key;
+
+    if (layout_layer->key_use[k] != POS_OSK_KEY_USE_KEY)
+      continue;
+
+    key.symbol = layout_layer->key_symbol[k];
+    key.x = layer->offset_x + box->x + 0.5 * box->width;
+    key.y = box->y + 0.5 * box->height;
+    g_array_append_val (keys, key);
+  }
+
+  if (keys->len) {
+    words = pos_swipe_decoder_decode (self->swipe_decoder,
+                                      (PosSwipeKey *)keys->data,
+                                      keys->len,
+                                      layer->key_width,
+                                      (PosSwipePoint *)press->trace->data,
+                                      press->trace->len,
+                                      MAX_SWIPE_RESULTS);
+  }
+  pos_osk_widget_press_free (press);
+
+  if (words)
+    g_signal_emit (self, signals[OSK_SWIPE], 0, words);
+
+  pos_osk_widget_flush_presses (self);
+}
+
+
+static void
+pos_osk_widget_move_press (PosOskWidget *self, PosOskWidgetPress *press, double x, double y)
+{
+  GdkEventSequence *sequence = press->sequence;
+  int key, threshold;
+
+  if (press->trace) {
+    pos_osk_widget_add_trace_point (press, x, y);
+    return;
+  }
+
+  g_object_get (gtk_widget_get_settings (GTK_WIDGET (self)),
+                "gtk-dnd-drag-threshold", &threshold,
+                NULL);
+  if (hypot (x - press->x, y - press->y) > threshold)
+    g_clear_handle_id (&press->long_press_id, g_source_remove);
+
+  /* Another touch switched layers, stick to what was pressed */
+  if (press->layer != self->layer)
+    return;
+
+  key = pos_osk_widget_locate_key (self, x, y);
+  if (key == NO_KEY || key == press->key)
+    return;
+
+  if (pos_osk_widget_can_swipe (self, press)) {
+    pos_osk_widget_begin_swipe (self, press, x, y);
+  } else if (self->features & PHOSH_OSK_FEATURE_KEY_DRAG) {
+    g_debug ("Crossed key boundary, accepting");
+    /* Handle current key */
+    pos_osk_widget_key_release (self, press);
+    /* Releasing might have switched layers */
+    key = pos_osk_widget_locate_key (self, x, y);
+    /* Make the new key current */
+    if (key != NO_KEY)
+      pos_osk_widget_key_press_action (self, sequence, key, x, y);
+  } else {
+    g_debug ("Crossed key boundary, canceling");
+    pos_osk_widget_cancel_press (self, press);
+  }
+}
+
+
+static PosOskWidgetPress *
+pos_osk_widget_find_moved_press (PosOskWidget *self)
+{
+  for (GList *l = self->presses.head; l; l = l->next) {
+    PosOskWidgetPress *press = l->data;
+
+    if (press->motion_pending)
+      return press;
+  }
+
+  return NULL;
+}
+
+
+static gboolean
+on_tick (GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
+  PosOskWidgetPress *press;
+
+  /* Moving a press can cancel it or add new ones so look up one at a time */
+  while ((press = pos_osk_widget_find_moved_press (self))) {
+    press->motion_pending = FALSE;
+    pos_osk_widget_move_press (self, press, press->motion_x, press->motion_y);
+  }
+
+  if (self->mode == POS_OSK_WIDGET_MODE_CURSOR)
+    pos_osk_widget_flush_cursor_motion (self);
+
+  self->tick_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+pos_osk_widget_ensure_tick (PosOskWidget *self)
+{
+  if (self->tick_id)
+    return;
+
+  self->tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (self), on_tick, NULL, NULL);
+}
+
+
+static gboolean
+pos_osk_widget_begin_sequence (PosOskWidget *self, GdkEventSequence *sequence, double x, double y)
+{
+  PosOskWidgetPress *press;
+  int key;
+
+  pos_latency_mark (POS_LATENCY_STAGE_PRESS);
+
+  key = pos_osk_widget_locate_key (self, x, y);
+  g_return_val_if_fail (key != NO_KEY, GDK_EVENT_PROPAGATE);
+
+  press = pos_osk_widget_find_press (self, sequence);
+  if (press) {
+    g_warning ("Got press for %s while the same sequence presses %s",
+               pos_osk_widget_get_key_dbg (self, self->layer, key),
+               pos_osk_widget_get_key_dbg (self, press->layer, press->key));
+    pos_osk_widget_cancel_press (self, press);
+  }
+
+  pos_osk_widget_key_press_action (self, sequence, key, x, y);
+
+  return GDK_EVENT_STOP;
+}
+
+
+static gboolean
+pos_osk_widget_update_sequence (PosOskWidget *self, GdkEventSequence *sequence, double x, double y)
+{
+  PosOskWidgetPress *press = pos_osk_widget_find_press (self, sequence);
+
+  if (press == NULL)
+    return GDK_EVENT_PROPAGATE;
+
+  /* Swipes want every point, everything else only the latest one per frame */
+  if (press->trace) {
+    pos_osk_widget_move_press (self, press, x, y);
+    return GDK_EVENT_STOP;
+  }
+
+  press->motion_pending = TRUE;
+  press->motion_x = x;
+  press->motion_y = y;
+  pos_osk_widget_ensure_tick (self);
+
+  return GDK_EVENT_STOP;
+}
+
+
+static gboolean
+pos_osk_widget_end_sequence (PosOskWidget *self, GdkEventSequence *sequence, double x, double y)
+{
+  PosOskWidgetPress *press;
+
+  pos_latency_mark (POS_LATENCY_STAGE_RELEASE);
+  pos_osk_widget_set_mode (self, POS_OSK_WIDGET_MODE_KEYBOARD);
+
+  /* Already cancelled */
+  press = pos_osk_widget_find_press (self, sequence);
+  if (press == NULL)
+    return GDK_EVENT_PROPAGATE;
+
+  /* Superseded by the end position */
+  press->motion_pending = FALSE;
+
+  if (press->trace) {
+    pos_osk_widget_add_trace_point (press, x, y);
+    pos_osk_widget_end_swipe (self, press);
+    return GDK_EVENT_STOP;
+  }
+
+  /* The touch might have ended on another key */
+  pos_osk_widget_move_press (self, press, x, y);
+  press = pos_osk_widget_find_press (self, sequence);
+  if (press)
+    pos_osk_widget_key_release (self, press);
+
+  return GDK_EVENT_STOP;
+}
+
+
+static gboolean
+pos_osk_widget_button_press_event (GtkWidget *widget, GdkEventButton *event)
+{
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
+
+  g_debug ("Button press: %f, %f, button: %d, state: %d",
+           event->x, event->y, event->button, event->state);
+
+  if (event->type != GDK_BUTTON_PRESS)
+    return FALSE;
+
+  return pos_osk_widget_begin_sequence (self, NULL, event->x, event->y);
+}
+
+
+static gboolean
+pos_osk_widget_button_release_event (GtkWidget *widget, GdkEventButton *event)
+{
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
+
+  g_debug ("Button release: %f, %f, button: %d, state: %d",
+           event->x, event->y, event->button, event->state);
+
+  if (event->button != 1) {
+    pos_osk_widget_set_mode (self, POS_OSK_WIDGET_MODE_KEYBOARD);
+    return GDK_EVENT_PROPAGATE;
+  }
+
+  return pos_osk_widget_end_sequence (self, NULL, event->x, event->y);
+}
+
+
+static gboolean
+pos_osk_widget_motion_notify_event (GtkWidget *widget, GdkEventMotion *event)
+{
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
+
+  if ((event->state & GDK_BUTTON1_MASK) == 0)
+    return GDK_EVENT_PROPAGATE;
+
+  pos_osk_widget_update_sequence (self, NULL, event->x, event->y);
+  return GDK_EVENT_PROPAGATE;
+}
+
+
+static gboolean
+pos_osk_widget_touch_event (GtkWidget *widget, GdkEventTouch *event)
+{
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
+  PosOskWidgetPress *press;
+
+  switch (event->type) {
+  case GDK_TOUCH_BEGIN:
+    g_debug ("Touch begin: %f, %f, sequence: %p", event->x, event->y, event->sequence);
+    return pos_osk_widget_begin_sequence (self, event->sequence, event->x, event->y);
+  case GDK_TOUCH_UPDATE:
+    return pos_osk_widget_update_sequence (self, event->sequence, event->x, event->y);
+  case GDK_TOUCH_END:
+    g_debug ("Touch end: %f, %f, sequence: %p", event->x, event->y, event->sequence);
+    return pos_osk_widget_end_sequence (self, event->sequence, event->x, event->y);
+  case GDK_TOUCH_CANCEL:
+    press = pos_osk_widget_find_press (self, event->sequence);
+    if (press)
+      pos_osk_widget_cancel_press (self, press);
+    return GDK_EVENT_STOP;
+  default:
+    return GDK_EVENT_PROPAGATE;
+  }
 }
 
 
@@ -968,326 +1227,836 @@ on_symbol_selected (PosOskWidget *self, const char *symbol)
 
   g_signal_emit (self, signals[OSK_KEY_DOWN], 0, symbol);
   g_signal_emit (self, signals[OSK_KEY_SYMBOL], 0, symbol);
-  g_clear_pointer (&self->char_popup, phosh_cp_widget_destroy);
+  if (self->char_popup)
+    gtk_popover_popdown (GTK_POPOVER (self->char_popup));
 }
 
 
 static void
-on_popover_closed (PosOskWidget *self)
+on_popover_closed (PosOskWidget *self, GtkWidget *char_popup)
 {
+  /* Another popup got shown meanwhile */
+  if (self->char_popup && self->char_popup != char_popup)
+    return;
+
   g_debug ("Closed symbol popover");
+  self->char_popup = NULL;
   g_signal_emit (self, signals[OSK_POPOVER_HIDDEN], 0);
 }
 
 
 static void
-on_long_pressed (GtkGestureLongPress *gesture, double x, double y, gpointer user_data)
+pos_osk_widget_char_popup_free (GtkWidget *char_popup)
+{
+  gtk_widget_destroy (char_popup);
+  g_object_unref (char_popup);
+}
+
+
+/* Get the popup for the given symbols, building it if needed */
+static GtkWidget *
+pos_osk_widget_get_char_popup (PosOskWidget *self, const char *const *symbols)
+{
+  GtkWidget *char_popup = g_hash_table_lookup (self->char_popups, symbols);
+
+  if (char_popup)
+    return char_popup;
+
+  char_popup = GTK_WIDGET (pos_char_popup_new (GTK_WIDGET (self), (GStrv)symbols));
+  g_object_ref_sink (char_popup);
+  g_signal_connect_object (char_popup, "selected",
+                           G_CALLBACK (on_symbol_selected),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (char_popup, "closed",
+                           G_CALLBACK (on_popover_closed),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_hash_table_insert (self->char_popups, (gpointer)symbols, char_popup);
+
+  return char_popup;
+}
+
+
+/* Build one missing popup per call so the main loop stays responsive */
+static gboolean
+on_prebuild_char_popups (gpointer data)
 {
-  PosOskWidget *self = POS_OSK_WIDGET (user_data);
-  PosOskKey *key = pos_osk_widget_locate_key (self, x, y);
+  PosOskWidget *self = POS_OSK_WIDGET (data);
+
+  for (; self->prebuild_layer <= POS_OSK_WIDGET_LAST_LAYER; self->prebuild_layer++) {
+    const PosOskLayoutLayer *layout_layer;
+
+    layout_layer = pos_osk_widget_get_layout_layer (self, self->prebuild_layer);
+    while (self->prebuild_key < layout_layer->n_keys) {
+      const char *const *symbols = layout_layer->key_symbols[self->prebuild_key++];
+
+      if (symbols == NULL || symbols[0] == NULL)
+        continue;
+
+      if (g_hash_table_contains (self->char_popups, symbols))
+        continue;
+
+      pos_osk_widget_get_char_popup (self, symbols);
+      return G_SOURCE_CONTINUE;
+    }
+    self->prebuild_key = 0;
+  }
+
+  g_debug ("Built %u char popups", g_hash_table_size (self->char_popups));
+  self->prebuild_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+pos_osk_widget_clear_char_popups (PosOskWidget *self)
+{
+  g_clear_handle_id (&self->prebuild_id, g_source_remove);
+  self->char_popup = NULL;
+  g_hash_table_remove_all (self->char_popups);
+}
+
+
+static void
+pos_osk_widget_long_press (PosOskWidget *self, PosOskWidgetPress *press)
+{
+  int n = press->key;
+  const PosOskLayoutLayer *layout_layer;
   GStrv symbols = NULL;
   GdkRectangle rect = { 0 };
 
-  g_debug ("Long press '%s'", pos_osk_key_get_label (key) ?: pos_osk_key_get_symbol (key));
+  /* Popups are positioned on the current layer */
+  if (press->layer != self->layer)
+    return;
+
+  layout_layer = pos_osk_widget_get_layout_layer (self, self->layer);
 
-  if (g_strcmp0 (pos_osk_key_get_symbol (key), POS_OSK_SYMBOL_SPACE) == 0) {
-    key_repeat_cancel (self);
+  g_debug ("Long press '%s'", pos_osk_widget_get_key_dbg (self, self->layer, n));
+
+  if (layout_layer->key_symbol_id[n] == POS_SYMBOL_SPACE) {
+    key_repeat_cancel (press);
     /* Remember the key we want to untoggle when mode ends */
-    self->space = key;
+    self->space = n;
     pos_osk_widget_set_mode (self, POS_OSK_WIDGET_MODE_CURSOR);
     return;
   }
 
-  symbols = pos_osk_key_get_symbols (key);
-  if (symbols == NULL || symbols[0] == NULL)
+  symbols = (GStrv)layout_layer->key_symbols[n];
+  if (symbols == NULL || symbols[0] == NULL)
+    return;
+
+  pos_osk_widget_cancel_press (self, press);
+  if (self->char_popup)
+    gtk_popover_popdown (GTK_POPOVER (self->char_popup));
+  self->char_popup = pos_osk_widget_get_char_popup (self, layout_layer->key_symbols[n]);
+
+  get_popup_pos (self, n, &rect);
+  gtk_popover_set_pointing_to (GTK_POPOVER (self->char_popup), &rect);
+  gtk_popover_popup (GTK_POPOVER (self->char_popup));
+  g_signal_emit (self, signals[OSK_POPOVER_SHOWN], 0, symbols);
+}
+
+
+static void
+pos_osk_widget_key_style_free (PosOskWidgetKeyStyle *key_style)
+{
+  g_clear_object (&key_style->context);
+  g_clear_pointer (&key_style->font, pango_font_description_free);
+  g_clear_pointer (&key_style->hint_font, pango_font_description_free);
+  g_free (key_style);
+}
+
+
+static void
+pos_osk_widget_clear_key_styles (PosOskWidget *self)
+{
+  for (int i = 0; i < G_N_ELEMENTS (self->key_styles); i++) {
+    /* Style updates can happen before we're fully initialized */
+    if (self->key_styles[i])
+      g_hash_table_remove_all (self->key_styles[i]);
+  }
+}
+
+
+static PosOskWidgetKeyStyle *
+pos_osk_widget_resolve_key_style (PosOskWidget *self, const char *style, gboolean pressed)
+{
+  PosOskWidgetKeyStyle *key_style = g_new0 (PosOskWidgetKeyStyle, 1);
+  GtkStyleContext *context = gtk_style_context_new ();
+  /* TODO: this should come from css */
+  float hint_scale = 0.75;
+  int size;
+
+  gtk_style_context_set_path (context, self->key_path);
+  gtk_style_context_set_parent (context, gtk_widget_get_style_context (GTK_WIDGET (self)));
+  gtk_style_context_set_screen (context, gtk_widget_get_screen (GTK_WIDGET (self)));
+  if (style)
+    gtk_style_context_add_class (context, style);
+  if (pressed)
+    gtk_style_context_add_class (context, "pressed");
+
+  gtk_style_context_set_state (context, GTK_STATE_FLAG_NORMAL);
+  gtk_style_context_get (context, GTK_STATE_FLAG_NORMAL, "font", &key_style->font, NULL);
+  gtk_style_context_get_color (context, GTK_STATE_FLAG_NORMAL, &key_style->color);
+  gtk_style_context_get_margin (context, GTK_STATE_FLAG_NORMAL, &key_style->margin);
+  gtk_style_context_get_border (context, GTK_STATE_FLAG_NORMAL, &key_style->border);
+
+  /* Hints are rendered insensitive */
+  gtk_style_context_get (context, GTK_STATE_FLAG_INSENSITIVE, "font", &key_style->hint_font, NULL);
+  size = pango_font_description_get_size (key_style->hint_font);
+  pango_font_description_set_size (key_style->hint_font, hint_scale * size);
+  gtk_style_context_get_color (context, GTK_STATE_FLAG_INSENSITIVE, &key_style->hint_color);
+  gtk_style_context_get_margin (context, GTK_STATE_FLAG_INSENSITIVE, &key_style->hint_margin);
+  gtk_style_context_get_border (context, GTK_STATE_FLAG_INSENSITIVE, &key_style->hint_border);
+
+  key_style->context = context;
+
+  return key_style;
+}
+
+/*
+ * pos_osk_widget_get_key_style:
+ * @self: The osk widget
+ * @style:(nullable): The interned style class
+ * @pressed: Whether the key is pressed
+ *
+ * Looks up the resolved style for a key, resolving it on first use.
+ */
+static const PosOskWidgetKeyStyle *
+pos_osk_widget_get_key_style (PosOskWidget *self, const char *style, gboolean pressed)
+{
+  GHashTable *key_styles = self->key_styles[!!pressed];
+  PosOskWidgetKeyStyle *key_style;
+
+  key_style = g_hash_table_lookup (key_styles, style);
+  if (key_style)
+    return key_style;
+
+  key_style = pos_osk_widget_resolve_key_style (self, style, pressed);
+  g_hash_table_insert (key_styles, (gpointer)style, key_style);
+
+  return key_style;
+}
+
+
+static void
+render_outline (cairo_t *cr, const PosOskWidgetKeyStyle *key_style, const GdkRectangle *box)
+{
+  const GtkBorder *margin = &key_style->margin;
+  const GtkBorder *border = &key_style->border;
+  double x, y, width, height;
+
+  x = margin->left + border->left;
+  y = margin->top + border->top;
+  width = box->width - x - margin->right - border->right;
+  height = box->height - y - margin->bottom - border->bottom;
+
+  gtk_render_background (key_style->context, cr, x, y, width, height);
+  gtk_render_frame (key_style->context, cr, x, y, width, height);
+}
+
+
+static void
+render_label (cairo_t                    *cr,
+              const PosOskWidgetKeyStyle *key_style,
+              const char                 *label,
+              const GdkRectangle         *box)
+{
+  PangoLayout *layout;
+  PangoRectangle extents = { 0, };
+  const GdkRGBA *color = &key_style->color;
+
+  cairo_save (cr);
+
+  layout = pos_text_cache_get_layout (label, key_style->font, PANGO_SCALE * box->width);
+  pango_layout_get_extents (layout, NULL, &extents);
+
+  cairo_move_to (cr,
+                 0.0,
+                 0.5 * (box->height - (double)extents.height / PANGO_SCALE));
+
+  cairo_set_source_rgba (cr,
+                         color->red,
+                         color->green,
+                         color->blue,
+                         color->alpha);
+  pango_cairo_show_layout (cr, layout);
+
+  cairo_restore (cr);
+}
+
+
+static void
+render_hint (cairo_t                    *cr,
+             const PosOskWidgetKeyStyle *key_style,
+             const char                 *hint,
+             const GdkRectangle         *box)
+{
+  PangoLayout *layout;
+  PangoRectangle extents = { 0, };
+  const GdkRGBA *color = &key_style->hint_color;
+  const GtkBorder *margin = &key_style->hint_margin;
+  const GtkBorder *border = &key_style->hint_border;
+  int x, y;
+  /* TODO: this should come from css */
+  int hint_margin = 1;
+
+  cairo_save (cr);
+
+  layout = pos_text_cache_get_layout (hint, key_style->hint_font, -1);
+  pango_layout_get_extents (layout, NULL, &extents);
+
+  x = box->width - border->left - margin->left - margin->right - border->right
+    - (extents.width / PANGO_SCALE) - hint_margin;
+  y = margin->top + border->top + hint_margin;
+
+  cairo_move_to (cr, x, y);
+  cairo_set_source_rgba (cr,
+                         color->red,
+                         color->green,
+                         color->blue,
+                         color->alpha);
+  pango_cairo_show_layout (cr, layout);
+
+  cairo_restore (cr);
+}
+
+
+static guint
+pos_osk_widget_icon_key_hash (gconstpointer data)
+{
+  const PosOskWidgetIconKey *key = data;
+
+  return g_direct_hash (key->icon) ^ (key->size << 8) ^ key->scale ^ gdk_rgba_hash (&key->color);
+}
+
+
+static gboolean
+pos_osk_widget_icon_key_equal (gconstpointer a, gconstpointer b)
+{
+  const PosOskWidgetIconKey *key_a = a;
+  const PosOskWidgetIconKey *key_b = b;
+
+  return key_a->icon == key_b->icon &&
+    key_a->size == key_b->size &&
+    key_a->scale == key_b->scale &&
+    gdk_rgba_equal (&key_a->color, &key_b->color);
+}
+
+
+static void
+pos_osk_widget_clear_icons (PosOskWidget *self)
+{
+  /* Style updates can happen before we're fully initialized */
+  if (self->icons)
+    g_hash_table_remove_all (self->icons);
+}
+
+/*
+ * pos_osk_widget_get_icon:
+ * @self: The osk widget
+ * @key_style: The style of the key the icon is on
+ * @icon: The interned icon name
+ * @size: The icon size
+ * @scale: The scale factor
+ *
+ * Get a surface with the given icon. Icons are looked up and loaded
+ * when first used.
+ *
+ * Returns:(transfer none)(nullable): The icon's surface
+ */
+static cairo_surface_t *
+pos_osk_widget_get_icon (PosOskWidget               *self,
+                         const PosOskWidgetKeyStyle *key_style,
+                         const char                 *icon,
+                         int                         size,
+                         int                         scale)
+{
+  PosOskWidgetIconKey lookup = {
+    .icon = icon,
+    .size = size,
+    .scale = scale,
+    .color = key_style->color,
+  };
+  g_autoptr (GtkIconInfo) icon_info = NULL;
+  g_autoptr (GdkPixbuf) pixbuf = NULL;
+  g_autoptr (GError) err = NULL;
+  cairo_surface_t *surface;
+
+  surface = g_hash_table_lookup (self->icons, &lookup);
+  if (surface)
+    return surface;
+
+  icon_info = gtk_icon_theme_lookup_icon_for_scale (self->icon_theme, icon, size, scale, 0);
+  if (icon_info == NULL) {
+    g_warning ("Icon '%s' not found", icon);
+    return NULL;
+  }
+
+  pixbuf = gtk_icon_info_load_symbolic_for_context (icon_info, key_style->context, NULL, &err);
+  if (pixbuf == NULL) {
+    g_warning ("Failed to load icon '%s': %s", icon, err->message);
+    return NULL;
+  }
+
+  surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale, NULL);
+  g_hash_table_insert (self->icons, g_memdup2 (&lookup, sizeof (lookup)), surface);
+
+  return surface;
+}
+
+
+static void
+render_icon (cairo_t            *cr,
+             GtkStyleContext    *context,
+             cairo_surface_t    *surface,
+             int                 icon_size,
+             const GdkRectangle *box)
+{
+  gtk_render_icon_surface (context, cr, surface,
+                           (box->width - icon_size) / 2,
+                           (box->height - icon_size) / 2);
+}
+
+
+static void
+draw_key (PosOskWidget *self, int n, gboolean pressed, cairo_t *cr)
+{
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, self->layer);
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  const PosOskWidgetKeyStyle *key_style;
+  const GdkRectangle *box;
+  const char *icon = layout_layer->key_icon[n];
+  const char *label = layout_layer->key_label[n];
+  const char *symbol = layout_layer->key_symbol[n];
+  int scale;
+
+  scale = gtk_widget_get_scale_factor (GTK_WIDGET (self));
+  key_style = pos_osk_widget_get_key_style (self, layout_layer->key_style[n], pressed);
+
+  /* The space key shows the layout's name */
+  if (layout_layer->key_symbol_id[n] == POS_SYMBOL_SPACE)
+    label = self->display_name;
+
+  cairo_save (cr);
+
+  box = &layer->boxes[n];
+  cairo_translate (cr, box->x, box->y);
+  cairo_rectangle (cr, 0.0, 0.0, box->width, box->height);
+  cairo_clip (cr);
+
+  render_outline (cr, key_style, box);
+
+  if (self->mode == POS_OSK_WIDGET_MODE_KEYBOARD) {
+    if (icon) {
+      int icon_size = MIN (KEY_ICON_SIZE, box->height / 2);
+      cairo_surface_t *surface;
+
+      surface = pos_osk_widget_get_icon (self, key_style, icon, icon_size, scale);
+      if (surface)
+        render_icon (cr, key_style->context, surface, icon_size, box);
+    } else {
+      const char *const *symbols = layout_layer->key_symbols[n];
+
+      render_label (cr, key_style, label ?: symbol, box);
+      if (symbols)
+        render_hint (cr, key_style, symbols[0], box);
+    }
+  }
+
+  cairo_restore (cr);
+}
+
+
+/* Draw a pressed key over the cached layer */
+static void
+draw_pressed_key (PosOskWidget *self, int n, cairo_t *cr)
+{
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  GtkStyleContext *context = gtk_widget_get_style_context (GTK_WIDGET (self));
+  const GdkRectangle *box = &layer->boxes[n];
+
+  /* Clear the unpressed key first as the pressed one might not cover it fully */
+  cairo_save (cr);
+  cairo_rectangle (cr, box->x, box->y, box->width, box->height);
+  cairo_clip (cr);
+  gtk_render_background (context, cr, -layer->offset_x, 0, self->width, self->height);
+  cairo_restore (cr);
+
+  draw_key (self, n, TRUE, cr);
+}
+
+
+/*
+ * pos_osk_widget_get_keys_in_rect:
+ * @self: The osk widget
+ * @rect: The rectangle in widget coordinates
+ * @keys: Return location for the indices of the intersecting keys
+ *
+ * Find the keys of the current layer intersecting @rect. Rows have a
+ * fixed height and keys within a row are sorted by their position so
+ * this only looks at the keys close to @rect rather than all of them.
+ *
+ * Returns: The number of keys found
+ */
+static guint
+pos_osk_widget_get_keys_in_rect (PosOskWidget *self, const GdkRectangle *rect, GArray *keys)
+{
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, self->layer);
+  int first_row, last_row, x0, x1;
+
+  g_array_set_size (keys, 0);
+  if (layer->key_height <= 0)
+    return 0;
+
+  first_row = floor ((rect->y - layer->offset_y) / layer->key_height);
+  last_row = floor ((rect->y + rect->height - 1 - layer->offset_y) / layer->key_height);
+  first_row = MAX (first_row, 0);
+  last_row = MIN (last_row, (int)layout_layer->n_rows - 1);
+
+  /* Key boxes are relative to the layer */
+  x0 = rect->x - layer->offset_x;
+  x1 = x0 + rect->width;
+
+  for (int r = first_row; r <= last_row; r++) {
+    const PosOskLayoutRow *row = &layout_layer->rows[r];
+    guint lo = row->first, hi = row->first + row->n_keys;
+
+    /* First key in the row that ends right of x0 */
+    while (lo < hi) {
+      guint mid = lo + (hi - lo) / 2;
+      const GdkRectangle *box = &layer->boxes[mid];
+
+      if (box->x + box->width <= x0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    for (int k = lo; k < row->first + row->n_keys && layer->boxes[k].x < x1; k++)
+      g_array_append_val (keys, k);
+  }
+
+  return keys->len;
+}
+
+/*
+ * pos_osk_widget_render_layer:
+ * @self: The osk widget
+ * @damage: The damaged area in widget coordinates
+ *
+ * Make sure the cached layer surface has all keys in @damage rendered.
+ */
+static void
+pos_osk_widget_render_layer (PosOskWidget *self, const GdkRectangle *damage)
+{
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  g_autoptr (GArray) keys = NULL;
+  cairo_region_t *missing;
+  GdkRectangle extents;
+  cairo_t *cr;
+
+  if (layer->surface == NULL || layer->surface_mode != self->mode) {
+    GdkWindow *window = gtk_widget_get_window (GTK_WIDGET (self));
+
+    g_clear_pointer (&layer->surface, cairo_surface_destroy);
+    g_clear_pointer (&layer->valid, cairo_region_destroy);
+
+    /* Takes the window's scale into account */
+    layer->surface = gdk_window_create_similar_surface (window, CAIRO_CONTENT_COLOR_ALPHA,
+                                                        self->width, self->height);
+    layer->surface_mode = self->mode;
+    layer->valid = cairo_region_create ();
+  }
+
+  missing = cairo_region_create_rectangle (damage);
+  cairo_region_subtract (missing, layer->valid);
+  if (cairo_region_is_empty (missing)) {
+    cairo_region_destroy (missing);
     return;
+  }
+  cairo_region_get_extents (missing, &extents);
+  cairo_region_destroy (missing);
 
-  pos_osk_widget_cancel_press (self);
-  g_clear_pointer (&self->char_popup, phosh_cp_widget_destroy);
-  self->char_popup = GTK_WIDGET (pos_char_popup_new (GTK_WIDGET (self), symbols));
+  keys = g_array_new (FALSE, FALSE, sizeof (int));
+  pos_osk_widget_get_keys_in_rect (self, &extents, keys);
+  g_debug ("Rendering %u keys of layer %d", keys->len, self->layer);
 
-  get_popup_pos (key, &rect);
-  gtk_popover_set_pointing_to (GTK_POPOVER (self->char_popup), &rect);
+  cr = cairo_create (layer->surface);
+  cairo_translate (cr, layer->offset_x, 0);
+  for (int i = 0; i < keys->len; i++) {
+    int k = g_array_index (keys, int, i);
+    const GdkRectangle *box = &layer->boxes[k];
+    GdkRectangle rendered = *box;
+
+    /* Keys are rendered as a whole so they might have been partially rendered before */
+    cairo_save (cr);
+    cairo_rectangle (cr, box->x, box->y, box->width, box->height);
+    cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+    cairo_fill (cr);
+    cairo_restore (cr);
+
+    draw_key (self, k, pos_osk_widget_is_key_toggled (self, k), cr);
+
+    rendered.x += layer->offset_x;
+    cairo_region_union_rectangle (layer->valid, &rendered);
+  }
+  cairo_destroy (cr);
 
-  g_signal_connect_object (self->char_popup, "selected",
-                           G_CALLBACK (on_symbol_selected),
-                           self,
-                           G_CONNECT_SWAPPED);
-  g_signal_connect_object (self->char_popup, "closed",
-                           G_CALLBACK (on_popover_closed),
-                           self,
-                           G_CONNECT_SWAPPED);
-  gtk_popover_popup (GTK_POPOVER (self->char_popup));
-  g_signal_emit (self, signals[OSK_POPOVER_SHOWN], 0, symbols);
+  /* Everything in there is rendered now, including the gaps between keys */
+  cairo_region_union_rectangle (layer->valid, &extents);
 }
 
 
+/*
+ * pos_osk_widget_update_grids:
+ * @self: The osk widget
+ * @layer: The layer to update the grids for
+ * @layout_layer: The layer's keys
+ *
+ * Precompute which pixel row maps to which row of keys and which pixel
+ * column in a row maps to which key so locating a key is just a lookup.
+ * Each pixel belongs to the key whose box starts left of it so there are
+ * no gaps due to rounding of the key boxes.
+ */
 static void
-render_outline (cairo_t *cr, GtkStyleContext *context, const GdkRectangle *box)
+pos_osk_widget_update_grids (PosOskWidget              *self,
+                             PosOskWidgetKeyboardLayer *layer,
+                             const PosOskLayoutLayer   *layout_layer)
 {
-  GtkBorder margin, border;
-  double x, y, width, height;
+  for (int y = 0; y < self->height; y++) {
+    int row = (y - layer->offset_y) / (int)layer->key_height;
 
-  gtk_style_context_get_margin (context, GTK_STATE_FLAG_NORMAL, &margin);
-  gtk_style_context_get_border (context, GTK_STATE_FLAG_NORMAL, &border);
+    if (y < layer->offset_y)
+      layer->row_grid[y] = NO_KEY;
+    else
+      layer->row_grid[y] = MIN (row, (int)layout_layer->n_rows - 1);
+  }
 
-  x = margin.left + border.left;
-  y = margin.top + border.top;
-  width = box->width - x - margin.right - border.right;
-  height = box->height - y - margin.bottom - border.bottom;
+  for (int r = 0; r < layout_layer->n_rows; r++) {
+    const PosOskLayoutRow *row = &layout_layer->rows[r];
+    gint16 *keys = &layer->key_grid[r * self->width];
+    int last = row->first + row->n_keys - 1;
+    int x = 0;
 
-  gtk_render_background (context, cr, x, y, width, height);
-  gtk_render_frame (context, cr, x, y, width, height);
-}
+    for (int k = row->first; k <= last; k++) {
+      int end = (k == last) ? self->width : layer->offset_x + layer->boxes[k + 1].x;
 
+      for (; x < MIN (end, self->width); x++)
+        keys[x] = k;
+    }
 
-#if !PANGO_VERSION_CHECK (1, 50, 0)
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (PangoLayout, g_object_unref)
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (PangoFontDescription, pango_font_description_free)
-#endif
+    /* Empty row */
+    for (; x < self->width; x++)
+      keys[x] = NO_KEY;
+  }
+}
 
 
 static void
-render_label (cairo_t *cr, GtkStyleContext *context, const char *label, const GdkRectangle *box)
+pos_osk_widget_update_geometry (PosOskWidget *self)
 {
-  g_autoptr (PangoLayout) layout = pango_cairo_create_layout (cr);
-  g_autoptr (PangoFontDescription) font = NULL;
-  PangoRectangle extents = { 0, };
-  GdkRGBA color = {0};
-  GtkStateFlags state;
+  pos_osk_widget_clear_render_cache (self);
 
-  cairo_save (cr);
+  for (int l = 0; self->layout && l <= POS_OSK_WIDGET_LAST_LAYER; l++) {
+    PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_keyboard_layer (self, l);
+    const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, l);
+
+    if (layout_layer->n_keys == 0)
+      continue;
 
-  state = gtk_style_context_get_state (context);
-  gtk_style_context_get (context, state, "font", &font, NULL);
-  pango_layout_set_font_description (layout, font);
+    layer->key_width = self->width / layout_layer->width;
+    layer->key_height = KEY_HEIGHT;
+    layer->offset_x = 0.5 * (self->width - (layout_layer->width * layer->key_width));
+    layer->offset_y = self->height - (layout_layer->n_rows * layer->key_height);
+
+    if (layer->boxes == NULL)
+      layer->boxes = g_new0 (GdkRectangle, layout_layer->n_keys);
+
+    /* The grids depend on the widget's size */
+    g_clear_pointer (&layer->row_grid, g_free);
+    g_clear_pointer (&layer->key_grid, g_free);
+    if (self->width > 0 && self->height > 0) {
+      layer->row_grid = g_new (gint8, self->height);
+      layer->key_grid = g_new (gint16, layout_layer->n_rows * self->width);
+    }
 
-  pango_layout_set_text (layout, label, -1);
-  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
+    /* Precalc all key positions */
+    for (int r = 0; r < layout_layer->n_rows; r++) {
+      const PosOskLayoutRow *row = &layout_layer->rows[r];
+      double c = row->offset_x;
 
-  pango_layout_set_width (layout, PANGO_SCALE * box->width);
-  pango_layout_get_extents (layout, NULL, &extents);
+      for (int k = row->first; k < row->first + row->n_keys; k++) {
+        double width = layout_layer->key_width[k];
+        GdkRectangle *box = &layer->boxes[k];
 
-  cairo_move_to (cr,
-                 0.0,
-                 0.5 * (box->height - (double)extents.height / PANGO_SCALE));
-  gtk_style_context_get_color (context, state, &color);
+        box->x = c * layer->key_width;
+        box->y = layer->offset_y + r * layer->key_height;
+        box->width = width * layer->key_width;
+        box->height = layer->key_height;
 
-  cairo_set_source_rgba (cr,
-                         color.red,
-                         color.green,
-                         color.blue,
-                         color.alpha);
-  pango_cairo_show_layout (cr, layout);
+        c += width;
+      }
+    }
 
-  cairo_restore (cr);
+    if (layer->key_grid)
+      pos_osk_widget_update_grids (self, layer, layout_layer);
+  }
 }
 
 
 static void
-render_hint (cairo_t *cr, GtkStyleContext *context, const char *hint, const GdkRectangle *box)
+pos_osk_widget_size_allocate (GtkWidget *widget, GdkRectangle *allocation)
 {
-  g_autoptr (PangoLayout) layout = pango_cairo_create_layout (cr);
-  g_autoptr (PangoFontDescription) font = NULL;
-  PangoRectangle extents = { 0, };
-  GdkRGBA color = {0};
-  GtkStateFlags state = GTK_STATE_FLAG_INSENSITIVE;
-  int x, y, size;
-  GtkBorder margin, border;
-  /* TODO: this should come from css */
-  int hint_margin = 1;
-  float hint_scale = 0.75;
-
-  gtk_style_context_set_state (context, state);
-  cairo_save (cr);
-
-  gtk_style_context_get (context, state, "font", &font, NULL);
-  size = pango_font_description_get_size (font);
-  pango_font_description_set_size (font, hint_scale * size);
-  pango_layout_set_font_description (layout, font);
-
-  pango_layout_set_text (layout, hint, -1);
-  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
-
-  gtk_style_context_get_margin (context, state, &margin);
-  gtk_style_context_get_border (context, state, &border);
-
-  pango_layout_get_extents (layout, NULL, &extents);
-
-  x = box->width - border.left - margin.left - margin.right - border.right
-    - (extents.width / PANGO_SCALE) - hint_margin;
-  y = margin.top + border.top + hint_margin;
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
 
-  gtk_style_context_get_color (context, state, &color);
+  self->width = allocation->width;
+  self->height = allocation->height;
 
-  cairo_move_to (cr, x, y);
-  cairo_set_source_rgba (cr,
-                         color.red,
-                         color.green,
-                         color.blue,
-                         color.alpha);
-  pango_cairo_show_layout (cr, layout);
+  pos_osk_widget_update_geometry (self);
 
-  cairo_restore (cr);
-  gtk_style_context_set_state (context, GTK_STATE_FLAG_NORMAL);
+  GTK_WIDGET_CLASS (pos_osk_widget_parent_class)->size_allocate (widget, allocation);
 }
 
 
 static void
-render_icon (cairo_t            *cr,
-             GtkStyleContext    *context,
-             GtkIconTheme       *icon_theme,
-             const char         *icon,
-             const GdkRectangle *box,
-             int                 scale)
+draw_pressed_key_in_clip (PosOskWidget *self, int n, const GdkRectangle *clip, cairo_t *cr)
 {
-  int icon_size;
-  cairo_surface_t *surface;
-
-  g_autoptr (GtkIconInfo) icon_info = NULL;
-  g_autoptr (GdkPixbuf) pixbuf = NULL;
-
-  icon_size = MIN (KEY_ICON_SIZE, box->height / 2);
-  icon_info = gtk_icon_theme_lookup_icon_for_scale (icon_theme, icon, icon_size, scale, 0);
-
-  pixbuf = gtk_icon_info_load_symbolic_for_context (icon_info, context, NULL, NULL);
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  GdkRectangle box = layer->boxes[n];
 
-  surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale, NULL);
-  gtk_render_icon_surface (context, cr, surface,
-                           (box->width - icon_size) / 2,
-                           (box->height - icon_size) / 2);
-  cairo_surface_destroy (surface);
+  box.x += layer->offset_x;
+  if (gdk_rectangle_intersect (&box, clip, NULL))
+    draw_pressed_key (self, n, cr);
 }
 
 
-static void
-draw_key (PosOskWidget *self, PosOskKey *key, cairo_t *cr)
+static gboolean
+pos_osk_widget_draw (GtkWidget *widget, cairo_t *cr)
 {
-  GdkRGBA fg_color;
-  GtkStateFlags state;
-  const GdkRectangle *box;
-  g_autofree char *style = NULL;
-  g_autofree char *icon = NULL;
-  g_autofree char *label = NULL;
-  g_autofree char *symbol = NULL;
-  gboolean pressed;
-  double width;
-  int scale;
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
+  GtkStyleContext *context;
+  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  GdkRectangle clip;
+  gboolean space_pressed = FALSE;
 
-  scale = gtk_widget_get_scale_factor (GTK_WIDGET (self));
-  state = gtk_style_context_get_state (self->key_context);
-  gtk_style_context_get_color (self->key_context, state, &fg_color);
+  /* Only look at what's damaged */
+  if (!gdk_cairo_get_clip_rectangle (cr, &clip))
+    return FALSE;
 
-  g_object_get (key, "style", &style, "pressed", &pressed, "width", &width,
-                "symbol", &symbol, "label", &label, "icon", &icon, NULL);
+  context = gtk_widget_get_style_context (widget);
+  gtk_render_background (context, cr, 0, 0, self->width, self->height);
 
-  if (style)
-    gtk_style_context_add_class (self->key_context, style);
+  if (self->layout == NULL || layer->boxes == NULL)
+    return FALSE;
 
-  if (pressed)
-    gtk_style_context_add_class (self->key_context, "pressed");
+  pos_osk_widget_render_layer (self, &clip);
 
-  cairo_save (cr);
+  cairo_set_source_surface (cr, layer->surface, 0, 0);
+  gdk_cairo_rectangle (cr, &clip);
+  cairo_fill (cr);
 
-  box = pos_osk_key_get_box (key);
-  cairo_translate (cr, box->x, box->y);
-  cairo_rectangle (cr, 0.0, 0.0, box->width, box->height);
-  cairo_clip (cr);
+  cairo_save (cr);
+  cairo_translate (cr, layer->offset_x, 0);
 
-  render_outline (cr, self->key_context, box);
+  for (GList *l = self->presses.head; l; l = l->next) {
+    PosOskWidgetPress *press = l->data;
 
-  if (self->mode == POS_OSK_WIDGET_MODE_KEYBOARD) {
-    if (icon) {
-      GdkScreen *screen = gtk_widget_get_screen (GTK_WIDGET (self));
-      GtkIconTheme *icon_theme = gtk_icon_theme_get_for_screen (screen);
+    if (press->released || press->trace || press->layer != self->layer)
+      continue;
 
-      render_icon (cr, self->key_context, icon_theme, icon, box, scale);
-    } else {
-      GStrv symbols = pos_osk_key_get_symbols (key);
+    if (press->key == self->space)
+      space_pressed = TRUE;
 
-      render_label (cr, self->key_context, label ?: symbol, box);
-      if (symbols)
-        render_hint (cr, self->key_context, symbols[0], box);
-    }
+    draw_pressed_key_in_clip (self, press->key, &clip, cr);
   }
 
-  cairo_restore (cr);
-
-  if (style)
-    gtk_style_context_remove_class (self->key_context, style);
+  if (self->space != NO_KEY && !space_pressed)
+    draw_pressed_key_in_clip (self, self->space, &clip, cr);
 
-  if (pressed)
-    gtk_style_context_remove_class (self->key_context, "pressed");
+  cairo_restore (cr);
+  return FALSE;
 }
 
 
 static void
-pos_osk_widget_size_allocate (GtkWidget *widget, GdkRectangle *allocation)
+pos_osk_widget_style_updated (GtkWidget *widget)
 {
   PosOskWidget *self = POS_OSK_WIDGET (widget);
 
-  self->width = allocation->width;
-  self->height = allocation->height;
+  GTK_WIDGET_CLASS (pos_osk_widget_parent_class)->style_updated (widget);
 
-  for (int l = 0; l <= POS_OSK_WIDGET_LAST_LAYER; l++) {
-    PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_keyboard_layer (self, l);
-    guint off_y;
+  /* Theme or accent color changed, see PosStyleManager */
+  pos_osk_widget_clear_key_styles (self);
+  pos_osk_widget_clear_icons (self);
+  pos_osk_widget_clear_render_cache (self);
+  gtk_widget_queue_draw (widget);
+}
 
-    layer->key_width = self->width / layer->width;
-    layer->key_height = KEY_HEIGHT;
-    layer->offset_x = 0.5 * (self->width - (layer->width * layer->key_width));
-    off_y = self->height - (layer->n_rows * layer->key_height);
 
-    /* Precalc all key positions */
-    for (int r = 0; r < self->layout.n_rows; r++) {
-      PosOskWidgetRow *row = pos_osk_widget_get_layer_row (self, l, r);
-      double c = row->offset_x;
+static void
+on_icon_theme_changed (PosOskWidget *self)
+{
+  g_debug ("Icon theme changed");
+  pos_osk_widget_clear_icons (self);
+  pos_osk_widget_clear_render_cache (self);
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
 
-      for (int k = 0; k < pos_osk_widget_row_get_num_keys (row); k++) {
-        PosOskKey *key = pos_osk_widget_row_get_key (row, k);
-        GdkRectangle box;
 
-        box.x = c * layer->key_width;
-        box.y = off_y + r * layer->key_height;
-        box.width = pos_osk_key_get_width (key) * layer->key_width;
-        box.height = layer->key_height;
-        pos_osk_key_set_box (key, &box);
+static void
+pos_osk_widget_set_icon_theme (PosOskWidget *self, GtkIconTheme *icon_theme)
+{
+  if (self->icon_theme == icon_theme)
+    return;
 
-        c += pos_osk_key_get_width (key);
-      }
-    }
+  if (self->icon_theme) {
+    g_signal_handlers_disconnect_by_func (self->icon_theme, on_icon_theme_changed, self);
+    on_icon_theme_changed (self);
   }
 
-  GTK_WIDGET_CLASS (pos_osk_widget_parent_class)->size_allocate (widget, allocation);
+  g_set_object (&self->icon_theme, icon_theme);
+  g_signal_connect_object (self->icon_theme,
+                           "changed",
+                           G_CALLBACK (on_icon_theme_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
 }
 
 
-static gboolean
-pos_osk_widget_draw (GtkWidget *widget, cairo_t *cr)
+static void
+pos_osk_widget_screen_changed (GtkWidget *widget, GdkScreen *previous_screen)
 {
   PosOskWidget *self = POS_OSK_WIDGET (widget);
-  GtkStyleContext *context;
-  PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_current_layer (self);
+  GdkScreen *screen = gtk_widget_get_screen (widget);
 
-  cairo_save (cr);
+  if (GTK_WIDGET_CLASS (pos_osk_widget_parent_class)->screen_changed)
+    GTK_WIDGET_CLASS (pos_osk_widget_parent_class)->screen_changed (widget, previous_screen);
 
-  context = gtk_widget_get_style_context (widget);
-  gtk_render_background (context, cr, 0, 0, self->width, self->height);
+  /* Icons are looked up in the theme of the widget's screen */
+  pos_osk_widget_set_icon_theme (self, gtk_icon_theme_get_for_screen (screen));
+}
 
-  cairo_translate (cr, layer->offset_x, 0);
 
-  for (int r = 0; r < self->layout.n_rows; r++) {
-    PosOskWidgetRow *row = pos_osk_widget_get_row (self, r);
+static void
+on_scale_factor_changed (PosOskWidget *self)
+{
+  pos_osk_widget_clear_render_cache (self);
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
 
-    for (int k = 0; k < pos_osk_widget_row_get_num_keys (row); k++) {
-      PosOskKey *key = pos_osk_widget_row_get_key (row, k);
 
-      draw_key (self, key, cr);
-    }
-  }
+static void
+pos_osk_widget_destroy (GtkWidget *widget)
+{
+  PosOskWidget *self = POS_OSK_WIDGET (widget);
 
-  cairo_restore (cr);
-  return FALSE;
+  if (self->char_popups)
+    pos_osk_widget_clear_char_popups (self);
+
+  GTK_WIDGET_CLASS (pos_osk_widget_parent_class)->destroy (widget);
 }
 
 
@@ -1296,15 +2065,21 @@ pos_osk_widget_finalize (GObject *object)
 {
   PosOskWidget *self = POS_OSK_WIDGET (object);
 
-  g_clear_handle_id (&self->repeat_id, g_source_remove);
-  pos_osk_widget_layout_free (&self->layout);
-  g_clear_object (&self->long_press);
+  g_queue_clear_full (&self->presses, (GDestroyNotify)pos_osk_widget_press_free);
+  pos_osk_widget_clear_geometry (self);
+  g_clear_pointer (&self->layout, pos_osk_layout_unref);
+  for (int i = 0; i < G_N_ELEMENTS (self->key_styles); i++)
+    g_clear_pointer (&self->key_styles[i], g_hash_table_destroy);
+  g_clear_pointer (&self->icons, g_hash_table_destroy);
+  g_clear_object (&self->icon_theme);
+  g_clear_pointer (&self->char_popups, g_hash_table_destroy);
+  g_clear_pointer (&self->key_path, gtk_widget_path_unref);
+  g_clear_object (&self->swipe_decoder);
   g_clear_pointer (&self->name, g_free);
   g_clear_pointer (&self->display_name, g_free);
   g_clear_pointer (&self->lang, g_free);
   g_clear_pointer (&self->region, g_free);
   g_clear_pointer (&self->layout_id, g_free);
-  g_ptr_array_free (self->symbols, TRUE);
 
   G_OBJECT_CLASS (pos_osk_widget_parent_class)->finalize (object);
 }
@@ -1316,8 +2091,9 @@ pos_osk_widget_get_preferred_height (GtkWidget       *widget,
                                      gint            *natural_height)
 {
   PosOskWidget *self = POS_OSK_WIDGET (widget);
+  guint n_rows = self->layout ? pos_osk_layout_get_n_rows (self->layout) : 0;
 
-  *minimum_height = *natural_height = KEY_HEIGHT * self->layout.n_rows;
+  *minimum_height = *natural_height = KEY_HEIGHT * n_rows;
 
 }
 
@@ -1340,11 +2116,15 @@ pos_osk_widget_class_init (PosOskWidgetClass *klass)
   object_class->set_property = pos_osk_widget_set_property;
   object_class->finalize = pos_osk_widget_finalize;
 
+  widget_class->destroy = pos_osk_widget_destroy;
   widget_class->draw = pos_osk_widget_draw;
   widget_class->size_allocate = pos_osk_widget_size_allocate;
+  widget_class->style_updated = pos_osk_widget_style_updated;
+  widget_class->screen_changed = pos_osk_widget_screen_changed;
   widget_class->button_press_event = pos_osk_widget_button_press_event;
   widget_class->button_release_event = pos_osk_widget_button_release_event;
   widget_class->motion_notify_event = pos_osk_widget_motion_notify_event;
+  widget_class->touch_event = pos_osk_widget_touch_event;
   widget_class->get_preferred_height = pos_osk_widget_get_preferred_height;
   widget_class->get_preferred_width = pos_osk_widget_get_preferred_width;
 
@@ -1464,6 +2244,55 @@ pos_osk_widget_class_init (PosOskWidgetClass *klass)
                                               0, NULL, NULL, NULL,
                                               G_TYPE_NONE,
                                               0);
+  /**
+   * PosOskWidget::swipe
+   * @self: The osk widget emitting the words
+   * @words: The words the swipe was decoded to, best match first
+   *
+   * A swipe over the keys was decoded into words. The key the swipe
+   * started on got cancelled via [signal@PosOskWidget::key-cancelled].
+   * See %PHOSH_OSK_FEATURE_SWIPE.
+   */
+  signals[OSK_SWIPE] = g_signal_new ("swipe",
+                                     G_TYPE_FROM_CLASS (klass),
+                                     G_SIGNAL_RUN_LAST,
+                                     0, NULL, NULL, NULL,
+                                     G_TYPE_NONE,
+                                     1,
+                                     G_TYPE_STRV);
+  /**
+   * PosOskWidget::cursor-motion
+   * @self: The osk widget moving the cursor
+   * @dx: The number of characters to move right (or left if negative)
+   * @dy: The number of lines to move down (or up if negative)
+   *
+   * The cursor should be moved while in %POS_OSK_WIDGET_MODE_CURSOR.
+   * Movement is accumulated and emitted at most once per frame.
+   */
+  signals[OSK_CURSOR_MOTION] = g_signal_new ("cursor-motion",
+                                             G_TYPE_FROM_CLASS (klass),
+                                             G_SIGNAL_RUN_LAST,
+                                             0, NULL, NULL, NULL,
+                                             G_TYPE_NONE,
+                                             2,
+                                             G_TYPE_INT,
+                                             G_TYPE_INT);
+  /**
+   * PosOskWidget::delete-repeat
+   * @self: The osk widget
+   * @words: Whether to delete a whole word rather than a character
+   *
+   * A held delete key repeated. This is emitted instead of
+   * [signal@PosOskWidget::key-symbol] so consecutive deletions can be
+   * batched. After a while the repeat switches from characters to words.
+   */
+  signals[OSK_DELETE_REPEAT] = g_signal_new ("delete-repeat",
+                                             G_TYPE_FROM_CLASS (klass),
+                                             G_SIGNAL_RUN_LAST,
+                                             0, NULL, NULL, NULL,
+                                             G_TYPE_NONE,
+                                             1,
+                                             G_TYPE_BOOLEAN);
 
   gtk_widget_class_set_css_name (widget_class, "pos-osk-widget");
 }
@@ -1492,41 +2321,40 @@ pos_osk_widget_init (PosOskWidget *self)
 {
   /* TODO support PIN, number, etc */
   const char *purpose_class = "normal";
-  g_autoptr (GtkWidgetPath) path = NULL;
-  GtkStyleContext *key_context;
-  GtkStyleContext *context;
 
   self->mode = POS_OSK_WIDGET_MODE_KEYBOARD;
   self->layer = POS_OSK_WIDGET_LAYER_NORMAL;
-  self->symbols = g_ptr_array_new ();
+  g_queue_init (&self->presses);
+  self->space = NO_KEY;
 
   gtk_widget_add_events (GTK_WIDGET (self), GDK_BUTTON_PRESS_MASK |
                          GDK_BUTTON_RELEASE_MASK |
-                         GDK_POINTER_MOTION_MASK);
+                         GDK_POINTER_MOTION_MASK |
+                         GDK_TOUCH_MASK);
 
-  context = gtk_widget_get_style_context (GTK_WIDGET (self));
-  /* Create a style context for the buttons */
-  path = gtk_widget_path_new ();
+  /* The path for the buttons' style contexts */
+  self->key_path = gtk_widget_path_new ();
   /* TODO: until keys are widgets */
-  gtk_widget_path_append_type (path, key_type ());
-  gtk_widget_path_iter_add_class (path, -1, purpose_class);
+  gtk_widget_path_append_type (self->key_path, key_type ());
+  gtk_widget_path_iter_add_class (self->key_path, -1, purpose_class);
 
-  key_context = gtk_style_context_new ();
-  gtk_style_context_set_path (key_context, path);
-  gtk_style_context_set_parent (key_context, context);
-  gtk_style_context_set_state (key_context, GTK_STATE_FLAG_NORMAL);
-  gtk_style_context_set_screen (key_context, gdk_screen_get_default ());
-
-  self->key_context = key_context;
+  for (int i = 0; i < G_N_ELEMENTS (self->key_styles); i++) {
+    self->key_styles[i] = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                                 (GDestroyNotify)pos_osk_widget_key_style_free);
+  }
 
   self->layer = POS_OSK_WIDGET_LAYER_NORMAL;
 
-  self->long_press = g_object_new (GTK_TYPE_GESTURE_LONG_PRESS,
-                                   "widget", self,
-                                   "propagation-phase", GTK_PHASE_CAPTURE,
-                                   "delay-factor", 0.5,
-                                   NULL);
-  g_signal_connect (self->long_press, "pressed", G_CALLBACK (on_long_pressed), self);
+  g_signal_connect (self, "notify::scale-factor", G_CALLBACK (on_scale_factor_changed), NULL);
+
+  self->icons = g_hash_table_new_full (pos_osk_widget_icon_key_hash,
+                                       pos_osk_widget_icon_key_equal,
+                                       g_free,
+                                       (GDestroyNotify)cairo_surface_destroy);
+  self->char_popups = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                             (GDestroyNotify)pos_osk_widget_char_popup_free);
+  pos_osk_widget_set_icon_theme (self,
+                                 gtk_icon_theme_get_for_screen (gtk_widget_get_screen (GTK_WIDGET (self))));
 
   self->cursor_drag = g_object_new (GTK_TYPE_GESTURE_DRAG,
                                     "widget", self,
@@ -1574,25 +2402,8 @@ pos_osk_widget_set_layer (PosOskWidget *self, PosOskWidgetLayer layer)
   self->layer = layer;
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_LAYER]);
+  /* Toggle keys change their pressed state too, see pos_osk_widget_is_key_toggled () */
   gtk_widget_queue_draw (GTK_WIDGET (self));
-
-  /* Update key state for rendering */
-  for (int r = 0; r < self->layout.n_rows; r++) {
-    PosOskWidgetRow *row = pos_osk_widget_get_row (self, r);
-
-    for (int k = 0; k < pos_osk_widget_row_get_num_keys (row); k++) {
-      PosOskKey *akey = g_ptr_array_index (row->keys, k);
-      gboolean pressed;
-
-      if (pos_osk_key_get_use (akey) != POS_OSK_KEY_USE_TOGGLE)
-        continue;
-
-      pressed = (self->layer == pos_osk_key_get_layer (akey)) ||
-        (pos_osk_widget_get_layer (self) == POS_OSK_WIDGET_LAYER_SYMBOLS2);
-
-      pos_osk_widget_set_key_pressed (self, akey, pressed);
-    }
-  }
 }
 
 
@@ -1604,7 +2415,7 @@ parse_lang (PosOskWidget *self, const char *layout, const char *variant)
   g_clear_pointer (&self->lang, g_free);
   g_clear_pointer (&self->region, g_free);
 
-  parts = g_strsplit (self->layout.locale, "-", -1);
+  parts = g_strsplit (pos_osk_layout_get_locale (self->layout), "-", -1);
   g_assert (g_strv_length (parts) < 3);
 
   /* Keyboard layout has locale like `pt-PT` */
@@ -1615,7 +2426,7 @@ parse_lang (PosOskWidget *self, const char *layout, const char *variant)
   }
 
   /* Keyboard layout has language (`en`), region is from layout (`us`) */
-  self->lang = g_strdup (self->layout.locale);
+  self->lang = g_strdup (pos_osk_layout_get_locale (self->layout));
   if (STR_IS_NULL_OR_EMPTY (variant)) {
     self->region = g_strdup (layout);
     return;
@@ -1655,17 +2466,28 @@ pos_osk_widget_set_layout (PosOskWidget *self,
                            const char   *variant,
                            GError      **err)
 {
-  g_autofree char *path = NULL;
-  g_autoptr (GBytes) data = NULL;
-  const char *json;
-  gsize size;
-  gboolean ret;
+  g_autofree char *id = NULL;
+  PosOskLayout *osk_layout;
 
   if (g_strcmp0 (self->name, name) == 0)
     return TRUE;
 
-  if (self->layout.name)
-    pos_osk_widget_layout_free (&self->layout);
+  if (!STR_IS_NULL_OR_EMPTY (variant))
+    id = g_strdup_printf ("%s+%s", layout, variant);
+  else
+    id = g_strdup (layout);
+
+  osk_layout = pos_osk_layout_get (id, err);
+  if (osk_layout == NULL)
+    return FALSE;
+
+  pos_osk_widget_clear_presses (self);
+  self->space = NO_KEY;
+  pos_osk_widget_clear_geometry (self);
+  pos_osk_widget_clear_char_popups (self);
+  g_clear_pointer (&self->layout, pos_osk_layout_unref);
+  self->layout = osk_layout;
+
   g_free (self->name);
   self->name = g_strdup (name);
   g_free (self->display_name);
@@ -1673,27 +2495,20 @@ pos_osk_widget_set_layout (PosOskWidget *self,
   g_free (self->layout_id);
   self->layout_id = g_strdup (layout_id);
 
-  if (!STR_IS_NULL_OR_EMPTY (variant))
-    path = g_strdup_printf ("/mobi/phosh/osk-stub/layouts/%s+%s.json", layout, variant);
-  else
-    path = g_strdup_printf ("/mobi/phosh/osk-stub/layouts/%s.json", layout);
-
-  data = g_resources_lookup_data (path, 0, err);
-  if (data == NULL) {
-    return FALSE;
-  }
-
-  g_ptr_array_free (self->symbols, TRUE);
-  self->symbols = g_ptr_array_new ();
+  parse_lang (self, layout, variant);
 
-  json = (char*) g_bytes_get_data (data, &size);
-  ret = parse_layout (self, json, size);
+  pos_osk_widget_update_geometry (self);
+  gtk_widget_queue_resize (GTK_WIDGET (self));
 
-  parse_lang (self, layout, variant);
+  /* Build popups ahead of time so long presses only need to show them */
+  self->prebuild_layer = POS_OSK_WIDGET_LAYER_NORMAL;
+  self->prebuild_key = 0;
+  self->prebuild_id = g_idle_add_full (G_PRIORITY_LOW, on_prebuild_char_popups, self, NULL);
+  g_source_set_name_by_id (self->prebuild_id, "[pos-prebuild-char-popups]");
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_NAME]);
 
-  return ret;
+  return TRUE;
 }
 
 /**
@@ -1736,15 +2551,15 @@ pos_osk_widget_set_mode (PosOskWidget *self, PosOskWidgetMode mode)
   g_debug ("Switching to mode: %d", mode);
   self->mode = mode;
 
-  if (mode == POS_OSK_WIDGET_MODE_CURSOR) {
-    self->current = NULL;
-  } else if (self->space) {
-    pos_osk_widget_set_key_pressed (self, self->space, FALSE);
-    self->space = NULL;
-  }
+  if (mode == POS_OSK_WIDGET_MODE_CURSOR)
+    pos_osk_widget_clear_presses (self);
+  else
+    self->space = NO_KEY;
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_MODE]);
   self->last_x = self->last_y = 0.0;
+  self->frame_dx = self->frame_dy = 0.0;
+  self->cursor_dx = self->cursor_dy = 0.0;
   gtk_widget_queue_draw (GTK_WIDGET (self));
 }
 
@@ -1816,8 +2631,9 @@ const char * const *
 pos_osk_widget_get_symbols (PosOskWidget *self)
 {
   g_return_val_if_fail (POS_IS_OSK_WIDGET (self), NULL);
+  g_return_val_if_fail (self->layout, NULL);
 
-  return (const char * const *)self->symbols->pdata;
+  return pos_osk_layout_get_symbols (self->layout);
 }
 
 
@@ -1837,5 +2653,105 @@ pos_osk_widget_set_features (PosOskWidget *self, PhoshOskFeatures features)
     return;
 
   self->features = features;
+
+  if (!(self->features & PHOSH_OSK_FEATURE_ADAPTIVE_KEYS))
+    pos_osk_widget_set_next_chars (self, NULL);
+
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_FEATURES]);
 }
+
+/**
+ * pos_osk_widget_set_next_chars:
+ * @self: The osk widget
+ * @next_chars:(nullable): The probabilities of the next characters
+ *
+ * Set how likely each character is to be typed next. The table maps
+ * lower cased characters to their probability as `double *`, see
+ * [method@Pos.Completer.get_next_chars]. If the widget has the
+ * %PHOSH_OSK_FEATURE_ADAPTIVE_KEYS feature set this is used to resolve
+ * touches close to key borders. The probabilities are mapped to keys here
+ * so pressing a key only needs a table lookup.
+ */
+void
+pos_osk_widget_set_next_chars (PosOskWidget *self, GHashTable *next_chars)
+{
+  g_return_if_fail (POS_IS_OSK_WIDGET (self));
+
+  for (int l = 0; l <= POS_OSK_WIDGET_LAST_LAYER; l++)
+    g_clear_pointer (&self->layers[l].key_prob, g_free);
+
+  if (!(self->features & PHOSH_OSK_FEATURE_ADAPTIVE_KEYS))
+    return;
+
+  if (self->layout == NULL || next_chars == NULL || g_hash_table_size (next_chars) == 0)
+    return;
+
+  for (int l = 0; l <= POS_OSK_WIDGET_LAST_LAYER; l++) {
+    PosOskWidgetKeyboardLayer *layer = pos_osk_widget_get_keyboard_layer (self, l);
+    const PosOskLayoutLayer *layout_layer = pos_osk_widget_get_layout_layer (self, l);
+
+    if (layout_layer->n_keys == 0)
+      continue;
+
+    layer->key_prob = g_new (float, layout_layer->n_keys);
+    for (int k = 0; k < layout_layer->n_keys; k++) {
+      const char *symbol = layout_layer->key_symbol[k];
+      g_autofree char *lower = NULL;
+      double *prob;
+
+      if (layout_layer->key_use[k] != POS_OSK_KEY_USE_KEY || symbol == NULL ||
+          g_utf8_strlen (symbol, -1) != 1) {
+        layer->key_prob[k] = -1.0;
+        continue;
+      }
+
+      lower = g_utf8_strdown (symbol, -1);
+      prob = g_hash_table_lookup (next_chars, lower);
+      layer->key_prob[k] = prob ? *prob : 0.0;
+    }
+  }
+}
+
+/**
+ * pos_osk_widget_set_swipe_decoder:
+ * @self: The osk widget
+ * @decoder:(nullable): The swipe decoder
+ *
+ * Set the decoder used to turn swipes into words. Swiping only
+ * happens if the widget has the %PHOSH_OSK_FEATURE_SWIPE feature set
+ * and the decoder has a lexicon.
+ */
+void
+pos_osk_widget_set_swipe_decoder (PosOskWidget *self, PosSwipeDecoder *decoder)
+{
+  g_return_if_fail (POS_IS_OSK_WIDGET (self));
+  g_return_if_fail (decoder == NULL || POS_IS_SWIPE_DECODER (decoder));
+
+  g_set_object (&self->swipe_decoder, decoder);
+}
+
+/**
+ * pos_osk_widget_get_symbol_at:
+ * @self: The osk widget
+ * @x: The x coordinate
+ * @y: The y coordinate
+ *
+ * Get the symbol of the key a touch at the given position would
+ * hit on the current layer. This is mostly useful for evaluating hit
+ * testing.
+ *
+ * Returns:(nullable): The symbol
+ */
+const char *
+pos_osk_widget_get_symbol_at (PosOskWidget *self, double x, double y)
+{
+  int key;
+
+  g_return_val_if_fail (POS_IS_OSK_WIDGET (self), NULL);
+
+  key = pos_osk_widget_locate_key (self, x, y);
+  if (key == NO_KEY)
+    return NULL;
+
+  return pos_osk_widget_get_layout_layer (self, self->layer)->key_symbol[key];
+}
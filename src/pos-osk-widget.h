@@ -9,6 +9,7 @@
 #include "phosh-osk-enums.h"
 #include "pos-enums.h"
 #include "pos-enum-types.h"
+#include "pos-swipe-decoder.h"
 #include <gtk/gtk.h>
 
 G_BEGIN_DECLS
@@ -36,5 +37,8 @@ const char       *pos_osk_widget_get_lang   (PosOskWidget *self);
 const char       *pos_osk_widget_get_region (PosOskWidget *self);
 void              pos_osk_widget_set_features (PosOskWidget *self, PhoshOskFeatures features);
 const char *const *pos_osk_widget_get_symbols (PosOskWidget *self);
+void              pos_osk_widget_set_next_chars (PosOskWidget *self, GHashTable *next_chars);
+const char       *pos_osk_widget_get_symbol_at (PosOskWidget *self, double x, double y);
+void              pos_osk_widget_set_swipe_decoder (PosOskWidget *self, PosSwipeDecoder *decoder);
 
 G_END_DECLS
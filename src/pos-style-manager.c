@@ -68,6 +68,7 @@ on_accent_color_changed (PosStyleManager *self)
   if (self->accent_css_provider) {
     gtk_style_context_remove_provider_for_screen (gdk_screen_get_default (),
                                                   GTK_STYLE_PROVIDER (self->accent_css_provider));
+    g_clear_object (&self->accent_css_provider);
   }
 
   /* Only enable accent colors on Adwaita */
@@ -114,7 +115,7 @@ on_accent_color_changed (PosStyleManager *self)
   gtk_style_context_add_provider_for_screen (gdk_screen_get_default (),
                                              GTK_STYLE_PROVIDER (provider),
                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION + 1);
-  g_set_object (&self->css_provider, provider);
+  g_set_object (&self->accent_css_provider, provider);
 }
 
 
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-surrounding-text"
+
+#include "pos-config.h"
+
+#include "pos-surrounding-text.h"
+#include "pos-symbol.h"
+
+#include <string.h>
+
+/**
+ * PosSurroundingText:
+ *
+ * The text around the cursor as sent by the input method. The text is
+ * immutable and shared (refcounted) between the input method's pending
+ * and applied state and its users so a surrounding text event costs a
+ * single copy. Users get views into the text instead of copies.
+ *
+ * The delta is the range that changed compared to the previous text.
+ * It's only determined when asked for so applying a text doesn't scan
+ * it.
+ */
+struct _PosSurroundingText {
+  char               *text;
+  gsize               len;
+  guint               cursor;
+  guint               anchor;
+
+  /* The previous text until the delta got determined */
+  PosSurroundingText *prev;
+  gboolean            has_delta;
+  guint               delta_pos;
+  guint               delta_removed;
+  guint               delta_inserted;
+};
+
+G_DEFINE_BOXED_TYPE (PosSurroundingText, pos_surrounding_text,
+                     pos_surrounding_text_ref, pos_surrounding_text_unref);
+
+
+#define IS_CONTINUATION_BYTE(c) (((guchar)(c) & 0xC0) == 0x80)
+
+
+static void
+pos_surrounding_text_free (gpointer data)
+{
+  PosSurroundingText *self = data;
+
+  g_clear_pointer (&self->prev, pos_surrounding_text_unref);
+  g_free (self->text);
+}
+
+
+/* Classify from the code point so client text doesn't get interned */
+static gboolean
+is_word_separator (const char *p)
+{
+  return !!(pos_symbol_get_unichar_flags (g_utf8_get_char (p)) & POS_SYMBOL_FLAG_SEPARATOR);
+}
+
+
+static void
+update_delta (PosSurroundingText *self)
+{
+  const PosSurroundingText *prev = self->prev;
+  gsize prefix = 0, suffix = 0, max;
+
+  max = MIN (self->len, prev->len);
+  while (prefix < max && self->text[prefix] == prev->text[prefix])
+    prefix++;
+  while (prefix > 0 && IS_CONTINUATION_BYTE (self->text[prefix]))
+    prefix--;
+
+  max -= prefix;
+  while (suffix < max &&
+         self->text[self->len - suffix - 1] == prev->text[prev->len - suffix - 1])
+    suffix++;
+  while (suffix > 0 && IS_CONTINUATION_BYTE (self->text[self->len - suffix]))
+    suffix--;
+
+  self->has_delta = TRUE;
+  self->delta_pos = prefix;
+  self->delta_removed = prev->len - prefix - suffix;
+  self->delta_inserted = self->len - prefix - suffix;
+
+  g_clear_pointer (&self->prev, pos_surrounding_text_unref);
+}
+
+/**
+ * pos_surrounding_text_new:
+ * @text: The text
+ * @cursor: The cursor position in bytes
+ * @anchor: The anchor (end of selection) in bytes
+ *
+ * Creates a new surrounding text. Cursor and anchor get clamped to the
+ * text's length.
+ *
+ * Returns:(transfer full): The surrounding text
+ */
+PosSurroundingText *
+pos_surrounding_text_new (const char *text, guint cursor, guint anchor)
+{
+  PosSurroundingText *self;
+
+  g_return_val_if_fail (text, NULL);
+
+  self = g_atomic_rc_box_new0 (PosSurroundingText);
+  self->len = strlen (text);
+  self->text = g_memdup2 (text, self->len + 1);
+  self->cursor = MIN (cursor, self->len);
+  self->anchor = MIN (anchor, self->len);
+
+  return self;
+}
+
+
+PosSurroundingText *
+pos_surrounding_text_ref (PosSurroundingText *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+
+void
+pos_surrounding_text_unref (PosSurroundingText *self)
+{
+  g_atomic_rc_box_release_full (self, pos_surrounding_text_free);
+}
+
+/**
+ * pos_surrounding_text_equal:
+ * @a:(nullable): A surrounding text
+ * @b:(nullable): Another surrounding text
+ *
+ * Checks whether text, cursor and anchor are the same.
+ *
+ * Returns: %TRUE if equal
+ */
+gboolean
+pos_surrounding_text_equal (const PosSurroundingText *a, const PosSurroundingText *b)
+{
+  if (a == b)
+    return TRUE;
+
+  if (a == NULL || b == NULL)
+    return FALSE;
+
+  return a->cursor == b->cursor &&
+         a->anchor == b->anchor &&
+         a->len == b->len &&
+         memcmp (a->text, b->text, a->len) == 0;
+}
+
+/**
+ * pos_surrounding_text_get_text:
+ * @self: The surrounding text
+ * @len:(out)(optional): The text's length in bytes
+ *
+ * Returns: The whole text
+ */
+const char *
+pos_surrounding_text_get_text (PosSurroundingText *self, gsize *len)
+{
+  g_return_val_if_fail (self, NULL);
+
+  if (len)
+    *len = self->len;
+
+  return self->text;
+}
+
+
+guint
+pos_surrounding_text_get_cursor (PosSurroundingText *self)
+{
+  g_return_val_if_fail (self, 0);
+
+  return self->cursor;
+}
+
+
+guint
+pos_surrounding_text_get_anchor (PosSurroundingText *self)
+{
+  g_return_val_if_fail (self, 0);
+
+  return self->anchor;
+}
+
+/**
+ * pos_surrounding_text_set_previous:
+ * @self: The surrounding text
+ * @prev:(nullable): The previous surrounding text
+ *
+ * Sets the text @self replaces so the range that differs can be
+ * determined later on. Without a previous text there's no delta.
+ */
+void
+pos_surrounding_text_set_previous (PosSurroundingText *self, PosSurroundingText *prev)
+{
+  g_return_if_fail (self);
+  g_return_if_fail (self != prev);
+
+  self->has_delta = FALSE;
+  g_clear_pointer (&self->prev, pos_surrounding_text_unref);
+  if (prev == NULL)
+    return;
+
+  /* Only the current text's delta is of interest, don't keep a chain of texts */
+  g_clear_pointer (&prev->prev, pos_surrounding_text_unref);
+  self->prev = pos_surrounding_text_ref (prev);
+}
+
+/**
+ * pos_surrounding_text_get_delta:
+ * @self: The surrounding text
+ * @pos:(out)(optional): The byte offset where the texts start to differ
+ * @n_removed:(out)(optional): Bytes of the previous text replaced at @pos
+ * @n_inserted:(out)(optional): Bytes of this text inserted at @pos
+ *
+ * Gets what changed compared to the previous text. This is determined
+ * on the first call.
+ *
+ * Returns: %TRUE if the delta is known
+ */
+gboolean
+pos_surrounding_text_get_delta (PosSurroundingText *self,
+                                guint              *pos,
+                                guint              *n_removed,
+                                guint              *n_inserted)
+{
+  g_return_val_if_fail (self, FALSE);
+
+  if (self->prev)
+    update_delta (self);
+
+  if (pos)
+    *pos = self->delta_pos;
+  if (n_removed)
+    *n_removed = self->delta_removed;
+  if (n_inserted)
+    *n_inserted = self->delta_inserted;
+
+  return self->has_delta;
+}
+
+/**
+ * pos_surrounding_text_get_before:
+ * @self: The surrounding text
+ * @max_len: The maximum length in bytes
+ * @len:(out): The length of the returned text in bytes
+ *
+ * Gets (up to @max_len bytes of) the text right before the cursor
+ * without cutting characters in half. The returned text isn't
+ * `NUL` terminated.
+ *
+ * Returns: The start of the text
+ */
+const char *
+pos_surrounding_text_get_before (PosSurroundingText *self, gsize max_len, gsize *len)
+{
+  gsize start;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (len, NULL);
+
+  start = self->cursor > max_len ? self->cursor - max_len : 0;
+  while (start < self->cursor && IS_CONTINUATION_BYTE (self->text[start]))
+    start++;
+
+  *len = self->cursor - start;
+  return &self->text[start];
+}
+
+/**
+ * pos_surrounding_text_get_after:
+ * @self: The surrounding text
+ *
+ * Returns: The text after the cursor
+ */
+const char *
+pos_surrounding_text_get_after (PosSurroundingText *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return &self->text[self->cursor];
+}
+
+/**
+ * pos_surrounding_text_get_word:
+ * @self: The surrounding text
+ * @len:(out): The length of the word in bytes
+ *
+ * Gets the word the cursor is in. The returned text isn't `NUL`
+ * terminated.
+ *
+ * Returns: The start of the word
+ */
+const char *
+pos_surrounding_text_get_word (PosSurroundingText *self, gsize *len)
+{
+  const char *start, *end, *p;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (len, NULL);
+
+  start = &self->text[self->cursor];
+  for (p = g_utf8_find_prev_char (self->text, start); p; p = g_utf8_find_prev_char (self->text, p)) {
+    if (is_word_separator (p))
+      break;
+    start = p;
+  }
+
+  for (end = &self->text[self->cursor]; *end; end = g_utf8_next_char (end)) {
+    if (is_word_separator (end))
+      break;
+  }
+
+  *len = end - start;
+  return start;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define POS_TYPE_SURROUNDING_TEXT (pos_surrounding_text_get_type ())
+GType   pos_surrounding_text_get_type      (void) G_GNUC_CONST;
+
+typedef struct _PosSurroundingText PosSurroundingText;
+
+PosSurroundingText *pos_surrounding_text_new (const char *text, guint cursor, guint anchor);
+PosSurroundingText *pos_surrounding_text_ref (PosSurroundingText *self);
+void                pos_surrounding_text_unref (PosSurroundingText *self);
+gboolean            pos_surrounding_text_equal (const PosSurroundingText *a,
+                                                const PosSurroundingText *b);
+const char         *pos_surrounding_text_get_text (PosSurroundingText *self, gsize *len);
+guint               pos_surrounding_text_get_cursor (PosSurroundingText *self);
+guint               pos_surrounding_text_get_anchor (PosSurroundingText *self);
+void                pos_surrounding_text_set_previous (PosSurroundingText *self,
+                                                       PosSurroundingText *prev);
+gboolean            pos_surrounding_text_get_delta (PosSurroundingText *self,
+                                                    guint              *pos,
+                                                    guint              *n_removed,
+                                                    guint              *n_inserted);
+const char         *pos_surrounding_text_get_before (PosSurroundingText *self,
+                                                     gsize               max_len,
+                                                     gsize              *len);
+const char         *pos_surrounding_text_get_after (PosSurroundingText *self);
+const char         *pos_surrounding_text_get_word (PosSurroundingText *self, gsize *len);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PosSurroundingText, pos_surrounding_text_unref);
+
+G_END_DECLS
@@ -0,0 +1,636 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-swipe-decoder"
+
+#include "pos-config.h"
+
+#include "pos-swipe-decoder.h"
+
+#include <gio/gio.h>
+
+#include <math.h>
+#include <string.h>
+
+/* Number of points traces and word templates are resampled to */
+#define RESAMPLE_POINTS 48
+/* Words longer than this (in characters) aren't swipeable */
+#define MAX_WORD_LEN 32
+/* Upper bound of words to match templates against, the most frequent ones are kept */
+#define MAX_CANDIDATES 2048
+/* Distance (in key sizes) a trace needs to come close to a letter's key */
+#define PASS_RADIUS 0.9
+/* Distance (in key sizes) the trace needs to start and end at the first/last letter */
+#define END_RADIUS 1.2
+/* How much word frequency counts compared to the trace's shape */
+#define PRIOR_WEIGHT 0.05
+/* Traces shorter than this (in key sizes) aren't swipes */
+#define MIN_TRACE_LEN 0.8
+
+/**
+ * PosSwipeDecoder:
+ *
+ * Decodes the trace of a finger swiping across the keyboard into words
+ * ("shape writing").
+ *
+ * The lexicon is kept as a trie. When decoding, the trie is only
+ * descended along letters whose keys the trace passes close by in
+ * order, so only a small part of it is visited. The remaining
+ * candidates are compared against the trace by resampling the path
+ * through their keys' centers to the same number of points. Matching a
+ * candidate stops as soon as it can't make it into the results anymore.
+ *
+ * The lexicon is a plain text file with one word per line optionally
+ * followed by a usage count.
+ */
+
+typedef struct {
+  gunichar c;
+  guint32  first_child;
+  guint32  next_sibling;
+  gint32   word;
+} PosSwipeTrieNode;
+
+typedef struct {
+  guint32 node;
+  guint16 pos;
+  guint16 depth;
+  gint16  key;
+} PosSwipeTrieState;
+
+typedef struct {
+  double score;
+  guint  word;
+} PosSwipeResult;
+
+struct _PosSwipeDecoder {
+  GObject       parent;
+
+  char         *lang;
+  char         *region;
+
+  /* Root is node 0 so 0 also means "no node" */
+  GArray       *nodes;
+  GPtrArray    *words;
+  GArray       *costs;
+};
+G_DEFINE_TYPE (PosSwipeDecoder, pos_swipe_decoder, G_TYPE_OBJECT)
+
+
+static void
+pos_swipe_decoder_clear (PosSwipeDecoder *self)
+{
+  PosSwipeTrieNode root = { 0, 0, 0, -1 };
+
+  g_array_set_size (self->nodes, 0);
+  g_array_append_val (self->nodes, root);
+  g_ptr_array_set_size (self->words, 0);
+  g_array_set_size (self->costs, 0);
+}
+
+
+static guint32
+pos_swipe_decoder_add_child (PosSwipeDecoder *self, guint32 parent, gunichar c)
+{
+  PosSwipeTrieNode *node = &g_array_index (self->nodes, PosSwipeTrieNode, parent);
+  PosSwipeTrieNode child = { c, 0, node->first_child, -1 };
+
+  for (guint32 n = node->first_child; n; ) {
+    PosSwipeTrieNode *sibling = &g_array_index (self->nodes, PosSwipeTrieNode, n);
+
+    if (sibling->c == c)
+      return n;
+    n = sibling->next_sibling;
+  }
+
+  /* Appending might move the array so don't use `node` afterwards */
+  g_array_append_val (self->nodes, child);
+  g_array_index (self->nodes, PosSwipeTrieNode, parent).first_child = self->nodes->len - 1;
+
+  return self->nodes->len - 1;
+}
+
+
+static void
+pos_swipe_decoder_add_word (PosSwipeDecoder *self, const char *word, double count)
+{
+  guint32 node = 0;
+  guint len = 0;
+  PosSwipeTrieNode *leaf;
+
+  for (const char *p = word; *p; p = g_utf8_next_char (p)) {
+    gunichar c = g_unichar_tolower (g_utf8_get_char (p));
+
+    if (++len > MAX_WORD_LEN)
+      return;
+
+    node = pos_swipe_decoder_add_child (self, node, c);
+  }
+
+  /* Swiping needs at least two letters */
+  if (len < 2)
+    return;
+
+  leaf = &g_array_index (self->nodes, PosSwipeTrieNode, node);
+  if (leaf->word >= 0) {
+    /* Same word in different case, sum up */
+    g_array_index (self->costs, double, leaf->word) += count;
+    return;
+  }
+
+  leaf->word = self->words->len;
+  g_ptr_array_add (self->words, g_strdup (word));
+  g_array_append_val (self->costs, count);
+}
+
+
+static void
+pos_swipe_decoder_finalize (GObject *object)
+{
+  PosSwipeDecoder *self = POS_SWIPE_DECODER (object);
+
+  g_clear_pointer (&self->nodes, g_array_unref);
+  g_clear_pointer (&self->words, g_ptr_array_unref);
+  g_clear_pointer (&self->costs, g_array_unref);
+  g_clear_pointer (&self->lang, g_free);
+  g_clear_pointer (&self->region, g_free);
+
+  G_OBJECT_CLASS (pos_swipe_decoder_parent_class)->finalize (object);
+}
+
+
+static void
+pos_swipe_decoder_class_init (PosSwipeDecoderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = pos_swipe_decoder_finalize;
+}
+
+
+static void
+pos_swipe_decoder_init (PosSwipeDecoder *self)
+{
+  self->nodes = g_array_new (FALSE, FALSE, sizeof (PosSwipeTrieNode));
+  self->words = g_ptr_array_new_with_free_func (g_free);
+  self->costs = g_array_new (FALSE, FALSE, sizeof (double));
+
+  pos_swipe_decoder_clear (self);
+}
+
+
+PosSwipeDecoder *
+pos_swipe_decoder_new (void)
+{
+  return g_object_new (POS_TYPE_SWIPE_DECODER, NULL);
+}
+
+/**
+ * pos_swipe_decoder_load_lexicon:
+ * @self: The swipe decoder
+ * @path: The lexicon file
+ * @err: The error location
+ *
+ * Loads the words the decoder picks from. Each line of the file
+ * holds a word optionally followed by its usage count.
+ *
+ * Returns: %TRUE if the lexicon was loaded, otherwise %FALSE
+ */
+gboolean
+pos_swipe_decoder_load_lexicon (PosSwipeDecoder *self, const char *path, GError **err)
+{
+  g_autofree char *contents = NULL;
+  char *line, *next;
+  double total = 0.0;
+
+  g_return_val_if_fail (POS_IS_SWIPE_DECODER (self), FALSE);
+
+  if (!g_file_get_contents (path, &contents, NULL, err))
+    return FALSE;
+
+  pos_swipe_decoder_clear (self);
+
+  for (line = contents; line; line = next) {
+    char *count_str;
+    double count = 1.0;
+
+    next = strchr (line, '\n');
+    if (next)
+      *next++ = '\0';
+
+    g_strstrip (line);
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    count_str = strpbrk (line, " \t");
+    if (count_str) {
+      *count_str++ = '\0';
+      count = MAX (g_ascii_strtod (count_str, NULL), 1.0);
+    }
+
+    if (!g_utf8_validate (line, -1, NULL))
+      continue;
+
+    pos_swipe_decoder_add_word (self, line, count);
+  }
+
+  /* Turn counts into costs (negative log probabilities) */
+  for (guint i = 0; i < self->costs->len; i++)
+    total += g_array_index (self->costs, double, i);
+
+  for (guint i = 0; i < self->costs->len; i++) {
+    double *cost = &g_array_index (self->costs, double, i);
+
+    *cost = -log (*cost / total);
+  }
+
+  g_debug ("Loaded %u words (%u trie nodes) from %s", self->words->len, self->nodes->len, path);
+  return TRUE;
+}
+
+/**
+ * pos_swipe_decoder_set_language:
+ * @self: The swipe decoder
+ * @lang:(nullable): The language
+ * @region:(nullable): The region
+ * @err: The error location
+ *
+ * Loads the lexicon for the given language. Passing %NULL for
+ * `lang` drops the current lexicon.
+ *
+ * Returns: %TRUE if the lexicon was loaded, otherwise %FALSE
+ */
+gboolean
+pos_swipe_decoder_set_language (PosSwipeDecoder *self,
+                                const char      *lang,
+                                const char      *region,
+                                GError         **err)
+{
+  g_autofree char *upcase_region = NULL;
+  g_autofree char *locale_file = NULL;
+  g_autofree char *lang_file = NULL;
+  const char *files[2];
+
+  g_return_val_if_fail (POS_IS_SWIPE_DECODER (self), FALSE);
+
+  if (g_strcmp0 (self->lang, lang) == 0 && g_strcmp0 (self->region, region) == 0)
+    return TRUE;
+
+  g_clear_pointer (&self->lang, g_free);
+  g_clear_pointer (&self->region, g_free);
+  pos_swipe_decoder_clear (self);
+
+  if (lang == NULL)
+    return TRUE;
+
+  upcase_region = g_ascii_strup (region ?: "", -1);
+  locale_file = g_strdup_printf ("%s/%s_%s.txt", POS_SWIPE_DICT_DIR, lang, upcase_region);
+  lang_file = g_strdup_printf ("%s/%s.txt", POS_SWIPE_DICT_DIR, lang);
+  files[0] = locale_file;
+  files[1] = lang_file;
+
+  for (int i = 0; i < G_N_ELEMENTS (files); i++) {
+    if (!g_file_test (files[i], G_FILE_TEST_EXISTS))
+      continue;
+
+    if (!pos_swipe_decoder_load_lexicon (self, files[i], err))
+      return FALSE;
+
+    self->lang = g_strdup (lang);
+    self->region = g_strdup (region);
+    return TRUE;
+  }
+
+  g_set_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+               "No swipe lexicon for %s-%s in %s", lang, region, POS_SWIPE_DICT_DIR);
+  return FALSE;
+}
+
+/**
+ * pos_swipe_decoder_get_n_words:
+ * @self: The swipe decoder
+ *
+ * Returns: The number of words in the lexicon.
+ */
+guint
+pos_swipe_decoder_get_n_words (PosSwipeDecoder *self)
+{
+  g_return_val_if_fail (POS_IS_SWIPE_DECODER (self), 0);
+
+  return self->words->len;
+}
+
+
+static inline double
+point_dist (double x1, double y1, double x2, double y2)
+{
+  return hypot (x1 - x2, y1 - y2);
+}
+
+/* Resample a polyline to `n_out` equidistant points */
+static double
+resample (const PosSwipePoint *points, guint n_points, PosSwipePoint *out, guint n_out)
+{
+  double total = 0.0, step, covered = 0.0;
+  guint k = 1;
+
+  for (guint i = 1; i < n_points; i++)
+    total += point_dist (points[i - 1].x, points[i - 1].y, points[i].x, points[i].y);
+
+  step = total / (n_out - 1);
+  out[0] = points[0];
+
+  for (guint i = 1; i < n_points && k < n_out; i++) {
+    const PosSwipePoint *a = &points[i - 1], *b = &points[i];
+    double seg = point_dist (a->x, a->y, b->x, b->y);
+
+    while (k < n_out && seg > 0 && covered + seg >= k * step) {
+      double t = (k * step - covered) / seg;
+
+      out[k].x = a->x + t * (b->x - a->x);
+      out[k].y = a->y + t * (b->y - a->y);
+      k++;
+    }
+    covered += seg;
+  }
+
+  for (; k < n_out; k++)
+    out[k] = points[n_points - 1];
+
+  return total;
+}
+
+
+static int
+lookup_key (GHashTable *key_index, gunichar c)
+{
+  gpointer value;
+
+  if (!g_hash_table_lookup_extended (key_index, GUINT_TO_POINTER (c), NULL, &value))
+    return -1;
+
+  return GPOINTER_TO_INT (value);
+}
+
+#define CANDIDATE_COST(candidates, costs, i) \
+  g_array_index ((costs), double, g_array_index ((candidates), guint, (i)))
+
+/*
+ * Keep the MAX_CANDIDATES words with the lowest cost in a max heap so
+ * the costliest one is at the top and gets replaced first.
+ */
+static void
+add_candidate (GArray *candidates, GArray *costs, guint word)
+{
+  double cost = g_array_index (costs, double, word);
+  guint *heap;
+  guint i;
+
+  if (candidates->len < MAX_CANDIDATES) {
+    g_array_append_val (candidates, word);
+    heap = (guint *)candidates->data;
+
+    for (i = candidates->len - 1; i > 0; i = (i - 1) / 2) {
+      guint parent = (i - 1) / 2;
+
+      if (CANDIDATE_COST (candidates, costs, parent) >= cost)
+        break;
+      heap[i] = heap[parent];
+    }
+    heap[i] = word;
+    return;
+  }
+
+  if (cost >= CANDIDATE_COST (candidates, costs, 0))
+    return;
+
+  heap = (guint *)candidates->data;
+  i = 0;
+  while (2 * i + 1 < candidates->len) {
+    guint child = 2 * i + 1;
+
+    if (child + 1 < candidates->len &&
+        CANDIDATE_COST (candidates, costs, child + 1) > CANDIDATE_COST (candidates, costs, child))
+      child++;
+
+    if (CANDIDATE_COST (candidates, costs, child) <= cost)
+      break;
+
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = word;
+}
+
+/*
+ * Descend the trie along the letters the trace passes in order and
+ * collect the words whose first and last letters match the trace's
+ * start and end.
+ */
+static void
+collect_candidates (PosSwipeDecoder     *self,
+                    GHashTable          *key_index,
+                    const PosSwipeKey   *keys,
+                    double               key_size,
+                    const PosSwipePoint *trace,
+                    GArray              *candidates)
+{
+  g_autoptr (GArray) stack = g_array_new (FALSE, FALSE, sizeof (PosSwipeTrieState));
+  double pass_radius = PASS_RADIUS * key_size;
+  double end_radius = END_RADIUS * key_size;
+  const PosSwipePoint *last = &trace[RESAMPLE_POINTS - 1];
+  PosSwipeTrieState root = { 0, 0, 0, -1 };
+
+  g_array_append_val (stack, root);
+
+  while (stack->len) {
+    PosSwipeTrieState state = g_array_index (stack, PosSwipeTrieState, stack->len - 1);
+    const PosSwipeTrieNode *node = &g_array_index (self->nodes, PosSwipeTrieNode, state.node);
+
+    g_array_set_size (stack, stack->len - 1);
+
+    if (node->word >= 0 && state.depth >= 2 &&
+        point_dist (keys[state.key].x, keys[state.key].y, last->x, last->y) < end_radius) {
+      add_candidate (candidates, self->costs, node->word);
+    }
+
+    for (guint32 n = node->first_child; n; ) {
+      const PosSwipeTrieNode *child = &g_array_index (self->nodes, PosSwipeTrieNode, n);
+      guint32 child_node = n;
+      int key = lookup_key (key_index, child->c);
+      int pos = -1;
+
+      n = child->next_sibling;
+      if (key < 0)
+        continue;
+
+      if (state.depth == 0) {
+        /* The first letter must be where the trace starts */
+        if (point_dist (keys[key].x, keys[key].y, trace[0].x, trace[0].y) < end_radius)
+          pos = 0;
+      } else if (key == state.key) {
+        /* Double letters */
+        pos = state.pos;
+      } else {
+        /* Earliest point passing the key so later letters have the most room */
+        for (int j = state.pos; j < RESAMPLE_POINTS; j++) {
+          if (point_dist (keys[key].x, keys[key].y, trace[j].x, trace[j].y) < pass_radius) {
+            pos = j;
+            break;
+          }
+        }
+      }
+
+      if (pos >= 0) {
+        PosSwipeTrieState next = { child_node, pos, state.depth + 1, key };
+
+        g_array_append_val (stack, next);
+      }
+    }
+  }
+}
+
+
+static int
+compare_candidates (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  GArray *costs = user_data;
+  double cost_a = g_array_index (costs, double, *(guint *)a);
+  double cost_b = g_array_index (costs, double, *(guint *)b);
+
+  return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+
+/* Build the path through the word's keys, skipping repeated letters */
+static guint
+word_path (const char *word, GHashTable *key_index, const PosSwipeKey *keys, PosSwipePoint *path)
+{
+  int last = -1;
+  guint n = 0;
+
+  for (const char *p = word; *p; p = g_utf8_next_char (p)) {
+    int key = lookup_key (key_index, g_unichar_tolower (g_utf8_get_char (p)));
+
+    if (key < 0 || key == last)
+      continue;
+
+    path[n].x = keys[key].x;
+    path[n].y = keys[key].y;
+    last = key;
+    n++;
+  }
+
+  return n;
+}
+
+/**
+ * pos_swipe_decoder_decode:
+ * @self: The swipe decoder
+ * @keys: The keys on the keyboard
+ * @n_keys: The number of keys
+ * @key_size: The size of a key. Distances are measured relative to it.
+ * @trace: The points of the swipe's trace
+ * @n_points: The number of points in the trace
+ * @max_results: The maximum number of words to return
+ *
+ * Finds the words that best match the given trace.
+ *
+ * Returns:(transfer full)(nullable): The matching words, best match first
+ */
+GStrv
+pos_swipe_decoder_decode (PosSwipeDecoder     *self,
+                          const PosSwipeKey   *keys,
+                          guint                n_keys,
+                          double               key_size,
+                          const PosSwipePoint *trace,
+                          guint                n_points,
+                          guint                max_results)
+{
+  g_autoptr (GHashTable) key_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_autoptr (GArray) candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+  g_autoptr (GStrvBuilder) builder = NULL;
+  g_autofree PosSwipeResult *results = NULL;
+  PosSwipePoint resampled[RESAMPLE_POINTS];
+  PosSwipePoint path[MAX_WORD_LEN];
+  PosSwipePoint shape[RESAMPLE_POINTS];
+  guint n_results = 0;
+  gint64 start;
+
+  g_return_val_if_fail (POS_IS_SWIPE_DECODER (self), NULL);
+  g_return_val_if_fail (key_size > 0, NULL);
+
+  if (n_points < 2 || self->words->len == 0 || max_results == 0)
+    return NULL;
+
+  start = g_get_monotonic_time ();
+
+  if (resample (trace, n_points, resampled, RESAMPLE_POINTS) < MIN_TRACE_LEN * key_size)
+    return NULL;
+
+  for (guint i = 0; i < n_keys; i++) {
+    gunichar c;
+
+    if (keys[i].symbol == NULL || g_utf8_strlen (keys[i].symbol, -1) != 1)
+      continue;
+
+    c = g_unichar_tolower (g_utf8_get_char (keys[i].symbol));
+    g_hash_table_insert (key_index, GUINT_TO_POINTER (c), GINT_TO_POINTER (i));
+  }
+
+  collect_candidates (self, key_index, keys, key_size, resampled, candidates);
+  /* Likely words first so the bound for early termination tightens quickly */
+  g_array_sort_with_data (candidates, compare_candidates, self->costs);
+
+  results = g_new (PosSwipeResult, max_results);
+  for (guint i = 0; i < candidates->len; i++) {
+    guint word = g_array_index (candidates, guint, i);
+    double prior = PRIOR_WEIGHT * g_array_index (self->costs, double, word);
+    double bound = G_MAXDOUBLE, sum = 0.0, score;
+    guint n_path, j;
+
+    if (n_results == max_results) {
+      bound = results[n_results - 1].score;
+      /* Candidates are sorted by cost, no later one can beat the bound */
+      if (prior >= bound)
+        break;
+    }
+
+    n_path = word_path (g_ptr_array_index (self->words, word), key_index, keys, path);
+    resample (path, n_path, shape, RESAMPLE_POINTS);
+
+    /* Mean distance between trace and word shape, give up once out of reach */
+    for (j = 0; j < RESAMPLE_POINTS; j++) {
+      sum += point_dist (shape[j].x, shape[j].y, resampled[j].x, resampled[j].y);
+      if (prior + sum / (RESAMPLE_POINTS * key_size) >= bound)
+        break;
+    }
+    if (j < RESAMPLE_POINTS)
+      continue;
+
+    score = prior + sum / (RESAMPLE_POINTS * key_size);
+
+    /* Insert sorted, dropping the worst result if full */
+    if (n_results < max_results)
+      n_results++;
+    for (j = n_results - 1; j > 0 && results[j - 1].score > score; j--)
+      results[j] = results[j - 1];
+    results[j].score = score;
+    results[j].word = word;
+  }
+
+  g_debug ("Decoded %u candidates in %" G_GINT64_FORMAT "µs",
+           candidates->len, g_get_monotonic_time () - start);
+
+  if (n_results == 0)
+    return NULL;
+
+  builder = g_strv_builder_new ();
+  for (guint i = 0; i < n_results; i++)
+    g_strv_builder_add (builder, g_ptr_array_index (self->words, results[i].word));
+
+  return g_strv_builder_end (builder);
+}
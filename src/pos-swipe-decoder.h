@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PosSwipeKey:
+ * @symbol: The key's symbol
+ * @x: The x coordinate of the key's center
+ * @y: The y coordinate of the key's center
+ *
+ * A key a swipe can pass over.
+ */
+typedef struct {
+  const char *symbol;
+  double      x;
+  double      y;
+} PosSwipeKey;
+
+/**
+ * PosSwipePoint:
+ * @x: The x coordinate
+ * @y: The y coordinate
+ *
+ * A point of a swipe's trace.
+ */
+typedef struct {
+  double x;
+  double y;
+} PosSwipePoint;
+
+#define POS_TYPE_SWIPE_DECODER (pos_swipe_decoder_get_type ())
+
+G_DECLARE_FINAL_TYPE (PosSwipeDecoder, pos_swipe_decoder, POS, SWIPE_DECODER, GObject)
+
+PosSwipeDecoder *pos_swipe_decoder_new (void);
+gboolean         pos_swipe_decoder_set_language (PosSwipeDecoder *self,
+                                                 const char      *lang,
+                                                 const char      *region,
+                                                 GError         **err);
+gboolean         pos_swipe_decoder_load_lexicon (PosSwipeDecoder *self,
+                                                 const char      *path,
+                                                 GError         **err);
+guint            pos_swipe_decoder_get_n_words (PosSwipeDecoder *self);
+GStrv            pos_swipe_decoder_decode (PosSwipeDecoder     *self,
+                                           const PosSwipeKey   *keys,
+                                           guint                n_keys,
+                                           double               key_size,
+                                           const PosSwipePoint *trace,
+                                           guint                n_points,
+                                           guint                max_results);
+
+G_END_DECLS
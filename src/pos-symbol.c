@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-symbol"
+
+#include "pos-config.h"
+
+#include "pos-symbol.h"
+
+/**
+ * PosSymbolInfo:
+ * @str: The interned symbol string
+ * @flags: The symbol's flags
+ * @codepoint: The (first) code point of text symbols
+ *
+ * Everything known about a symbol. Symbol ids index into the array of
+ * these so looking up a symbol's properties is a plain array access.
+ *
+ * Symbols are interned once (usually at layout load) and live as long
+ * as the process. Strings passed around on the keystroke path are
+ * interned already so mapping them to ids is a lookup by pointer.
+ */
+typedef struct {
+  const char     *str;
+  PosSymbolFlags  flags;
+  gunichar        codepoint;
+} PosSymbolInfo;
+
+/* Must match the order of the fixed ids in pos-symbol.h */
+static const char * const fixed_symbols[] = {
+  NULL,
+  " ",
+  "KEY_BACKSPACE",
+  "KEY_ENTER",
+  "KEY_TAB",
+  "KEY_LEFT",
+  "KEY_RIGHT",
+  "KEY_UP",
+  "KEY_DOWN",
+};
+
+static GArray     *symbols;
+static GHashTable *symbol_ids;
+static PosSymbol   ascii_symbols[128];
+
+
+static PosSymbolFlags
+get_flags (const char *str, gunichar *codepoint)
+{
+  PosSymbolFlags flags = POS_SYMBOL_FLAG_NONE;
+  gunichar c;
+
+  *codepoint = 0;
+  if (g_str_has_prefix (str, "KEY_"))
+    return POS_SYMBOL_FLAG_SPECIAL;
+
+  c = g_utf8_get_char_validated (str, -1);
+  if (c == (gunichar)-1 || c == (gunichar)-2)
+    return POS_SYMBOL_FLAG_NONE;
+
+  *codepoint = c;
+  if (c && *g_utf8_next_char (str) == '\0')
+    flags |= POS_SYMBOL_FLAG_CODEPOINT | pos_symbol_get_unichar_flags (c);
+
+  return flags;
+}
+
+
+static PosSymbol
+add_symbol (const char *interned)
+{
+  PosSymbolInfo info = { .str = interned };
+  PosSymbol symbol;
+
+  info.flags = get_flags (interned, &info.codepoint);
+  g_array_append_val (symbols, info);
+  symbol = symbols->len - 1;
+  g_hash_table_insert (symbol_ids, (gpointer)interned, GUINT_TO_POINTER (symbol));
+
+  return symbol;
+}
+
+
+static void
+ensure_symbols (void)
+{
+  if (G_LIKELY (symbols))
+    return;
+
+  symbols = g_array_new (FALSE, TRUE, sizeof (PosSymbolInfo));
+  symbol_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  /* Id 0 is invalid */
+  g_array_set_size (symbols, 1);
+  for (int i = 1; i < G_N_ELEMENTS (fixed_symbols); i++)
+    add_symbol (g_intern_static_string (fixed_symbols[i]));
+}
+
+/**
+ * pos_symbol_from_string:
+ * @str: The symbol as string
+ *
+ * Gets the id of the given symbol, interning it if needed. This is
+ * cheapest for strings that are interned already like the ones of a
+ * layout's keys.
+ *
+ * Returns: The symbol
+ */
+PosSymbol
+pos_symbol_from_string (const char *str)
+{
+  const char *interned;
+  PosSymbol symbol;
+
+  g_return_val_if_fail (str, POS_SYMBOL_INVALID);
+
+  ensure_symbols ();
+
+  /* Only interned strings are used as keys so this can't mismatch */
+  symbol = GPOINTER_TO_UINT (g_hash_table_lookup (symbol_ids, str));
+  if (symbol)
+    return symbol;
+
+  interned = g_intern_string (str);
+  symbol = GPOINTER_TO_UINT (g_hash_table_lookup (symbol_ids, interned));
+  if (symbol)
+    return symbol;
+
+  return add_symbol (interned);
+}
+
+/**
+ * pos_symbol_lookup:
+ * @str: The symbol as string
+ *
+ * Gets the id of the given symbol without interning it. Use this for
+ * strings that might not come from a layout so they don't stay around
+ * for the lifetime of the process.
+ *
+ * Returns: The symbol or %POS_SYMBOL_INVALID if it isn't known
+ */
+PosSymbol
+pos_symbol_lookup (const char *str)
+{
+  PosSymbol symbol;
+  GQuark quark;
+
+  g_return_val_if_fail (str, POS_SYMBOL_INVALID);
+
+  ensure_symbols ();
+
+  symbol = GPOINTER_TO_UINT (g_hash_table_lookup (symbol_ids, str));
+  if (symbol)
+    return symbol;
+
+  /* Interned strings are quark strings so this finds them without adding one */
+  quark = g_quark_try_string (str);
+  if (quark == 0)
+    return POS_SYMBOL_INVALID;
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (symbol_ids, g_quark_to_string (quark)));
+}
+
+/**
+ * pos_symbol_from_unichar:
+ * @c: A unicode character
+ *
+ * Gets the id of the symbol for the given character.
+ *
+ * Returns: The symbol
+ */
+PosSymbol
+pos_symbol_from_unichar (gunichar c)
+{
+  char buf[7] = { 0 };
+
+  if (c < G_N_ELEMENTS (ascii_symbols) && ascii_symbols[c])
+    return ascii_symbols[c];
+
+  g_unichar_to_utf8 (c, buf);
+  if (c >= G_N_ELEMENTS (ascii_symbols))
+    return pos_symbol_from_string (buf);
+
+  ascii_symbols[c] = pos_symbol_from_string (buf);
+  return ascii_symbols[c];
+}
+
+/**
+ * pos_symbol_lookup_unichar:
+ * @c: A unicode character
+ *
+ * Gets the id of the symbol for the given character without interning
+ * it. See [func@Pos.symbol_lookup].
+ *
+ * Returns: The symbol or %POS_SYMBOL_INVALID if it isn't known
+ */
+PosSymbol
+pos_symbol_lookup_unichar (gunichar c)
+{
+  char buf[7] = { 0 };
+
+  if (c < G_N_ELEMENTS (ascii_symbols) && ascii_symbols[c])
+    return ascii_symbols[c];
+
+  g_unichar_to_utf8 (c, buf);
+  return pos_symbol_lookup (buf);
+}
+
+/**
+ * pos_symbol_get_unichar_flags:
+ * @c: A code point
+ *
+ * Gets whether the code point is a separator or whitespace without
+ * interning it. Use this for text that doesn't come from a layout
+ * like the surrounding text.
+ *
+ * Returns: The separator and whitespace flags of @c
+ */
+PosSymbolFlags
+pos_symbol_get_unichar_flags (gunichar c)
+{
+  switch (c) {
+  case ' ':
+  case '\t':
+  case '\n':
+    return POS_SYMBOL_FLAG_WHITESPACE | POS_SYMBOL_FLAG_SEPARATOR;
+  /* TODO: all the brackets, also language dependent */
+  case '.':
+  case ',':
+  case ';':
+  case ':':
+  case '?':
+  case '!':
+  case '(': case ')':
+  case '{': case '}':
+  case '[': case ']':
+    return POS_SYMBOL_FLAG_SEPARATOR;
+  default:
+    return POS_SYMBOL_FLAG_NONE;
+  }
+}
+
+/**
+ * pos_symbol_to_string:
+ * @symbol: The symbol
+ *
+ * Gets the symbol's string.
+ *
+ * Returns: The interned string of the symbol
+ */
+const char *
+pos_symbol_to_string (PosSymbol symbol)
+{
+  /* So the fixed ids can be used before any symbol got interned */
+  ensure_symbols ();
+
+  g_return_val_if_fail (symbols && symbol && symbol < symbols->len, NULL);
+
+  return g_array_index (symbols, PosSymbolInfo, symbol).str;
+}
+
+/**
+ * pos_symbol_get_flags:
+ * @symbol: The symbol
+ *
+ * Gets the symbol's flags.
+ *
+ * Returns: The flags
+ */
+PosSymbolFlags
+pos_symbol_get_flags (PosSymbol symbol)
+{
+  g_return_val_if_fail (symbols && symbol && symbol < symbols->len, POS_SYMBOL_FLAG_NONE);
+
+  return g_array_index (symbols, PosSymbolInfo, symbol).flags;
+}
+
+/**
+ * pos_symbol_get_codepoint:
+ * @symbol: The symbol
+ *
+ * Gets the first code point of a text symbol. Use
+ * %POS_SYMBOL_FLAG_CODEPOINT to check whether it's the only one.
+ *
+ * Returns: The code point or `0` for special keys
+ */
+gunichar
+pos_symbol_get_codepoint (PosSymbol symbol)
+{
+  g_return_val_if_fail (symbols && symbol && symbol < symbols->len, 0);
+
+  return g_array_index (symbols, PosSymbolInfo, symbol).codepoint;
+}
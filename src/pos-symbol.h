@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PosSymbol:
+ *
+ * An interned key symbol. Equal symbols have the same id so they can
+ * be compared as integers. `0` is never a valid symbol.
+ */
+typedef guint PosSymbol;
+
+/* Symbols with fixed ids */
+enum {
+  POS_SYMBOL_INVALID = 0,
+  POS_SYMBOL_SPACE,
+  POS_SYMBOL_KEY_BACKSPACE,
+  POS_SYMBOL_KEY_ENTER,
+  POS_SYMBOL_KEY_TAB,
+  POS_SYMBOL_KEY_LEFT,
+  POS_SYMBOL_KEY_RIGHT,
+  POS_SYMBOL_KEY_UP,
+  POS_SYMBOL_KEY_DOWN,
+};
+
+/**
+ * PosSymbolFlags:
+ * @POS_SYMBOL_FLAG_NONE: No flags
+ * @POS_SYMBOL_FLAG_SPECIAL: A special key like `KEY_ENTER` rather than text
+ * @POS_SYMBOL_FLAG_SEPARATOR: Text that ends a word
+ * @POS_SYMBOL_FLAG_WHITESPACE: Whitespace, always a separator too
+ * @POS_SYMBOL_FLAG_CODEPOINT: Text consisting of a single code point
+ *
+ * Properties of a symbol, computed once when it's interned.
+ */
+typedef enum {
+  POS_SYMBOL_FLAG_NONE       = 0,
+  POS_SYMBOL_FLAG_SPECIAL    = (1 << 0),
+  POS_SYMBOL_FLAG_SEPARATOR  = (1 << 1),
+  POS_SYMBOL_FLAG_WHITESPACE = (1 << 2),
+  POS_SYMBOL_FLAG_CODEPOINT  = (1 << 3),
+} PosSymbolFlags;
+
+PosSymbol      pos_symbol_from_string   (const char *str);
+PosSymbol      pos_symbol_from_unichar  (gunichar c);
+PosSymbol      pos_symbol_lookup        (const char *str);
+PosSymbol      pos_symbol_lookup_unichar (gunichar c);
+const char    *pos_symbol_to_string     (PosSymbol symbol);
+PosSymbolFlags pos_symbol_get_flags     (PosSymbol symbol);
+gunichar       pos_symbol_get_codepoint (PosSymbol symbol);
+PosSymbolFlags pos_symbol_get_unichar_flags (gunichar c);
+
+G_END_DECLS
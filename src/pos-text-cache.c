@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "pos-text-cache"
+
+#include "pos-config.h"
+
+#include "pos-text-cache.h"
+
+#include <gtk/gtk.h>
+#include <pango/pangocairo.h>
+
+/* Labels are few so this is only hit if something goes wrong */
+#define MAX_ENTRIES 1024
+
+/**
+ * PosTextCache:
+ *
+ * A process wide cache of shaped text. Key labels hardly ever change
+ * so shaping them once and reusing the resulting #PangoLayout takes
+ * text shaping out of the drawing path.
+ *
+ * Layouts are created from a context using the screen's font
+ * options and resolution. The cairo device scale handles HiDPI so the
+ * scale factor doesn't need to be part of the key. The cache is dropped
+ * whenever fonts or font rendering settings change.
+ */
+
+typedef struct {
+  char                 *text;
+  PangoFontDescription *font;
+  int                   width;
+} PosTextCacheKey;
+
+static GHashTable   *layouts;
+static PangoContext *context;
+
+
+static guint
+pos_text_cache_key_hash (gconstpointer data)
+{
+  const PosTextCacheKey *key = data;
+
+  return g_str_hash (key->text) ^ pango_font_description_hash (key->font) ^ (key->width * 31);
+}
+
+
+static gboolean
+pos_text_cache_key_equal (gconstpointer a, gconstpointer b)
+{
+  const PosTextCacheKey *key_a = a;
+  const PosTextCacheKey *key_b = b;
+
+  return key_a->width == key_b->width &&
+    g_str_equal (key_a->text, key_b->text) &&
+    pango_font_description_equal (key_a->font, key_b->font);
+}
+
+
+static void
+pos_text_cache_key_free (PosTextCacheKey *key)
+{
+  g_free (key->text);
+  pango_font_description_free (key->font);
+  g_free (key);
+}
+
+
+static void
+on_font_settings_changed (void)
+{
+  g_debug ("Font settings changed, dropping %u layouts",
+           layouts ? g_hash_table_size (layouts) : 0);
+  pos_text_cache_clear ();
+}
+
+
+static void
+pos_text_cache_init (void)
+{
+  GdkScreen *screen = gdk_screen_get_default ();
+  PangoFontMap *font_map = pango_cairo_font_map_get_default ();
+  static gboolean connected;
+
+  context = pango_font_map_create_context (font_map);
+  pango_cairo_context_set_font_options (context, gdk_screen_get_font_options (screen));
+  pango_cairo_context_set_resolution (context, gdk_screen_get_resolution (screen));
+
+  layouts = g_hash_table_new_full (pos_text_cache_key_hash,
+                                   pos_text_cache_key_equal,
+                                   (GDestroyNotify)pos_text_cache_key_free,
+                                   g_object_unref);
+
+  if (!connected) {
+    const char *props[] = {
+      "notify::gtk-font-name",
+      "notify::gtk-theme-name",
+      "notify::gtk-xft-antialias",
+      "notify::gtk-xft-dpi",
+      "notify::gtk-xft-hinting",
+      "notify::gtk-xft-hintstyle",
+      "notify::gtk-xft-rgba",
+    };
+    GtkSettings *settings = gtk_settings_get_default ();
+
+    for (int i = 0; i < G_N_ELEMENTS (props); i++)
+      g_signal_connect (settings, props[i], G_CALLBACK (on_font_settings_changed), NULL);
+    connected = TRUE;
+  }
+}
+
+/**
+ * pos_text_cache_get_layout:
+ * @text: The text to shape
+ * @font: The font to use
+ * @width: The layout width in pango units or `-1` to not wrap
+ *
+ * Get a centered layout for the given text. The layout is shaped when
+ * first used and shared by all users afterwards so it must not be modified.
+ *
+ * Returns:(transfer none): The layout
+ */
+PangoLayout *
+pos_text_cache_get_layout (const char *text, const PangoFontDescription *font, int width)
+{
+  PosTextCacheKey lookup = {
+    .text = (char *)text,
+    .font = (PangoFontDescription *)font,
+    .width = width,
+  };
+  PosTextCacheKey *key;
+  PangoLayout *layout;
+
+  g_return_val_if_fail (text, NULL);
+  g_return_val_if_fail (font, NULL);
+
+  if (layouts == NULL)
+    pos_text_cache_init ();
+
+  layout = g_hash_table_lookup (layouts, &lookup);
+  if (layout)
+    return layout;
+
+  if (g_hash_table_size (layouts) >= MAX_ENTRIES) {
+    g_debug ("Text cache full, dropping it");
+    g_hash_table_remove_all (layouts);
+  }
+
+  layout = pango_layout_new (context);
+  pango_layout_set_font_description (layout, font);
+  pango_layout_set_text (layout, text, -1);
+  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
+  pango_layout_set_width (layout, width);
+
+  key = g_new0 (PosTextCacheKey, 1);
+  key->text = g_strdup (text);
+  key->font = pango_font_description_copy (font);
+  key->width = width;
+  g_hash_table_insert (layouts, key, layout);
+
+  return layout;
+}
+
+/**
+ * pos_text_cache_clear:
+ *
+ * Drop all cached layouts. Layouts handed out before must not be used
+ * anymore.
+ */
+void
+pos_text_cache_clear (void)
+{
+  g_clear_pointer (&layouts, g_hash_table_destroy);
+  g_clear_object (&context);
+}
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <pango/pango.h>
+
+G_BEGIN_DECLS
+
+PangoLayout *pos_text_cache_get_layout (const char                 *text,
+                                        const PangoFontDescription *font,
+                                        int                         width);
+void         pos_text_cache_clear      (void);
+
+G_END_DECLS
@@ -8,13 +8,18 @@
 
 #define G_LOG_DOMAIN "pos-virtual-keyboard"
 
+#define _GNU_SOURCE
+
 #include "pos-config.h"
 #include "util.h"
 
+#include "pos-latency.h"
 #include "pos-virtual-keyboard.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 
 enum {
@@ -25,11 +30,20 @@ enum {
 };
 static GParamSpec *props[PROP_LAST_PROP];
 
+enum {
+  KEYMAP_SENT,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
 /**
  * PosVirtualKeyboard:
  *
  * A Wayland virtual keyboard that gets its keymaps from GNOME.
  * It's not concerned with any rendering.
+ *
+ * Without a virtual keyboard manager nothing is sent to the compositor.
+ * This is useful to e.g. inspect the generated keymaps in tests.
  */
 struct _PosVirtualKeyboard {
   GObject                                 parent;
@@ -39,9 +53,22 @@ struct _PosVirtualKeyboard {
   struct zwp_virtual_keyboard_v1         *virtual_keyboard;
 
   GTimer                                 *timer;
+  guint                                   last_time;
 };
 G_DEFINE_TYPE (PosVirtualKeyboard, pos_virtual_keyboard, G_TYPE_OBJECT)
 
+/**
+ * PosVirtualKeyboardKeymap:
+ *
+ * A keymap stored in a (when possible sealed) memory file so it can
+ * be sent to the compositor any number of times without building or
+ * copying it again.
+ */
+struct _PosVirtualKeyboardKeymap {
+  int   fd;
+  gsize size;
+};
+
 
 static void
 pos_virtual_keyboard_set_property (GObject      *object,
@@ -72,6 +99,9 @@ pos_virtual_keyboard_constructed (GObject *object)
 
   G_OBJECT_CLASS (pos_virtual_keyboard_parent_class)->constructed (object);
 
+  if (self->virtual_keyboard_manager == NULL)
+    return;
+
   self->virtual_keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard (
     self->virtual_keyboard_manager, self->wl_seat);
 }
@@ -111,6 +141,22 @@ pos_virtual_keyboard_class_init (PosVirtualKeyboardClass *klass)
                           G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY);
 
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
+
+  /**
+   * PosVirtualKeyboard::keymap-sent:
+   * @vk: The virtual keyboard
+   * @keymap: The keymap
+   *
+   * A keymap was made the current one.
+   */
+  signals[KEYMAP_SENT] =
+    g_signal_new ("keymap-sent",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE,
+                  1,
+                  G_TYPE_POINTER);
 }
 
 
@@ -135,6 +181,18 @@ pos_virtual_keyboard_new (struct zwp_virtual_keyboard_manager_v1 *virtual_keyboa
 
 
 
+/* Timestamps in ms, strictly increasing so events sent in a burst stay ordered */
+static guint
+pos_virtual_keyboard_get_time (PosVirtualKeyboard *self)
+{
+  guint millis = (guint)(g_timer_elapsed (self->timer, NULL) * 1000);
+
+  self->last_time = MAX (millis, self->last_time + 1);
+
+  return self->last_time;
+}
+
+
 void
 pos_virtual_keyboard_press (PosVirtualKeyboard *self, guint keycode)
 {
@@ -142,7 +200,12 @@ pos_virtual_keyboard_press (PosVirtualKeyboard *self, guint keycode)
 
   g_return_if_fail (POS_IS_VIRTUAL_KEYBOARD (self));
 
-  millis = (guint)g_timer_elapsed (self->timer, NULL) * 1000;
+  pos_latency_mark (POS_LATENCY_STAGE_COMMIT);
+
+  if (self->virtual_keyboard == NULL)
+    return;
+
+  millis = pos_virtual_keyboard_get_time (self);
   zwp_virtual_keyboard_v1_key (self->virtual_keyboard, millis, keycode,
                                WL_KEYBOARD_KEY_STATE_PRESSED);
 }
@@ -154,7 +217,11 @@ pos_virtual_keyboard_release (PosVirtualKeyboard *self, guint keycode)
   guint millis;
 
   g_return_if_fail (POS_IS_VIRTUAL_KEYBOARD (self));
-  millis = (guint)g_timer_elapsed (self->timer, NULL) * 1000;
+
+  if (self->virtual_keyboard == NULL)
+    return;
+
+  millis = pos_virtual_keyboard_get_time (self);
   zwp_virtual_keyboard_v1_key (self->virtual_keyboard, millis, keycode,
                                WL_KEYBOARD_KEY_STATE_RELEASED);
 }
@@ -168,34 +235,172 @@ pos_virtual_keyboard_set_modifiers (PosVirtualKeyboard             *self,
 {
   g_return_if_fail (POS_IS_VIRTUAL_KEYBOARD (self));
 
+  if (self->virtual_keyboard == NULL)
+    return;
+
   zwp_virtual_keyboard_v1_modifiers (self->virtual_keyboard,
                                      depressed, locked, latched, 0 /* TBD */);
 }
 
+/**
+ * pos_virtual_keyboard_flush:
+ * @self: The virtual keyboard
+ *
+ * Sends out all queued requests right away.
+ */
+void
+pos_virtual_keyboard_flush (PosVirtualKeyboard *self)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+
+  g_return_if_fail (POS_IS_VIRTUAL_KEYBOARD (self));
+
+  if (GDK_IS_WAYLAND_DISPLAY (display))
+    wl_display_flush (gdk_wayland_display_get_wl_display (display));
+}
+
+/**
+ * pos_virtual_keyboard_keymap_new:
+ * @keymap: The keymap's text
+ * @size: The keymap's size in bytes
+ *
+ * Stores the given keymap in a memory file. Further writes are sealed
+ * off so the file can safely be shared with the compositor repeatedly.
+ *
+ * Returns:(transfer full): The keymap or %NULL on error
+ */
+PosVirtualKeyboardKeymap *
+pos_virtual_keyboard_keymap_new (const char *keymap, gsize size)
+{
+  PosVirtualKeyboardKeymap *self;
+  gsize written = 0;
+  int fd;
+
+  g_return_val_if_fail (keymap, NULL);
+
+  fd = memfd_create ("pos-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    fd = phosh_create_shm_file (0);
+  if (fd < 0) {
+    g_warning ("Failed to create keymap file: %s", g_strerror (errno));
+    return NULL;
+  }
+
+  while (written < size) {
+    ssize_t ret = pwrite (fd, keymap + written, size - written, written);
+
+    if (ret < 0 && errno == EINTR)
+      continue;
+
+    if (ret <= 0) {
+      g_warning ("Failed to write keymap: %s", g_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+    written += ret;
+  }
+
+  /* Fails for shm files, that's fine */
+  fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+  self = g_new0 (PosVirtualKeyboardKeymap, 1);
+  self->fd = fd;
+  self->size = size;
+
+  return self;
+}
+
+
+void
+pos_virtual_keyboard_keymap_free (PosVirtualKeyboardKeymap *self)
+{
+  g_return_if_fail (self);
+
+  close (self->fd);
+  g_free (self);
+}
+
+/**
+ * pos_virtual_keyboard_keymap_dup_string:
+ * @self: The keymap
+ * @size:(out)(optional): The keymap's size in bytes
+ *
+ * Reads the keymap's text back from its memory file.
+ *
+ * Returns:(transfer full): The keymap's text or %NULL on error
+ */
+char *
+pos_virtual_keyboard_keymap_dup_string (PosVirtualKeyboardKeymap *self, gsize *size)
+{
+  g_autofree char *keymap = NULL;
+  gsize n_read = 0;
+
+  g_return_val_if_fail (self, NULL);
+
+  keymap = g_malloc (self->size + 1);
+  while (n_read < self->size) {
+    ssize_t ret = pread (self->fd, keymap + n_read, self->size - n_read, n_read);
+
+    if (ret < 0 && errno == EINTR)
+      continue;
+
+    if (ret <= 0) {
+      g_warning ("Failed to read keymap: %s", g_strerror (errno));
+      return NULL;
+    }
+    n_read += ret;
+  }
+  keymap[self->size] = '\0';
+
+  if (size)
+    *size = self->size;
+
+  return g_steal_pointer (&keymap);
+}
+
+/**
+ * pos_virtual_keyboard_send_keymap:
+ * @self: The virtual keyboard driver
+ * @keymap: The keymap to send
+ *
+ * Makes the given keymap the current one. The keymap can be sent again
+ * later on.
+ */
+void
+pos_virtual_keyboard_send_keymap (PosVirtualKeyboard *self, PosVirtualKeyboardKeymap *keymap)
+{
+  g_return_if_fail (POS_IS_VIRTUAL_KEYBOARD (self));
+  g_return_if_fail (keymap);
+
+  if (self->virtual_keyboard) {
+    zwp_virtual_keyboard_v1_keymap (self->virtual_keyboard,
+                                    WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1,
+                                    keymap->fd, keymap->size);
+  }
+  g_debug ("Loaded keymap of %zd bytes", keymap->size);
+
+  g_signal_emit (self, signals[KEYMAP_SENT], 0, keymap);
+}
+
 /**
  * pos_virtual_keyboard_set_keymap:
  * @self: The virtual keyboard driver
  * @keymap: The keymap to set
  *
- * Sets the given keymap.
+ * Sets the given keymap. Use [method@VirtualKeyboard.send_keymap] for
+ * keymaps that are used more than once.
  */
 void
 pos_virtual_keyboard_set_keymap (PosVirtualKeyboard *self, const char *keymap)
 {
-  int fd;
-  gpointer ptr;
-  gsize size;
+  g_autoptr (PosVirtualKeyboardKeymap) vk_keymap = NULL;
 
   g_return_if_fail (POS_IS_VIRTUAL_KEYBOARD (self));
   g_return_if_fail (keymap);
 
-  size = strlen (keymap);
-  fd = phosh_create_shm_file (size);
-  ptr = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  memmove (ptr, keymap, size);
-  zwp_virtual_keyboard_v1_keymap (self->virtual_keyboard,
-                                  WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1,
-                                  fd, size);
-  close (fd);
-  g_debug ("Loaded keymap of %zd bytes", size);
+  vk_keymap = pos_virtual_keyboard_keymap_new (keymap, strlen (keymap));
+  if (vk_keymap == NULL)
+    return;
+
+  pos_virtual_keyboard_send_keymap (self, vk_keymap);
 }
@@ -27,6 +27,15 @@ typedef enum {
   POS_VIRTUAL_KEYBOARD_MODIFIERS_ALTGR = (1 << 7),
 } PosVirtualKeyboardModifierFlags;
 
+typedef struct _PosVirtualKeyboardKeymap PosVirtualKeyboardKeymap;
+
+PosVirtualKeyboardKeymap *pos_virtual_keyboard_keymap_new (const char *keymap, gsize size);
+void                      pos_virtual_keyboard_keymap_free (PosVirtualKeyboardKeymap *self);
+char                     *pos_virtual_keyboard_keymap_dup_string (PosVirtualKeyboardKeymap *self,
+                                                                  gsize                    *size);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PosVirtualKeyboardKeymap, pos_virtual_keyboard_keymap_free);
+
 #define POS_TYPE_VIRTUAL_KEYBOARD (pos_virtual_keyboard_get_type ())
 
 G_DECLARE_FINAL_TYPE (PosVirtualKeyboard, pos_virtual_keyboard, POS, VIRTUAL_KEYBOARD, GObject)
@@ -41,5 +50,8 @@ void pos_virtual_keyboard_set_modifiers (PosVirtualKeyboard             *self,
                                          PosVirtualKeyboardModifierFlags latched,
                                          PosVirtualKeyboardModifierFlags locked);
 void pos_virtual_keyboard_set_keymap (PosVirtualKeyboard *self, const char *keymap);
+void pos_virtual_keyboard_flush (PosVirtualKeyboard *self);
+void pos_virtual_keyboard_send_keymap (PosVirtualKeyboard       *self,
+                                       PosVirtualKeyboardKeymap *keymap);
 
 G_END_DECLS
@@ -11,12 +11,19 @@
 
 #include "pos-config.h"
 
+#include "pos-keycodes.h"
+#include "pos-symbol.h"
 #include "pos-vk-driver.h"
 
 #include <xkbcommon/xkbcommon.h>
 
 #include <linux/input-event-codes.h>
 
+/* Spare keycodes in each layout's keymap for symbols the layout lacks */
+#define N_SYMBOL_SLOTS 16
+/* Keycodes are offset by 8 in xkb keymaps and can't exceed 255 */
+#define MAX_KEYCODE (255 - 8)
+
 enum {
   PROP_0,
   PROP_VIRTUAL_KEYBOARD,
@@ -35,209 +42,53 @@ static GParamSpec *props[PROP_LAST_PROP];
 struct _PosVkDriver {
   GObject             parent;
 
+  /* The current keymap's keycodes, %NULL for the terminal keymap */
   GHashTable         *keycodes;
-  GHashTable         *gdk_keycodes;
   PosVirtualKeyboard *virtual_keyboard;
 
   char               *layout_id;
+
+  /* PosVkDriverKeymap by layout id */
+  GHashTable         *keymaps;
+  /* The last overlay keymap, these are rarely reused so not cached */
+  PosVkDriverKeymap  *overlay_keymap;
+  /* The current keymap */
+  gpointer            keymap;
+  guint64             slot_clock;
 };
 G_DEFINE_TYPE (PosVkDriver, pos_vk_driver, G_TYPE_OBJECT)
 
+/**
+ * PosVkDriverSlot:
+ * @keycode: The reserved keycode
+ * @symbol: The symbol currently mapped to @keycode or `0`
+ * @last_use: When the slot was last used
+ *
+ * A keycode reserved for symbols not in the layout.
+ */
 typedef struct {
-  char *key;
-  guint keycode;
-  guint modifiers;
-} PosKeycode;
-
-static const PosKeycode keycodes_common[] = {
-  /* special keys */
-  { "KEY_LEFT", KEY_LEFT, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_RIGHT", KEY_RIGHT, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_UP", KEY_UP, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_DOWN", KEY_DOWN, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_ENTER", KEY_ENTER, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_TAB", KEY_TAB, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_BACKSPACE" ,KEY_BACKSPACE, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_ESC", KEY_ESC, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F1", KEY_F1, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F2", KEY_F2, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F3", KEY_F3, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F4", KEY_F4, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F5", KEY_F5, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F6", KEY_F6, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F7", KEY_F7, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F8", KEY_F8, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F9", KEY_F9, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F10", KEY_F10, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F11", KEY_F11, POS_KEYCODE_MODIFIER_NONE },
-  { "KEY_F12", KEY_F12, POS_KEYCODE_MODIFIER_NONE },
-  /* common keys */
-  { " ", KEY_SPACE, POS_KEYCODE_MODIFIER_NONE},
-  { "0", KEY_0, POS_KEYCODE_MODIFIER_NONE },
-  { "1", KEY_1, POS_KEYCODE_MODIFIER_NONE },
-  { "2", KEY_2, POS_KEYCODE_MODIFIER_NONE },
-  { "3", KEY_3, POS_KEYCODE_MODIFIER_NONE },
-  { "4", KEY_4, POS_KEYCODE_MODIFIER_NONE },
-  { "5", KEY_5, POS_KEYCODE_MODIFIER_NONE },
-  { "6", KEY_6, POS_KEYCODE_MODIFIER_NONE },
-  { "7", KEY_7, POS_KEYCODE_MODIFIER_NONE },
-  { "8", KEY_8, POS_KEYCODE_MODIFIER_NONE },
-  { "9", KEY_9, POS_KEYCODE_MODIFIER_NONE },
-};
-
-static const PosKeycode keycodes_terminal[] = {
-  { "!", KEY_1, POS_KEYCODE_MODIFIER_SHIFT },
-  { "#", KEY_3, POS_KEYCODE_MODIFIER_SHIFT },
-  { "$", KEY_4, POS_KEYCODE_MODIFIER_SHIFT },
-  { "%", KEY_5, POS_KEYCODE_MODIFIER_SHIFT },
-  { "&", KEY_7, POS_KEYCODE_MODIFIER_SHIFT },
-  { "(", KEY_9, POS_KEYCODE_MODIFIER_SHIFT },
-  { ")", KEY_0, POS_KEYCODE_MODIFIER_SHIFT },
-  { "*", KEY_8, POS_KEYCODE_MODIFIER_SHIFT },
-  { "+", KEY_EQUAL, POS_KEYCODE_MODIFIER_SHIFT },
-  { ",", KEY_COMMA, POS_KEYCODE_MODIFIER_NONE },
-  { "-", KEY_MINUS, POS_KEYCODE_MODIFIER_NONE },
-  { ".", KEY_DOT, POS_KEYCODE_MODIFIER_NONE },
-  { "/", KEY_SLASH, POS_KEYCODE_MODIFIER_NONE },
-  { ":", KEY_SEMICOLON, POS_KEYCODE_MODIFIER_SHIFT },
-  { ";", KEY_SEMICOLON, POS_KEYCODE_MODIFIER_NONE },
-  { "=", KEY_EQUAL, POS_KEYCODE_MODIFIER_NONE },
-  { "?", KEY_SLASH, POS_KEYCODE_MODIFIER_SHIFT },
-  { "@", KEY_2, POS_KEYCODE_MODIFIER_SHIFT },
-  { "A", KEY_A, POS_KEYCODE_MODIFIER_SHIFT },
-  { "B", KEY_B, POS_KEYCODE_MODIFIER_SHIFT },
-  { "C", KEY_C, POS_KEYCODE_MODIFIER_SHIFT },
-  { "D", KEY_D, POS_KEYCODE_MODIFIER_SHIFT },
-  { "E", KEY_E, POS_KEYCODE_MODIFIER_SHIFT },
-  { "F", KEY_F, POS_KEYCODE_MODIFIER_SHIFT },
-  { "G", KEY_G, POS_KEYCODE_MODIFIER_SHIFT },
-  { "H", KEY_H, POS_KEYCODE_MODIFIER_SHIFT },
-  { "I", KEY_I, POS_KEYCODE_MODIFIER_SHIFT },
-  { "J", KEY_J, POS_KEYCODE_MODIFIER_SHIFT },
-  { "K", KEY_K, POS_KEYCODE_MODIFIER_SHIFT },
-  { "L", KEY_L, POS_KEYCODE_MODIFIER_SHIFT },
-  { "M", KEY_M, POS_KEYCODE_MODIFIER_SHIFT },
-  { "N", KEY_N, POS_KEYCODE_MODIFIER_SHIFT },
-  { "O", KEY_O, POS_KEYCODE_MODIFIER_SHIFT },
-  { "P", KEY_P, POS_KEYCODE_MODIFIER_SHIFT },
-  { "Q", KEY_Q, POS_KEYCODE_MODIFIER_SHIFT },
-  { "R", KEY_R, POS_KEYCODE_MODIFIER_SHIFT },
-  { "S", KEY_S, POS_KEYCODE_MODIFIER_SHIFT },
-  { "T", KEY_T, POS_KEYCODE_MODIFIER_SHIFT },
-  { "U", KEY_U, POS_KEYCODE_MODIFIER_SHIFT },
-  { "V", KEY_V, POS_KEYCODE_MODIFIER_SHIFT },
-  { "W", KEY_W, POS_KEYCODE_MODIFIER_SHIFT },
-  { "X", KEY_X, POS_KEYCODE_MODIFIER_SHIFT },
-  { "Y", KEY_Y, POS_KEYCODE_MODIFIER_SHIFT },
-  { "Z", KEY_Z, POS_KEYCODE_MODIFIER_SHIFT },
-  { "[", KEY_LEFTBRACE, POS_KEYCODE_MODIFIER_NONE },
-  { "\"", KEY_APOSTROPHE, POS_KEYCODE_MODIFIER_SHIFT },
-  { "\'", KEY_GRAVE, POS_KEYCODE_MODIFIER_NONE },
-  { "\\", KEY_BACKSLASH, POS_KEYCODE_MODIFIER_NONE },
-  { "]", KEY_RIGHTBRACE, POS_KEYCODE_MODIFIER_NONE },
-  { "^", KEY_6, POS_KEYCODE_MODIFIER_SHIFT },
-  { "_", KEY_MINUS, POS_KEYCODE_MODIFIER_SHIFT },
-  { "a", KEY_A, POS_KEYCODE_MODIFIER_NONE },
-  { "b", KEY_B, POS_KEYCODE_MODIFIER_NONE },
-  { "c", KEY_C, POS_KEYCODE_MODIFIER_NONE },
-  { "d", KEY_D, POS_KEYCODE_MODIFIER_NONE },
-  { "e", KEY_E, POS_KEYCODE_MODIFIER_NONE },
-  { "f", KEY_F, POS_KEYCODE_MODIFIER_NONE },
-  { "g", KEY_G, POS_KEYCODE_MODIFIER_NONE },
-  { "h", KEY_H, POS_KEYCODE_MODIFIER_NONE },
-  { "i", KEY_I, POS_KEYCODE_MODIFIER_NONE },
-  { "j", KEY_J, POS_KEYCODE_MODIFIER_NONE },
-  { "k", KEY_K, POS_KEYCODE_MODIFIER_NONE },
-  { "l", KEY_L, POS_KEYCODE_MODIFIER_NONE },
-  { "m", KEY_M, POS_KEYCODE_MODIFIER_NONE },
-  { "n", KEY_N, POS_KEYCODE_MODIFIER_NONE },
-  { "o", KEY_O, POS_KEYCODE_MODIFIER_NONE },
-  { "p", KEY_P, POS_KEYCODE_MODIFIER_NONE },
-  { "q", KEY_Q, POS_KEYCODE_MODIFIER_NONE },
-  { "r", KEY_R, POS_KEYCODE_MODIFIER_NONE },
-  { "s", KEY_S, POS_KEYCODE_MODIFIER_NONE },
-  { "t", KEY_T, POS_KEYCODE_MODIFIER_NONE },
-  { "u", KEY_U, POS_KEYCODE_MODIFIER_NONE },
-  { "v", KEY_V, POS_KEYCODE_MODIFIER_NONE },
-  { "w", KEY_W, POS_KEYCODE_MODIFIER_NONE },
-  { "x", KEY_X, POS_KEYCODE_MODIFIER_NONE },
-  { "y", KEY_Y, POS_KEYCODE_MODIFIER_NONE },
-  { "z", KEY_Z, POS_KEYCODE_MODIFIER_NONE },
-  { "{", KEY_LEFTBRACE, POS_KEYCODE_MODIFIER_SHIFT },
-  { "|", KEY_BACKSLASH, POS_KEYCODE_MODIFIER_SHIFT },
-  { "}", KEY_RIGHTBRACE, POS_KEYCODE_MODIFIER_SHIFT },
-  { "~", KEY_GRAVE, POS_KEYCODE_MODIFIER_SHIFT },
-
-
-  { "℅", KEY_1, POS_KEYCODE_MODIFIER_ALTGR },
-  { "®", KEY_2, POS_KEYCODE_MODIFIER_ALTGR },
-  { "©", KEY_3, POS_KEYCODE_MODIFIER_ALTGR },
-  { "¢", KEY_4, POS_KEYCODE_MODIFIER_ALTGR },
-  { "€", KEY_5, POS_KEYCODE_MODIFIER_ALTGR },
-  { "¥", KEY_6, POS_KEYCODE_MODIFIER_ALTGR },
-  { "™", KEY_7, POS_KEYCODE_MODIFIER_ALTGR },
-
-  { NULL },
-};
+  guint     keycode;
+  PosSymbol symbol;
+  guint64   last_use;
+} PosVkDriverSlot;
 
+/**
+ * PosVkDriverKeymap:
+ * @keycodes: The keycodes (`PosKeycode`) by symbol id or %NULL to
+ *   use the compiled in tables of the terminal keymap
+ * @keymap: The keymap matching @keycodes
+ * @slots: Keycodes that can be remapped to additional symbols
+ * @n_slots: The number of slots
+ *
+ * A generated keymap so switching back to it needs neither rebuilding
+ * the keymap nor the keycodes.
+ */
 typedef struct {
-  guint gdk_keycode;
-  guint keycode;
-} PosGdkKeycode;
-
-static const PosGdkKeycode keycodes_gdk_us[] = {
-  { GDK_KEY_grave, KEY_GRAVE },
-  { GDK_KEY_0, KEY_0 },
-  { GDK_KEY_1, KEY_1 },
-  { GDK_KEY_2, KEY_2 },
-  { GDK_KEY_3, KEY_3 },
-  { GDK_KEY_4, KEY_4 },
-  { GDK_KEY_5, KEY_5 },
-  { GDK_KEY_6, KEY_6 },
-  { GDK_KEY_7, KEY_7 },
-  { GDK_KEY_8, KEY_8 },
-  { GDK_KEY_9, KEY_9 },
-  { GDK_KEY_minus, KEY_MINUS },
-  { GDK_KEY_equal, KEY_EQUAL },
-
-  { GDK_KEY_q, KEY_Q },
-  { GDK_KEY_w, KEY_W },
-  { GDK_KEY_e, KEY_E },
-  { GDK_KEY_r, KEY_R },
-  { GDK_KEY_t, KEY_T },
-  { GDK_KEY_y, KEY_Y },
-  { GDK_KEY_u, KEY_U },
-  { GDK_KEY_i, KEY_I },
-  { GDK_KEY_o, KEY_O },
-  { GDK_KEY_p, KEY_P },
-  { GDK_KEY_bracketleft, KEY_LEFTBRACE },
-  { GDK_KEY_bracketright, KEY_RIGHTBRACE },
-  { GDK_KEY_backslash, KEY_BACKSLASH },
-
-  { GDK_KEY_a, KEY_A },
-  { GDK_KEY_s, KEY_S },
-  { GDK_KEY_d, KEY_D },
-  { GDK_KEY_f, KEY_F },
-  { GDK_KEY_g, KEY_G },
-  { GDK_KEY_h, KEY_H },
-  { GDK_KEY_j, KEY_J },
-  { GDK_KEY_k, KEY_K },
-  { GDK_KEY_l, KEY_L },
-  { GDK_KEY_semicolon, KEY_SEMICOLON },
-  { GDK_KEY_apostrophe, KEY_APOSTROPHE },
-
-  { GDK_KEY_z, KEY_Z },
-  { GDK_KEY_x, KEY_X },
-  { GDK_KEY_c, KEY_C },
-  { GDK_KEY_v, KEY_V },
-  { GDK_KEY_b, KEY_B },
-  { GDK_KEY_n, KEY_N },
-  { GDK_KEY_m, KEY_M },
-  { GDK_KEY_comma, KEY_COMMA },
-  { GDK_KEY_period, KEY_DOT },
-  { GDK_KEY_slash, KEY_SLASH },
-  { GDK_KEY_space, KEY_SPACE },
-};
+  GHashTable               *keycodes;
+  PosVirtualKeyboardKeymap *keymap;
+  PosVkDriverSlot           slots[N_SYMBOL_SLOTS];
+  guint                     n_slots;
+} PosVkDriverKeymap;
 
 
 static gboolean
@@ -340,9 +191,21 @@ typedef struct _PosKeysym {
   char *keysym;
 } PosKeysym;
 
+/* Extra keysyms to add to each layout keymap */
+/* TODO: make dynamic */
+static const PosKeysym extra_keysyms[] = {
+  { "KEY_ENTER", "Return" },
+  { "KEY_BACKSPACE", "BackSpace" },
+  { "KEY_LEFT", "Left" },
+  { "KEY_RIGHT", "Right" },
+  { "KEY_UP", "Up" },
+  { "KEY_DOWN", "Down"},
+  { "KEY_TAB", "Tab"},
+  { NULL, NULL } };
+
 
 static const char *
-get_keysym (char *key, PosKeysym keysyms[])
+get_keysym (const char *key, const PosKeysym keysyms[])
 {
   if (keysyms == NULL)
     return NULL;
@@ -356,8 +219,60 @@ get_keysym (char *key, PosKeysym keysyms[])
 }
 
 
+static const PosKeycode *
+lookup_keycode (PosVkDriver *self, PosSymbol symbol)
+{
+  if (self->keycodes == NULL)
+    return pos_keycodes_lookup_symbol (pos_symbol_to_string (symbol));
+
+  return g_hash_table_lookup (self->keycodes, GUINT_TO_POINTER (symbol));
+}
+
+
+static const PosKeycode *
+lookup_keycode_by_name (PosVkDriver *self, const char *key)
+{
+  PosSymbol symbol;
+
+  if (self->keycodes == NULL)
+    return pos_keycodes_lookup_symbol (key);
+
+  /* Symbols that were never interned can't have a keycode */
+  symbol = pos_symbol_lookup (key);
+  if (symbol == POS_SYMBOL_INVALID)
+    return NULL;
+
+  return lookup_keycode (self, symbol);
+}
+
+
+/* The symbol typing @c uses or %POS_SYMBOL_INVALID if it isn't known yet */
+static PosSymbol
+lookup_char_symbol (gunichar c)
+{
+  if (c == '\n')
+    return POS_SYMBOL_KEY_ENTER;
+  if (c == '\t')
+    return POS_SYMBOL_KEY_TAB;
+
+  return pos_symbol_lookup_unichar (c);
+}
+
+
+static const PosKeycode *
+lookup_char_keycode (PosVkDriver *self, gunichar c)
+{
+  PosSymbol symbol = lookup_char_symbol (c);
+
+  if (symbol == POS_SYMBOL_INVALID)
+    return NULL;
+
+  return lookup_keycode (self, symbol);
+}
+
+
 static char *
-pos_vk_driver_build_keymap (PosVkDriver *self, PosKeysym extra_keysms[])
+pos_vk_driver_build_keymap (PosVkDriver *self, const PosKeysym extra_keysms[])
 {
   char *keymap_str;
   GHashTableIter iter;
@@ -368,7 +283,7 @@ pos_vk_driver_build_keymap (PosVkDriver *self, PosKeysym extra_keysms[])
 
   g_hash_table_iter_init (&iter, self->keycodes);
   while (g_hash_table_iter_next (&iter, &key, &value)) {
-    char *symbol = key;
+    PosSymbol symbol = GPOINTER_TO_UINT (key);
     PosKeycode *keycode = value;
     gunichar val;
 
@@ -383,23 +298,23 @@ pos_vk_driver_build_keymap (PosVkDriver *self, PosKeysym extra_keysms[])
      * For characters map each symbol as 'U<UCS4>' to the keycodes added above
      * See /usr/include/X11/keysymdef.h
      */
-    if (!g_str_has_prefix (symbol, "KEY_")) {
-      val = g_utf8_get_char (symbol);
+    if (!(pos_symbol_get_flags (symbol) & POS_SYMBOL_FLAG_SPECIAL)) {
+      val = pos_symbol_get_codepoint (symbol);
 
       if ((val >= 0x20 && val <= 0x7E) ||
           (val >= 0xa0 && val <= 0x10ffff)) {
         g_string_append_printf (symbols,
                                 "    key <I%.3d> { [ U%.4X ] };\n", keycode->keycode + 8, val);
       } else {
-        g_warning ("Can't convert '%s' to keysym", symbol);
+        g_warning ("Can't convert '%s' to keysym", pos_symbol_to_string (symbol));
       }
     } else {
       /* For non characters like cursor keys look up the keysym name */
       const char *keysym;
 
-      keysym = get_keysym (symbol, extra_keysms);
+      keysym = get_keysym (pos_symbol_to_string (symbol), extra_keysms);
       if (keysym == NULL) {
-        g_warning ("Key '%s' has no mapping", symbol);
+        g_warning ("Key '%s' has no mapping", pos_symbol_to_string (symbol));
         continue;
       }
       g_string_append_printf (symbols,
@@ -454,21 +369,39 @@ pos_vk_driver_build_keymap (PosVkDriver *self, PosKeysym extra_keysms[])
 
 
 static void
-pos_vk_driver_update_keycodes (PosVkDriver *self, const char *layout_id)
+pos_vk_driver_keymap_free (PosVkDriverKeymap *keymap)
 {
-  const PosKeycode *keycodes = keycodes_terminal;
+  g_clear_pointer (&keymap->keycodes, g_hash_table_unref);
+  g_clear_pointer (&keymap->keymap, pos_virtual_keyboard_keymap_free);
+  g_free (keymap);
+}
 
-  g_clear_pointer (&self->keycodes, g_hash_table_destroy);
 
-  self->keycodes = g_hash_table_new (g_str_hash, g_str_equal);
-  for (int i = 0; i < G_N_ELEMENTS (keycodes_common); i++)
-    g_hash_table_insert (self->keycodes, keycodes_common[i].key,  (gpointer)&keycodes_common[i]);
+/* Make the cached keymap the current one */
+static void
+pos_vk_driver_use_keymap (PosVkDriver *self, PosVkDriverKeymap *keymap)
+{
+  g_clear_pointer (&self->keycodes, g_hash_table_unref);
+  if (keymap->keycodes)
+    self->keycodes = g_hash_table_ref (keymap->keycodes);
+  self->keymap = keymap;
+
+  if (keymap->keymap)
+    pos_virtual_keyboard_send_keymap (self->virtual_keyboard, keymap->keymap);
+}
 
-  if (g_strcmp0 (layout_id, "terminal"))
-    g_warning ("Unknown layout id '%s', will use terminal layout", layout_id);
 
-  for (int i = 0; keycodes[i].key != NULL; i++)
-    g_hash_table_insert (self->keycodes, keycodes[i].key,  (gpointer)&keycodes[i]);
+/* Store the current keycodes with the given keymap */
+static PosVkDriverKeymap *
+pos_vk_driver_keymap_new (PosVkDriver *self, const char *keymap_str, gsize size)
+{
+  PosVkDriverKeymap *keymap = g_new0 (PosVkDriverKeymap, 1);
+
+  if (self->keycodes)
+    keymap->keycodes = g_hash_table_ref (self->keycodes);
+  keymap->keymap = pos_virtual_keyboard_keymap_new (keymap_str, size);
+
+  return keymap;
 }
 
 
@@ -496,7 +429,9 @@ pos_vk_driver_finalize (GObject *object)
 {
   PosVkDriver *self = POS_VK_DRIVER (object);
 
-  g_hash_table_destroy (self->keycodes);
+  g_clear_pointer (&self->keycodes, g_hash_table_unref);
+  g_clear_pointer (&self->keymaps, g_hash_table_destroy);
+  g_clear_pointer (&self->overlay_keymap, pos_vk_driver_keymap_free);
   g_clear_pointer (&self->layout_id, g_free);
   g_clear_object (&self->virtual_keyboard);
 
@@ -524,10 +459,8 @@ pos_vk_driver_class_init (PosVkDriverClass *klass)
 static void
 pos_vk_driver_init (PosVkDriver *self)
 {
-  self->gdk_keycodes = g_hash_table_new (g_direct_hash, g_direct_equal);
-  for (int i = 0; i < G_N_ELEMENTS (keycodes_gdk_us); i++)
-    g_hash_table_insert (self->gdk_keycodes, GUINT_TO_POINTER (keycodes_gdk_us[i].gdk_keycode),
-                         GUINT_TO_POINTER (keycodes_gdk_us[i].keycode));
+  self->keymaps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)pos_vk_driver_keymap_free);
 }
 
 
@@ -541,6 +474,24 @@ pos_vk_driver_new (PosVirtualKeyboard *virtual_keyboard)
                                       NULL));
 }
 
+
+static PosVirtualKeyboardModifierFlags
+to_vk_modifiers (PosKeycodeModifier modifiers)
+{
+  PosVirtualKeyboardModifierFlags vk_modifiers = POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE;
+
+  if (modifiers & POS_KEYCODE_MODIFIER_SHIFT)
+    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_SHIFT;
+  if (modifiers & POS_KEYCODE_MODIFIER_CTRL)
+    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_CTRL;
+  if (modifiers & POS_KEYCODE_MODIFIER_ALT)
+    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_ALT;
+  if (modifiers & POS_KEYCODE_MODIFIER_ALTGR)
+    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_ALTGR;
+
+  return vk_modifiers;
+}
+
 /**
  * pos_vk_driver_new_down:
  * @self: The virtual keyboard driver
@@ -556,27 +507,16 @@ pos_vk_driver_new (PosVirtualKeyboard *virtual_keyboard)
 void
 pos_vk_driver_key_down (PosVkDriver *self, const char *key, PosKeycodeModifier modifiers)
 {
-  PosKeycode *keycode;
-  guint vk_modifiers = 0;
+  const PosKeycode *keycode;
 
   g_return_if_fail (POS_IS_VK_DRIVER (self));
 
-  keycode = g_hash_table_lookup (self->keycodes, key);
+  keycode = lookup_keycode_by_name (self, key);
   g_return_if_fail (keycode);
 
-  modifiers |= keycode->modifiers;
-  if (modifiers & POS_KEYCODE_MODIFIER_SHIFT)
-    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_SHIFT;
-  if (modifiers & POS_KEYCODE_MODIFIER_CTRL)
-    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_CTRL;
-  if (modifiers & POS_KEYCODE_MODIFIER_ALT)
-    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_ALT;
-  if (modifiers & POS_KEYCODE_MODIFIER_ALTGR)
-    vk_modifiers |= POS_VIRTUAL_KEYBOARD_MODIFIERS_ALTGR;
-
   /* FIXME: preserve current modifiers */
   pos_virtual_keyboard_set_modifiers (self->virtual_keyboard,
-                                      vk_modifiers,
+                                      to_vk_modifiers (modifiers | keycode->modifiers),
                                       POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
                                       POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE);
 
@@ -586,11 +526,11 @@ pos_vk_driver_key_down (PosVkDriver *self, const char *key, PosKeycodeModifier m
 void
 pos_vk_driver_key_up (PosVkDriver *self, const char *key)
 {
-  PosKeycode *keycode;
+  const PosKeycode *keycode;
 
   g_return_if_fail (POS_IS_VK_DRIVER (self));
 
-  keycode = g_hash_table_lookup (self->keycodes, key);
+  keycode = lookup_keycode_by_name (self, key);
   g_return_if_fail (keycode);
 
   pos_virtual_keyboard_release (self->virtual_keyboard, keycode->keycode);
@@ -600,6 +540,185 @@ pos_vk_driver_key_up (PosVkDriver *self, const char *key)
                                       POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE);
 }
 
+/**
+ * pos_vk_driver_key_press_repeated:
+ * @self: The virtual keyboard driver
+ * @key: The key to press
+ * @count: How often to press the key
+ *
+ * Press and release a key without modifiers @count times in a row. This
+ * sets the modifiers only once so e.g. moving the cursor over a long
+ * distance doesn't need a modifier update for each step.
+ */
+void
+pos_vk_driver_key_press_repeated (PosVkDriver *self, const char *key, guint count)
+{
+  const PosKeycode *keycode;
+
+  g_return_if_fail (POS_IS_VK_DRIVER (self));
+
+  keycode = lookup_keycode_by_name (self, key);
+  g_return_if_fail (keycode);
+
+  if (count == 0)
+    return;
+
+  pos_virtual_keyboard_set_modifiers (self->virtual_keyboard,
+                                      POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                      POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                      POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE);
+  for (guint i = 0; i < count; i++) {
+    pos_virtual_keyboard_press (self->virtual_keyboard, keycode->keycode);
+    pos_virtual_keyboard_release (self->virtual_keyboard, keycode->keycode);
+  }
+}
+
+/* Type the given characters assuming the current keymap has all of them */
+static void
+pos_vk_driver_type_chars (PosVkDriver *self, const gunichar *chars, guint n_chars)
+{
+  PosKeycodeModifier modifiers = POS_KEYCODE_MODIFIER_NONE;
+
+  pos_virtual_keyboard_set_modifiers (self->virtual_keyboard,
+                                      POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                      POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                      POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE);
+
+  for (guint i = 0; i < n_chars; i++) {
+    const PosKeycode *keycode = lookup_char_keycode (self, chars[i]);
+
+    if (keycode == NULL) {
+      g_warning ("Can't type U+%.4X", chars[i]);
+      continue;
+    }
+
+    if (keycode->modifiers != modifiers) {
+      modifiers = keycode->modifiers;
+      pos_virtual_keyboard_set_modifiers (self->virtual_keyboard,
+                                          to_vk_modifiers (modifiers),
+                                          POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                          POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE);
+    }
+
+    pos_virtual_keyboard_press (self->virtual_keyboard, keycode->keycode);
+    pos_virtual_keyboard_release (self->virtual_keyboard, keycode->keycode);
+  }
+
+  if (modifiers != POS_KEYCODE_MODIFIER_NONE) {
+    pos_virtual_keyboard_set_modifiers (self->virtual_keyboard,
+                                        POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                        POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE,
+                                        POS_VIRTUAL_KEYBOARD_MODIFIERS_NONE);
+  }
+}
+
+
+/*
+ * Make sure the current keymap has the given distinct characters and
+ * type the text. Only characters that end up in the keymap get interned.
+ */
+static void
+pos_vk_driver_type_segment (PosVkDriver    *self,
+                            GHashTable     *distinct,
+                            const gunichar *chars,
+                            guint           n_chars)
+{
+  g_autofree const char **keys = NULL;
+  gboolean missing = FALSE;
+  GHashTableIter iter;
+  gpointer c;
+  guint n = 0;
+
+  g_hash_table_iter_init (&iter, distinct);
+  while (g_hash_table_iter_next (&iter, &c, NULL)) {
+    if (lookup_char_keycode (self, GPOINTER_TO_UINT (c)) == NULL) {
+      missing = TRUE;
+      break;
+    }
+  }
+
+  if (missing) {
+    keys = g_new0 (const char *, g_hash_table_size (distinct) + 1);
+    g_hash_table_iter_init (&iter, distinct);
+    while (g_hash_table_iter_next (&iter, &c, NULL)) {
+      PosSymbol symbol = lookup_char_symbol (GPOINTER_TO_UINT (c));
+
+      if (symbol == POS_SYMBOL_INVALID)
+        symbol = pos_symbol_from_unichar (GPOINTER_TO_UINT (c));
+      keys[n++] = pos_symbol_to_string (symbol);
+    }
+
+    if (!pos_vk_driver_ensure_symbols (self, keys))
+      pos_vk_driver_set_overlay_keymap (self, keys);
+  }
+
+  pos_vk_driver_type_chars (self, chars, n_chars);
+}
+
+/**
+ * pos_vk_driver_type_string:
+ * @self: The virtual keyboard driver
+ * @text: The text to type
+ *
+ * Types the given text via the virtual keyboard. The current keymap
+ * is used if possible. Otherwise the missing symbols are added to it,
+ * or an overlay keymap is installed for the whole text. Really long
+ * texts with many different characters get an overlay keymap per
+ * chunk. All key events are sent back to back and flushed at once.
+ *
+ * Returns: %TRUE if an overlay keymap was installed. Switch back to
+ *   the layout's keymap when done.
+ */
+gboolean
+pos_vk_driver_type_string (PosVkDriver *self, const char *text)
+{
+  g_autoptr (GArray) chars = g_array_new (FALSE, FALSE, sizeof (gunichar));
+  g_autoptr (GHashTable) distinct = g_hash_table_new (g_direct_hash, g_direct_equal);
+  guint max_symbols, start = 0;
+  gboolean overlay;
+
+  g_return_val_if_fail (POS_IS_VK_DRIVER (self), FALSE);
+  g_return_val_if_fail (text, FALSE);
+
+  for (const char *p = text; *p; p = g_utf8_next_char (p)) {
+    gunichar val = g_utf8_get_char (p);
+
+    /* Newlines and tabs are typed as KEY_ENTER and KEY_TAB */
+    if ((val < 0x20 && val != '\n' && val != '\t') || val == 0x7F)
+      continue;
+
+    g_array_append_val (chars, val);
+  }
+
+  if (chars->len == 0)
+    return FALSE;
+
+  /* Keep each chunk within what fits into a single keymap */
+  max_symbols = pos_vk_driver_get_max_symbols (self);
+  for (guint i = 0; i < chars->len; i++) {
+    gpointer c = GUINT_TO_POINTER (g_array_index (chars, gunichar, i));
+
+    if (g_hash_table_contains (distinct, c))
+      continue;
+
+    if (g_hash_table_size (distinct) == max_symbols) {
+      pos_vk_driver_type_segment (self, distinct,
+                                  &g_array_index (chars, gunichar, start), i - start);
+      g_hash_table_remove_all (distinct);
+      start = i;
+    }
+    g_hash_table_add (distinct, c);
+  }
+  pos_vk_driver_type_segment (self, distinct,
+                              &g_array_index (chars, gunichar, start), chars->len - start);
+
+  pos_virtual_keyboard_flush (self->virtual_keyboard);
+
+  overlay = (self->layout_id == NULL);
+  g_debug ("Typed %u characters%s", chars->len, overlay ? " via overlay keymap" : "");
+  return overlay;
+}
+
 /**
  * pos_vk_driver_key_press_gdk:
  * @self: The virtual keyboard driver
@@ -628,7 +747,7 @@ pos_vk_driver_key_press_gdk (PosVkDriver *self, guint gdk_keycode, GdkModifierTy
   if (modifiers & GDK_SUPER_MASK)
     flags |= POS_VIRTUAL_KEYBOARD_MODIFIERS_SUPER;
 
-  key = GPOINTER_TO_UINT (g_hash_table_lookup (self->gdk_keycodes, GUINT_TO_POINTER (gdk_keycode)));
+  key = pos_keycodes_lookup_keyval (gdk_keycode);
 
   if (!key) {
     GdkKeymap *gdk_keymap = gdk_keymap_get_for_display (gdk_display_get_default ());
@@ -668,8 +787,9 @@ void
 pos_vk_driver_set_terminal_keymap (PosVkDriver *self)
 {
   const char *layout_id = "terminal";
-  const char *keymap;
+  const char *keymap_str;
   g_autoptr (GBytes) data = NULL;
+  PosVkDriverKeymap *keymap;
   gsize size;
 
   g_return_if_fail (POS_IS_VK_DRIVER (self));
@@ -680,13 +800,20 @@ pos_vk_driver_set_terminal_keymap (PosVkDriver *self)
   g_debug ("Setting terminal keymap");
   g_clear_pointer (&self->layout_id, g_free);
   self->layout_id = g_strdup (layout_id);
-  data = g_resources_lookup_data ("/mobi/phosh/osk-stub/keymap.txt", 0, NULL);
-  g_assert (data);
-  keymap = (char*) g_bytes_get_data (data, &size);
 
-  pos_virtual_keyboard_set_keymap (self->virtual_keyboard, keymap);
+  keymap = g_hash_table_lookup (self->keymaps, layout_id);
+  if (keymap == NULL) {
+    data = g_resources_lookup_data ("/mobi/phosh/osk-stub/keymap.txt", 0, NULL);
+    g_assert (data);
+    keymap_str = (char*) g_bytes_get_data (data, &size);
 
-  pos_vk_driver_update_keycodes (self, layout_id);
+    /* Keycodes come from the compiled in tables */
+    g_clear_pointer (&self->keycodes, g_hash_table_unref);
+    keymap = pos_vk_driver_keymap_new (self, keymap_str, strnlen (keymap_str, size));
+    g_hash_table_insert (self->keymaps, g_strdup (layout_id), keymap);
+  }
+
+  pos_vk_driver_use_keymap (self, keymap);
 }
 
 /**
@@ -701,17 +828,10 @@ void
 pos_vk_driver_set_keymap_symbols (PosVkDriver *self, const char *layout_id, const char * const *symbols)
 {
   g_autofree char *keymap_str = NULL;
+  PosVkDriverKeymap *keymap;
   int keycode = KEY_1;
-  /* Extra keysyms to add to each keymap */
-  /* TODO: make dynamic */
-  PosKeysym extra_keysyms[] = {
-    { "KEY_ENTER", "Return" },
-    { "KEY_BACKSPACE", "BackSpace" },
-    { "KEY_LEFT", "Left" },
-    { "KEY_RIGHT", "Right" },
-    { "KEY_UP", "Up" },
-    { "KEY_DOWN", "Down"},
-    { NULL, NULL } };
+  guint n_slots = 0;
+  guint slots[N_SYMBOL_SLOTS];
 
   g_return_if_fail (POS_IS_VK_DRIVER (self));
   g_return_if_fail (layout_id);
@@ -721,8 +841,17 @@ pos_vk_driver_set_keymap_symbols (PosVkDriver *self, const char *layout_id, cons
     return;
 
   g_debug ("Switching to %s", layout_id);
-  g_clear_pointer (&self->keycodes, g_hash_table_destroy);
-  self->keycodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_clear_pointer (&self->layout_id, g_free);
+  self->layout_id = g_strdup (layout_id);
+
+  keymap = g_hash_table_lookup (self->keymaps, layout_id);
+  if (keymap) {
+    pos_vk_driver_use_keymap (self, keymap);
+    return;
+  }
+
+  g_clear_pointer (&self->keycodes, g_hash_table_unref);
+  self->keycodes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 
   for (int n = 0; symbols[n]; n++, keycode++) {
     PosKeycode *pos_keycode = g_new0 (PosKeycode, 1);
@@ -731,7 +860,8 @@ pos_vk_driver_set_keymap_symbols (PosVkDriver *self, const char *layout_id, cons
     keycode = get_next_valid_keycode (keycode);
 
     pos_keycode->keycode = keycode;
-    g_hash_table_insert (self->keycodes, g_strdup (symbol), pos_keycode);
+    g_hash_table_insert (self->keycodes, GUINT_TO_POINTER (pos_symbol_from_string (symbol)),
+                         pos_keycode);
   }
 
   for (int n = 0; extra_keysyms[n].key; n++, keycode++) {
@@ -740,14 +870,27 @@ pos_vk_driver_set_keymap_symbols (PosVkDriver *self, const char *layout_id, cons
     keycode = get_next_valid_keycode (keycode);
 
     pos_keycode->keycode = keycode;
-    g_hash_table_insert (self->keycodes, g_strdup (extra_keysyms[n].key), pos_keycode);
+    g_hash_table_insert (self->keycodes,
+                         GUINT_TO_POINTER (pos_symbol_from_string (extra_keysyms[n].key)),
+                         pos_keycode);
+  }
+
+  /* Reserve what's left for symbols not in the layout */
+  for (; n_slots < N_SYMBOL_SLOTS; n_slots++, keycode++) {
+    keycode = get_next_valid_keycode (keycode);
+    if (keycode > MAX_KEYCODE)
+      break;
+    slots[n_slots] = keycode;
   }
 
   keymap_str = pos_vk_driver_build_keymap (self, extra_keysyms);
-  pos_virtual_keyboard_set_keymap (self->virtual_keyboard, keymap_str);
+  keymap = pos_vk_driver_keymap_new (self, keymap_str, strlen (keymap_str));
+  for (int i = 0; i < n_slots; i++)
+    keymap->slots[i].keycode = slots[i];
+  keymap->n_slots = n_slots;
+  g_hash_table_insert (self->keymaps, g_strdup (layout_id), keymap);
 
-  g_clear_pointer (&self->layout_id, g_free);
-  self->layout_id = g_strdup (layout_id);
+  pos_vk_driver_use_keymap (self, keymap);
 }
 
 /**
@@ -760,18 +903,23 @@ pos_vk_driver_set_keymap_symbols (PosVkDriver *self, const char *layout_id, cons
  *
  * This is very similar to `pos_vk_driver_set_keymap_symbols` but does not require
  * a layout-id nor does it add any extra keys.
+ *
+ * Returns: %TRUE if the keymap got installed, %FALSE if it couldn't be
+ *   created. The current keymap stays in place in that case.
  */
-void
+gboolean
 pos_vk_driver_set_overlay_keymap (PosVkDriver *self, const char *const *symbols)
 {
+  g_autoptr (GHashTable) prev_keycodes = NULL;
   g_autofree char *keymap_str = NULL;
+  PosVkDriverKeymap *keymap;
   int keycode = KEY_1;
 
-  g_return_if_fail (POS_IS_VK_DRIVER (self));
-  g_return_if_fail (symbols);
+  g_return_val_if_fail (POS_IS_VK_DRIVER (self), FALSE);
+  g_return_val_if_fail (symbols, FALSE);
 
-  g_clear_pointer (&self->keycodes, g_hash_table_destroy);
-  self->keycodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  prev_keycodes = g_steal_pointer (&self->keycodes);
+  self->keycodes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 
   for (int n = 0; symbols[n]; n++, keycode++) {
     PosKeycode *pos_keycode = g_new0 (PosKeycode, 1);
@@ -780,12 +928,162 @@ pos_vk_driver_set_overlay_keymap (PosVkDriver *self, const char *const *symbols)
     keycode = get_next_valid_keycode (keycode);
 
     pos_keycode->keycode = keycode;
-    g_hash_table_insert (self->keycodes, g_strdup (symbol), pos_keycode);
+    g_hash_table_insert (self->keycodes, GUINT_TO_POINTER (pos_symbol_from_string (symbol)),
+                         pos_keycode);
+  }
+  keymap_str = pos_vk_driver_build_keymap (self, extra_keysyms);
+  keymap = pos_vk_driver_keymap_new (self, keymap_str, strlen (keymap_str));
+  if (keymap->keymap == NULL) {
+    g_warning ("Failed to create overlay keymap");
+    pos_vk_driver_keymap_free (keymap);
+    g_clear_pointer (&self->keycodes, g_hash_table_unref);
+    self->keycodes = g_steal_pointer (&prev_keycodes);
+    return FALSE;
   }
-  keymap_str = pos_vk_driver_build_keymap (self, NULL);
 
   g_clear_pointer (&self->layout_id, g_free);
-  pos_virtual_keyboard_set_keymap (self->virtual_keyboard, keymap_str);
+  pos_vk_driver_use_keymap (self, keymap);
+  /* The previous overlay keymap isn't in use anymore */
+  g_clear_pointer (&self->overlay_keymap, pos_vk_driver_keymap_free);
+  self->overlay_keymap = keymap;
+
+  return TRUE;
+}
+
+
+/**
+ * pos_vk_driver_get_max_symbols:
+ * @self: The virtual keyboard driver
+ *
+ * Gets the number of symbols a keymap set via
+ * [method@VkDriver.set_keymap_symbols] can hold. Keymaps covering
+ * several layouts need to fit in here.
+ *
+ * Returns: The maximum number of symbols
+ */
+guint
+pos_vk_driver_get_max_symbols (PosVkDriver *self)
+{
+  guint n_keycodes = 0;
+
+  g_return_val_if_fail (POS_IS_VK_DRIVER (self), 0);
+
+  for (int keycode = get_next_valid_keycode (KEY_1);
+       keycode <= MAX_KEYCODE;
+       keycode = get_next_valid_keycode (keycode + 1)) {
+    n_keycodes++;
+  }
+
+  return n_keycodes - (G_N_ELEMENTS (extra_keysyms) - 1);
+}
+
+
+static PosVkDriverSlot *
+pos_vk_driver_keymap_find_slot (PosVkDriverKeymap *keymap, PosSymbol symbol)
+{
+  for (int i = 0; i < keymap->n_slots; i++) {
+    if (keymap->slots[i].symbol == symbol)
+      return &keymap->slots[i];
+  }
+
+  return NULL;
+}
+
+
+static PosVkDriverSlot *
+pos_vk_driver_keymap_find_lru_slot (PosVkDriverKeymap *keymap)
+{
+  PosVkDriverSlot *lru = &keymap->slots[0];
+
+  for (int i = 1; i < keymap->n_slots; i++) {
+    if (keymap->slots[i].last_use < lru->last_use)
+      lru = &keymap->slots[i];
+  }
+
+  return lru;
+}
+
+/**
+ * pos_vk_driver_ensure_symbols:
+ * @self: The virtual keyboard driver
+ * @symbols: The symbols that should be typeable
+ *
+ * Makes sure the given symbols can be sent via the current layout's
+ * keymap. Symbols the layout lacks are mapped to reserved keycodes,
+ * replacing the least recently used ones. The keymap is only updated
+ * (once) when a symbol wasn't mapped already.
+ *
+ * Returns: %TRUE if all symbols can be sent, %FALSE if there aren't
+ *   enough reserved keycodes. Use an overlay keymap in that case.
+ */
+gboolean
+pos_vk_driver_ensure_symbols (PosVkDriver *self, const char *const *symbols)
+{
+  PosVkDriverKeymap *keymap = self->keymap;
+  g_autoptr (GPtrArray) missing = g_ptr_array_new ();
+  g_autofree char *keymap_str = NULL;
+  guint n_hits = 0;
+
+  g_return_val_if_fail (POS_IS_VK_DRIVER (self), FALSE);
+  g_return_val_if_fail (symbols, FALSE);
+
+  if (keymap == NULL)
+    return FALSE;
+
+  for (int i = 0; symbols[i]; i++) {
+    PosSymbol symbol = pos_symbol_from_string (symbols[i]);
+
+    if (pos_vk_driver_keymap_find_slot (keymap, symbol)) {
+      n_hits++;
+      continue;
+    }
+
+    if (lookup_keycode (self, symbol))
+      continue;
+
+    if (pos_symbol_get_flags (symbol) & POS_SYMBOL_FLAG_SPECIAL)
+      return FALSE;
+
+    if (!g_ptr_array_find (missing, GUINT_TO_POINTER (symbol), NULL))
+      g_ptr_array_add (missing, GUINT_TO_POINTER (symbol));
+  }
+
+  if (missing->len + n_hits > keymap->n_slots)
+    return FALSE;
+
+  /* Mark hits as used so they don't get evicted below */
+  for (int i = 0; symbols[i]; i++) {
+    PosVkDriverSlot *slot = pos_vk_driver_keymap_find_slot (keymap,
+                                                            pos_symbol_from_string (symbols[i]));
+
+    if (slot)
+      slot->last_use = ++self->slot_clock;
+  }
+
+  if (missing->len == 0)
+    return TRUE;
+
+  for (int i = 0; i < missing->len; i++) {
+    PosVkDriverSlot *slot = pos_vk_driver_keymap_find_lru_slot (keymap);
+    PosKeycode *pos_keycode = g_new0 (PosKeycode, 1);
+
+    if (slot->symbol)
+      g_hash_table_remove (keymap->keycodes, GUINT_TO_POINTER (slot->symbol));
+
+    slot->symbol = GPOINTER_TO_UINT (g_ptr_array_index (missing, i));
+    slot->last_use = ++self->slot_clock;
+    pos_keycode->keycode = slot->keycode;
+    g_hash_table_insert (keymap->keycodes, GUINT_TO_POINTER (slot->symbol), pos_keycode);
+  }
+
+  g_debug ("Mapped %u additional symbols", missing->len);
+  keymap_str = pos_vk_driver_build_keymap (self, extra_keysyms);
+  g_clear_pointer (&keymap->keymap, pos_virtual_keyboard_keymap_free);
+  keymap->keymap = pos_virtual_keyboard_keymap_new (keymap_str, strlen (keymap_str));
+  if (keymap->keymap)
+    pos_virtual_keyboard_send_keymap (self->virtual_keyboard, keymap->keymap);
+
+  return TRUE;
 }
 
 
@@ -29,6 +29,9 @@ void         pos_vk_driver_key_down (PosVkDriver        *virtual_keyboard,
                                      const char         *key,
                                      PosKeycodeModifier  modifier);
 void        pos_vk_driver_key_up (PosVkDriver *virtual_keyboard, const char *key);
+void        pos_vk_driver_key_press_repeated (PosVkDriver *self,
+                                              const char  *key,
+                                              guint        count);
 void        pos_vk_driver_key_press_gdk (PosVkDriver    *self,
                                          guint           gdk_keycode,
                                          GdkModifierType modifiers);
@@ -36,7 +39,10 @@ void        pos_vk_driver_set_terminal_keymap (PosVkDriver       *self);
 void        pos_vk_driver_set_keymap_symbols (PosVkDriver        *self,
                                               const char         *layout_id,
                                               const char * const *symbols);
-void        pos_vk_driver_set_overlay_keymap (PosVkDriver *self, const char * const *symbols);
+gboolean    pos_vk_driver_set_overlay_keymap (PosVkDriver *self, const char * const *symbols);
+gboolean    pos_vk_driver_ensure_symbols (PosVkDriver *self, const char * const *symbols);
+guint       pos_vk_driver_get_max_symbols (PosVkDriver *self);
+gboolean    pos_vk_driver_type_string (PosVkDriver *self, const char *text);
 PosKeycodeModifier
             pos_vk_driver_convert_modifiers (PosVkDriver *self, GdkModifierType modifier);
 
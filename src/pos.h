@@ -18,6 +18,7 @@ G_BEGIN_DECLS
 #include "pos-osk-dbus.h"
 #include "pos-input-method.h"
 #include "pos-input-surface.h"
+#include "pos-latency.h"
 #include "pos-vk-driver.h"
 #include "pos-virtual-keyboard.h"
 
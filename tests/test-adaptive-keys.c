@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-main.h"
+#include "pos-osk-widget.h"
+
+#include <glib.h>
+
+#define WIDTH  360
+#define HEIGHT 250
+
+typedef struct {
+  GtkWidget    *window;
+  PosOskWidget *osk_widget;
+  /* A point on the border between `e` and `r`, still on `e` */
+  double        border_x, border_y;
+  /* The center of `e` */
+  double        center_x, center_y;
+} Fixture;
+
+
+static GHashTable *
+make_next_chars (const char *c1, double p1, const char *c2, double p2)
+{
+  GHashTable *next_chars = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  double *prob;
+
+  prob = g_new (double, 1);
+  *prob = p1;
+  g_hash_table_insert (next_chars, g_strdup (c1), prob);
+
+  if (c2) {
+    prob = g_new (double, 1);
+    *prob = p2;
+    g_hash_table_insert (next_chars, g_strdup (c2), prob);
+  }
+
+  return next_chars;
+}
+
+
+static void
+fixture_setup (Fixture *fixture, gconstpointer data)
+{
+  PhoshOskFeatures features = GPOINTER_TO_UINT (data);
+  g_autoptr (GError) err = NULL;
+  int min_x = WIDTH, max_x = -1, min_y = HEIGHT, max_y = -1;
+  gboolean success;
+
+  pos_init ();
+
+  fixture->window = gtk_offscreen_window_new ();
+  fixture->osk_widget = pos_osk_widget_new (features);
+  success = pos_osk_widget_set_layout (fixture->osk_widget, "xkb:us", "us", "English (US)",
+                                       "us", NULL, &err);
+  g_assert_no_error (err);
+  g_assert_true (success);
+
+  gtk_widget_set_size_request (GTK_WIDGET (fixture->osk_widget), WIDTH, HEIGHT);
+  gtk_container_add (GTK_CONTAINER (fixture->window), GTK_WIDGET (fixture->osk_widget));
+  gtk_widget_show_all (fixture->window);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  /* Find the `e` key */
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < WIDTH; x++) {
+      if (g_strcmp0 (pos_osk_widget_get_symbol_at (fixture->osk_widget, x, y), "e"))
+        continue;
+
+      min_x = MIN (min_x, x);
+      max_x = MAX (max_x, x);
+      min_y = MIN (min_y, y);
+      max_y = MAX (max_y, y);
+    }
+  }
+  g_assert_cmpint (max_x, >, min_x);
+  g_assert_cmpint (max_y, >, min_y);
+
+  fixture->center_x = 0.5 * (min_x + max_x);
+  fixture->center_y = 0.5 * (min_y + max_y);
+  fixture->border_x = max_x;
+  fixture->border_y = fixture->center_y;
+
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (fixture->osk_widget,
+                                                 fixture->border_x + 1,
+                                                 fixture->border_y), ==, "r");
+}
+
+
+static void
+fixture_teardown (Fixture *fixture, gconstpointer unused)
+{
+  gtk_widget_destroy (fixture->window);
+}
+
+
+static void
+test_adaptive_keys_border (Fixture *fixture, gconstpointer unused)
+{
+  g_autoptr (GHashTable) next_chars = NULL;
+  PosOskWidget *osk_widget = fixture->osk_widget;
+
+  /* Without probabilities the geometric key is hit */
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "e");
+
+  /* Touches close to the border go to the more likely key */
+  next_chars = make_next_chars ("r", 1.0, NULL, 0.0);
+  pos_osk_widget_set_next_chars (osk_widget, next_chars);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "r");
+  g_clear_pointer (&next_chars, g_hash_table_unref);
+
+  next_chars = make_next_chars ("e", 1.0, NULL, 0.0);
+  pos_osk_widget_set_next_chars (osk_widget, next_chars);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "e");
+
+  /* Clearing the probabilities restores plain hit testing */
+  pos_osk_widget_set_next_chars (osk_widget, NULL);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "e");
+}
+
+
+static void
+test_adaptive_keys_center (Fixture *fixture, gconstpointer unused)
+{
+  g_autoptr (GHashTable) next_chars = NULL;
+  PosOskWidget *osk_widget = fixture->osk_widget;
+
+  /* Equally likely keys don't steal touches from the key's center */
+  next_chars = make_next_chars ("e", 0.5, "r", 0.5);
+  pos_osk_widget_set_next_chars (osk_widget, next_chars);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->center_x, fixture->center_y),
+                   ==, "e");
+}
+
+
+static void
+test_adaptive_keys_disabled (Fixture *fixture, gconstpointer unused)
+{
+  g_autoptr (GHashTable) next_chars = NULL;
+  PosOskWidget *osk_widget = fixture->osk_widget;
+
+  /* Probabilities are ignored without the feature */
+  next_chars = make_next_chars ("r", 1.0, NULL, 0.0);
+  pos_osk_widget_set_next_chars (osk_widget, next_chars);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "e");
+
+  pos_osk_widget_set_features (osk_widget, PHOSH_OSK_FEATURE_ADAPTIVE_KEYS);
+  pos_osk_widget_set_next_chars (osk_widget, next_chars);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "r");
+
+  /* Disabling the feature drops the probabilities */
+  pos_osk_widget_set_features (osk_widget, PHOSH_OSK_FEATURE_DEFAULT);
+  g_assert_cmpstr (pos_osk_widget_get_symbol_at (osk_widget, fixture->border_x, fixture->border_y),
+                   ==, "e");
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/pos/osk-widget/adaptive_keys/border", Fixture,
+              GUINT_TO_POINTER (PHOSH_OSK_FEATURE_ADAPTIVE_KEYS),
+              fixture_setup, test_adaptive_keys_border, fixture_teardown);
+  g_test_add ("/pos/osk-widget/adaptive_keys/center", Fixture,
+              GUINT_TO_POINTER (PHOSH_OSK_FEATURE_ADAPTIVE_KEYS),
+              fixture_setup, test_adaptive_keys_center, fixture_teardown);
+  g_test_add ("/pos/osk-widget/adaptive_keys/disabled", Fixture,
+              GUINT_TO_POINTER (PHOSH_OSK_FEATURE_DEFAULT),
+              fixture_setup, test_adaptive_keys_disabled, fixture_teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-keycodes.h"
+
+#include <gdk/gdk.h>
+#include <linux/input-event-codes.h>
+
+static void
+test_keycodes_symbols (void)
+{
+  const PosKeycode *keycode;
+
+  for (guint i = 0; i < pos_keycodes_symbols_n; i++) {
+    keycode = pos_keycodes_lookup_symbol (pos_keycodes_symbols[i].key);
+    g_assert_true (keycode == &pos_keycodes_symbols[i]);
+  }
+
+  keycode = pos_keycodes_lookup_symbol ("a");
+  g_assert_cmpuint (keycode->keycode, ==, KEY_A);
+  g_assert_cmpuint (keycode->modifiers, ==, POS_KEYCODE_MODIFIER_NONE);
+
+  keycode = pos_keycodes_lookup_symbol ("A");
+  g_assert_cmpuint (keycode->keycode, ==, KEY_A);
+  g_assert_cmpuint (keycode->modifiers, ==, POS_KEYCODE_MODIFIER_SHIFT);
+
+  /* Shifted keys of the main block win over the keypad */
+  keycode = pos_keycodes_lookup_symbol ("(");
+  g_assert_cmpuint (keycode->keycode, ==, KEY_9);
+  g_assert_cmpuint (keycode->modifiers, ==, POS_KEYCODE_MODIFIER_SHIFT);
+
+  keycode = pos_keycodes_lookup_symbol ("'");
+  g_assert_cmpuint (keycode->keycode, ==, KEY_APOSTROPHE);
+
+  keycode = pos_keycodes_lookup_symbol ("€");
+  g_assert_cmpuint (keycode->keycode, ==, KEY_5);
+  g_assert_cmpuint (keycode->modifiers, ==, POS_KEYCODE_MODIFIER_ALTGR);
+
+  keycode = pos_keycodes_lookup_symbol ("KEY_F12");
+  g_assert_cmpuint (keycode->keycode, ==, KEY_F12);
+
+  g_assert_null (pos_keycodes_lookup_symbol ("ä"));
+  g_assert_null (pos_keycodes_lookup_symbol (""));
+}
+
+
+static void
+test_keycodes_keyvals (void)
+{
+  for (guint i = 0; i < pos_keycodes_keyvals_n; i++) {
+    g_assert_cmpuint (pos_keycodes_lookup_keyval (pos_keycodes_keyvals[i].keyval), ==,
+                      pos_keycodes_keyvals[i].keycode);
+  }
+
+  g_assert_cmpuint (pos_keycodes_lookup_keyval (GDK_KEY_grave), ==, KEY_GRAVE);
+  g_assert_cmpuint (pos_keycodes_lookup_keyval (GDK_KEY_period), ==, KEY_DOT);
+  g_assert_cmpuint (pos_keycodes_lookup_keyval (GDK_KEY_BackSpace), ==, KEY_BACKSPACE);
+  g_assert_cmpuint (pos_keycodes_lookup_keyval (GDK_KEY_adiaeresis), ==, 0);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/keycodes/symbols", test_keycodes_symbols);
+  g_test_add_func ("/pos/keycodes/keyvals", test_keycodes_keyvals);
+
+  return g_test_run ();
+}
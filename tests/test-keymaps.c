@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Generates the keymap of each layout and compiles it like the
+ * compositor and clients would. Run with `--verbose` to see timings
+ * and sizes.
+ */
+
+#include "pos-layout-data.h"
+#include "pos-main.h"
+#include "pos-osk-layout.h"
+#include "pos-virtual-keyboard.h"
+#include "pos-vk-driver.h"
+
+#include <xkbcommon/xkbcommon.h>
+
+#include <glib.h>
+#include <string.h>
+
+/* Keymaps get compiled by the compositor and every focused client */
+#define MAX_KEYMAP_SIZE (32 * 1024)
+
+
+static void
+on_keymap_sent (PosVirtualKeyboard *vk, PosVirtualKeyboardKeymap *keymap, char **keymap_str)
+{
+  g_free (*keymap_str);
+  *keymap_str = pos_virtual_keyboard_keymap_dup_string (keymap, NULL);
+}
+
+
+static void
+count_key (struct xkb_keymap *keymap, xkb_keycode_t key, gpointer data)
+{
+  guint *n_keys = data;
+
+  if (xkb_keymap_num_levels_for_key (keymap, key, 0))
+    (*n_keys)++;
+}
+
+
+static void
+test_keymaps_compile (void)
+{
+  g_autoptr (PosVirtualKeyboard) vk = NULL;
+  g_autoptr (PosVkDriver) driver = NULL;
+  g_autofree char *keymap_str = NULL;
+  struct xkb_context *context;
+  gint64 gen_total = 0, compile_total = 0;
+
+  pos_init ();
+
+  context = xkb_context_new (XKB_CONTEXT_NO_DEFAULT_INCLUDES | XKB_CONTEXT_NO_ENVIRONMENT_NAMES);
+  g_assert_nonnull (context);
+
+  /* Nothing gets sent to the compositor without a manager */
+  vk = pos_virtual_keyboard_new (NULL, NULL);
+  g_signal_connect (vk, "keymap-sent", G_CALLBACK (on_keymap_sent), &keymap_str);
+  driver = pos_vk_driver_new (vk);
+
+  g_assert_cmpint (pos_layout_data_get_n_layouts (), >, 0);
+  for (int i = 0; i < pos_layout_data_get_n_layouts (); i++) {
+    g_autoptr (GError) err = NULL;
+    g_autoptr (PosOskLayout) layout = NULL;
+    const char *layout_id = pos_layout_data_get_nth (i)->id;
+    struct xkb_keymap *keymap;
+    gint64 start, generated, compiled;
+    guint n_keys = 0;
+    gsize size;
+
+    layout = pos_osk_layout_get (layout_id, &err);
+    g_assert_no_error (err);
+    g_clear_pointer (&keymap_str, g_free);
+
+    start = g_get_monotonic_time ();
+    pos_vk_driver_set_keymap_symbols (driver, layout_id, pos_osk_layout_get_symbols (layout));
+    generated = g_get_monotonic_time ();
+    g_assert_nonnull (keymap_str);
+    keymap = xkb_keymap_new_from_string (context, keymap_str, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                         XKB_KEYMAP_COMPILE_NO_FLAGS);
+    compiled = g_get_monotonic_time ();
+    g_assert_nonnull (keymap);
+
+    xkb_keymap_key_for_each (keymap, count_key, &n_keys);
+    size = strlen (keymap_str);
+    g_test_message ("%-12s generate: %5" G_GINT64_FORMAT " µs, compile: %6" G_GINT64_FORMAT
+                    " µs, size: %6" G_GSIZE_FORMAT " bytes, keys: %u",
+                    layout_id, generated - start, compiled - generated, size, n_keys);
+    g_assert_cmpuint (n_keys, >, 0);
+    g_assert_cmpuint (size, <, MAX_KEYMAP_SIZE);
+
+    gen_total += generated - start;
+    compile_total += compiled - generated;
+    xkb_keymap_unref (keymap);
+  }
+
+  g_test_message ("Total generate: %" G_GINT64_FORMAT " µs, compile: %" G_GINT64_FORMAT " µs",
+                  gen_total, compile_total);
+
+  xkb_context_unref (context);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/keymaps/compile", test_keymaps_compile);
+
+  return g_test_run ();
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-latency.h"
+
+#include <glib.h>
+
+#include <stdio.h>
+
+static guint
+get_count (const char *dump, const char *stage)
+{
+  g_auto (GStrv) lines = g_strsplit (dump, "\n", -1);
+
+  for (int i = 0; lines[i]; i++) {
+    char name[16];
+    guint count;
+
+    if (sscanf (lines[i], "%15s %u", name, &count) == 2 && g_str_equal (name, stage))
+      return count;
+  }
+
+  g_assert_not_reached ();
+}
+
+
+static void
+test_latency_stages (void)
+{
+  g_autofree char *dump = NULL;
+
+  /* Nothing recorded without a key press */
+  pos_latency_set_enabled (TRUE);
+  pos_latency_mark (POS_LATENCY_STAGE_SYMBOL);
+
+  pos_latency_mark (POS_LATENCY_STAGE_PRESS);
+  pos_latency_mark (POS_LATENCY_STAGE_RELEASE);
+  pos_latency_mark (POS_LATENCY_STAGE_SYMBOL);
+  /* Only the first occurrence counts */
+  pos_latency_mark (POS_LATENCY_STAGE_SYMBOL);
+  pos_latency_mark (POS_LATENCY_STAGE_COMMIT);
+  /* No done without flush */
+  pos_latency_mark (POS_LATENCY_STAGE_DONE);
+
+  pos_latency_mark (POS_LATENCY_STAGE_PRESS);
+  pos_latency_mark (POS_LATENCY_STAGE_RELEASE);
+  pos_latency_mark (POS_LATENCY_STAGE_SYMBOL);
+  pos_latency_mark (POS_LATENCY_STAGE_COMMIT);
+  pos_latency_mark (POS_LATENCY_STAGE_FLUSH);
+  pos_latency_mark (POS_LATENCY_STAGE_DONE);
+
+  dump = pos_latency_dump ();
+  g_test_message ("%s", dump);
+  g_assert_cmpuint (get_count (dump, "release"), ==, 2);
+  g_assert_cmpuint (get_count (dump, "symbol"), ==, 2);
+  g_assert_cmpuint (get_count (dump, "completer"), ==, 0);
+  g_assert_cmpuint (get_count (dump, "commit"), ==, 2);
+  g_assert_cmpuint (get_count (dump, "flush"), ==, 1);
+  g_assert_cmpuint (get_count (dump, "done"), ==, 1);
+
+  /* Disabling drops the data */
+  pos_latency_set_enabled (FALSE);
+  pos_latency_mark (POS_LATENCY_STAGE_PRESS);
+  g_clear_pointer (&dump, g_free);
+  dump = pos_latency_dump ();
+  g_assert_cmpstr (dump, ==, "Latency tracing disabled");
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/latency/stages", test_latency_stages);
+
+  return g_test_run ();
+}
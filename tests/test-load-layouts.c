@@ -4,9 +4,11 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include "pos-layout-data.h"
 #include "pos-main.h"
+#include "pos-osk-key.h"
+#include "pos-osk-layout.h"
 #include "pos-osk-widget.h"
-#include "pos-resources.h"
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include <libgnome-desktop/gnome-xkb-info.h>
@@ -16,9 +18,7 @@
 static void
 test_load_layouts (void)
 {
-  g_autoptr (GResource) pos_resource = NULL;
   g_autoptr (GError) err = NULL;
-  g_auto (GStrv) names = NULL;
   g_autoptr (GRegex) lang_re = g_regex_new ("^[a-z]{2,3}$",
                                             G_REGEX_DEFAULT,
                                             G_REGEX_MATCH_DEFAULT,
@@ -30,25 +30,19 @@ test_load_layouts (void)
   g_autoptr (GnomeXkbInfo) xkbinfo = gnome_xkb_info_new ();
 
   pos_init ();
-  pos_resource = pos_get_resource ();
-  g_assert_nonnull (pos_resource);
 
-  names = g_resource_enumerate_children (pos_resource,
-                                         "/mobi/phosh/osk-stub/layouts",
-                                         G_RESOURCE_LOOKUP_FLAGS_NONE,
-                                         &err);
-  g_assert_no_error (err);
-  for (int i = 0; names[i]; i++) {
+  g_assert_cmpint (pos_layout_data_get_n_layouts (), >, 0);
+  for (int i = 0; i < pos_layout_data_get_n_layouts (); i++) {
     PosOskWidget *osk_widget;
-    g_autofree char *layout_id = NULL;
+    const PosLayoutData *data = pos_layout_data_get_nth (i);
+    const char *layout_id = data->id;
     const char *layout, *variant;
 
     osk_widget = g_object_ref_sink (pos_osk_widget_new (PHOSH_OSK_FEATURE_DEFAULT));
-    g_assert (g_str_has_suffix (names[i], ".json"));
-    layout_id = g_strndup (names[i], strlen (names[i]) - strlen (".json"));
+    g_assert_true (pos_layout_data_lookup (layout_id) == data);
     g_test_message ("Loading layout %s", layout_id);
 
-    if (g_strcmp0 (names[i], "terminal.json")) {
+    if (g_strcmp0 (layout_id, "terminal")) {
       g_assert_true (gnome_xkb_info_get_layout_info (xkbinfo, layout_id, NULL, NULL, &layout, &variant));
       pos_osk_widget_set_layout (osk_widget, "doesnotmatter", layout_id, "Test", layout, variant, &err);
       g_assert_nonnull (pos_osk_widget_get_lang (osk_widget));
@@ -67,12 +61,116 @@ test_load_layouts (void)
 }
 
 
+static void
+test_load_missing_layout (void)
+{
+  g_autoptr (GError) err = NULL;
+  PosOskWidget *osk_widget;
+  gboolean success;
+
+  g_assert_null (pos_layout_data_lookup ("doesnotexist"));
+
+  osk_widget = g_object_ref_sink (pos_osk_widget_new (PHOSH_OSK_FEATURE_DEFAULT));
+  success = pos_osk_widget_set_layout (osk_widget, "doesnotexist", "doesnotexist", "Test",
+                                       "doesnotexist", NULL, &err);
+  g_assert_false (success);
+  g_assert_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert_finalize_object (osk_widget);
+}
+
+
+static void
+test_shared_layout (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (PosOskLayout) layout = NULL;
+  PosOskWidget *osk_widget1, *osk_widget2;
+  gboolean success;
+
+  osk_widget1 = g_object_ref_sink (pos_osk_widget_new (PHOSH_OSK_FEATURE_DEFAULT));
+  osk_widget2 = g_object_ref_sink (pos_osk_widget_new (PHOSH_OSK_FEATURE_DEFAULT));
+
+  success = pos_osk_widget_set_layout (osk_widget1, "xkb:us", "us", "English (US)",
+                                       "us", NULL, &err);
+  g_assert_no_error (err);
+  g_assert_true (success);
+  success = pos_osk_widget_set_layout (osk_widget2, "ibus:varnam", "us", "Malayalam",
+                                       "us", NULL, &err);
+  g_assert_no_error (err);
+  g_assert_true (success);
+
+  /* Both widgets use the same layout data */
+  g_assert_true (pos_osk_widget_get_symbols (osk_widget1) ==
+                 pos_osk_widget_get_symbols (osk_widget2));
+  layout = pos_osk_layout_get ("us", &err);
+  g_assert_no_error (err);
+  g_assert_true (pos_osk_layout_get_symbols (layout) ==
+                 pos_osk_widget_get_symbols (osk_widget1));
+
+  /* Per widget state stays per widget */
+  pos_osk_widget_set_layer (osk_widget1, POS_OSK_WIDGET_LAYER_CAPS);
+  g_assert_cmpint (pos_osk_widget_get_layer (osk_widget2), ==, POS_OSK_WIDGET_LAYER_NORMAL);
+  g_assert_cmpstr (pos_osk_widget_get_display_name (osk_widget2), ==, "Malayalam");
+
+  g_assert_finalize_object (osk_widget1);
+  g_assert_finalize_object (osk_widget2);
+}
+
+
+static void
+test_key_table (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (PosOskLayout) layout = NULL;
+  const PosOskLayoutLayer *layer;
+  guint n_keys = 0;
+
+  layout = pos_osk_layout_get ("us", &err);
+  g_assert_no_error (err);
+
+  layer = pos_osk_layout_get_layer (layout, POS_OSK_WIDGET_LAYER_NORMAL);
+  g_assert_cmpint (layer->n_rows, >, 0);
+  for (int r = 0; r < layer->n_rows; r++) {
+    g_assert_cmpint (layer->rows[r].first, ==, n_keys);
+    n_keys += layer->rows[r].n_keys;
+  }
+  g_assert_cmpint (layer->n_keys, ==, n_keys);
+
+  for (int k = 0; k < layer->n_keys; k++) {
+    g_autoptr (PosOskKey) key = pos_osk_key_new (layout, POS_OSK_WIDGET_LAYER_NORMAL, k);
+    g_autofree char *symbol = NULL;
+    double width;
+
+    /* The view reads from the table */
+    g_assert_true (pos_osk_key_get_symbol (key) == layer->key_symbol[k]);
+    g_assert_true (pos_osk_key_get_label (key) == layer->key_label[k]);
+    g_assert_cmpint (pos_osk_key_get_use (key), ==, layer->key_use[k]);
+    g_assert_cmpfloat (pos_osk_key_get_width (key), ==, layer->key_width[k]);
+
+    g_object_get (key, "symbol", &symbol, "width", &width, NULL);
+    g_assert_cmpstr (symbol, ==, layer->key_symbol[k]);
+    g_assert_cmpfloat (width, ==, layer->key_width[k]);
+
+    /* Strings are interned */
+    if (layer->key_symbol[k]) {
+      g_assert_true (g_intern_string (layer->key_symbol[k]) == layer->key_symbol[k]);
+      g_assert_cmpuint (pos_symbol_from_string (layer->key_symbol[k]), ==, layer->key_symbol_id[k]);
+    } else {
+      g_assert_cmpuint (layer->key_symbol_id[k], ==, POS_SYMBOL_INVALID);
+    }
+  }
+}
+
+
 int
 main (int argc, char *argv[])
 {
   gtk_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/pos/completer/load_layouts", test_load_layouts);
+  g_test_add_func ("/pos/completer/load_missing_layout", test_load_missing_layout);
+  g_test_add_func ("/pos/completer/shared_layout", test_shared_layout);
+  g_test_add_func ("/pos/completer/key_table", test_key_table);
 
   return g_test_run ();
 }
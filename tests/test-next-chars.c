@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-completer.h"
+
+#include <glib.h>
+
+#define EPSILON 1e-6
+
+
+static double
+get_prob (GHashTable *next_chars, const char *c)
+{
+  double *prob = g_hash_table_lookup (next_chars, c);
+
+  return prob ? *prob : 0.0;
+}
+
+
+static void
+test_next_chars_rank (void)
+{
+  const char * const words[] = { "the", "this", "thanks", "other", NULL };
+  g_autoptr (GHashTable) next_chars = NULL;
+  double total = 1.0 + 1.0 / 2 + 1.0 / 3;
+
+  /* Without weights words are weighted by their rank */
+  next_chars = pos_completer_next_chars_from_words ("th", words, NULL);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 3);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "e"), 1.0 / total, EPSILON);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "i"), 1.0 / 2 / total, EPSILON);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "a"), 1.0 / 3 / total, EPSILON);
+}
+
+
+static void
+test_next_chars_weights (void)
+{
+  const char * const words[] = { "cat", "car", "cart", "dog", NULL };
+  const double weights[] = { 2.0, 1.0, 1.0, 100.0 };
+  g_autoptr (GHashTable) next_chars = NULL;
+
+  next_chars = pos_completer_next_chars_from_words ("ca", words, weights);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 2);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "t"), 0.5, EPSILON);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "r"), 0.5, EPSILON);
+}
+
+
+static void
+test_next_chars_case (void)
+{
+  const char * const words[] = { "Über", "übel", "Ufer", NULL };
+  const double weights[] = { 1.0, 1.0, 2.0 };
+  g_autoptr (GHashTable) next_chars = NULL;
+
+  /* Without a prefix the first characters count */
+  next_chars = pos_completer_next_chars_from_words (NULL, words, weights);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 2);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "ü"), 0.5, EPSILON);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "u"), 0.5, EPSILON);
+  g_clear_pointer (&next_chars, g_hash_table_unref);
+
+  next_chars = pos_completer_next_chars_from_words ("ÜB", words, weights);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 1);
+  g_assert_cmpfloat_with_epsilon (get_prob (next_chars, "e"), 1.0, EPSILON);
+}
+
+
+static void
+test_next_chars_no_match (void)
+{
+  const char * const words[] = { "word", "world", NULL };
+  g_autoptr (GHashTable) next_chars = NULL;
+
+  /* Words that equal the prefix have no next character */
+  next_chars = pos_completer_next_chars_from_words ("word", words, NULL);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 0);
+  g_clear_pointer (&next_chars, g_hash_table_unref);
+
+  next_chars = pos_completer_next_chars_from_words ("x", words, NULL);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 0);
+  g_clear_pointer (&next_chars, g_hash_table_unref);
+
+  next_chars = pos_completer_next_chars_from_words ("w", NULL, NULL);
+  g_assert_cmpuint (g_hash_table_size (next_chars), ==, 0);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/completer/next_chars/rank", test_next_chars_rank);
+  g_test_add_func ("/pos/completer/next_chars/weights", test_next_chars_weights);
+  g_test_add_func ("/pos/completer/next_chars/case", test_next_chars_case);
+  g_test_add_func ("/pos/completer/next_chars/no_match", test_next_chars_no_match);
+
+  return g_test_run ();
+}
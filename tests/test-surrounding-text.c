@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-surrounding-text.h"
+
+#include <glib.h>
+#include <string.h>
+
+static void
+test_surrounding_text_views (void)
+{
+  g_autoptr (PosSurroundingText) text = NULL;
+  g_autoptr (PosSurroundingText) other = NULL;
+  const char *view;
+  gsize len;
+
+  /* Cursor right after "wör" */
+  text = pos_surrounding_text_new ("Hello wörld. Bye", 10, 10);
+  other = pos_surrounding_text_new ("Hello wörld. Bye", 10, 10);
+  g_assert_true (pos_surrounding_text_equal (text, other));
+  g_assert_false (pos_surrounding_text_equal (text, NULL));
+
+  view = pos_surrounding_text_get_before (text, 100, &len);
+  g_assert_cmpuint (len, ==, 10);
+  g_assert_cmpmem (view, len, "Hello wör", 10);
+
+  /* Doesn't split the 'ö' */
+  view = pos_surrounding_text_get_before (text, 2, &len);
+  g_assert_cmpmem (view, len, "r", 1);
+
+  view = pos_surrounding_text_get_before (text, 0, &len);
+  g_assert_cmpuint (len, ==, 0);
+
+  g_assert_cmpstr (pos_surrounding_text_get_after (text), ==, "ld. Bye");
+
+  view = pos_surrounding_text_get_word (text, &len);
+  g_assert_cmpmem (view, len, "wörld", strlen ("wörld"));
+
+  /* Cursor is clamped */
+  g_clear_pointer (&other, pos_surrounding_text_unref);
+  other = pos_surrounding_text_new ("abc", 10, 1);
+  g_assert_cmpuint (pos_surrounding_text_get_cursor (other), ==, 3);
+  g_assert_cmpuint (pos_surrounding_text_get_anchor (other), ==, 1);
+  g_assert_cmpstr (pos_surrounding_text_get_after (other), ==, "");
+  view = pos_surrounding_text_get_word (other, &len);
+  g_assert_cmpmem (view, len, "abc", 3);
+}
+
+
+static void
+test_surrounding_text_delta (void)
+{
+  g_autoptr (PosSurroundingText) prev = NULL;
+  g_autoptr (PosSurroundingText) text = NULL;
+  guint pos, n_removed, n_inserted;
+
+  prev = pos_surrounding_text_new ("Hello world", 5, 5);
+  g_assert_false (pos_surrounding_text_get_delta (prev, NULL, NULL, NULL));
+
+  /* Insertion */
+  text = pos_surrounding_text_new ("Hello, world", 6, 6);
+  pos_surrounding_text_set_previous (text, prev);
+  g_assert_true (pos_surrounding_text_get_delta (text, &pos, &n_removed, &n_inserted));
+  g_assert_cmpuint (pos, ==, 5);
+  g_assert_cmpuint (n_removed, ==, 0);
+  g_assert_cmpuint (n_inserted, ==, 1);
+
+  /* Deletion at the end */
+  g_clear_pointer (&text, pos_surrounding_text_unref);
+  text = pos_surrounding_text_new ("Hello wor", 9, 9);
+  pos_surrounding_text_set_previous (text, prev);
+  g_assert_true (pos_surrounding_text_get_delta (text, &pos, &n_removed, &n_inserted));
+  g_assert_cmpuint (pos, ==, 9);
+  g_assert_cmpuint (n_removed, ==, 2);
+  g_assert_cmpuint (n_inserted, ==, 0);
+
+  /* Replacing a character of the same first byte doesn't split it */
+  g_clear_pointer (&prev, pos_surrounding_text_unref);
+  g_clear_pointer (&text, pos_surrounding_text_unref);
+  prev = pos_surrounding_text_new ("aäb", 0, 0);
+  text = pos_surrounding_text_new ("aöb", 0, 0);
+  pos_surrounding_text_set_previous (text, prev);
+  g_assert_true (pos_surrounding_text_get_delta (text, &pos, &n_removed, &n_inserted));
+  g_assert_cmpuint (pos, ==, 1);
+  g_assert_cmpuint (n_removed, ==, 2);
+  g_assert_cmpuint (n_inserted, ==, 2);
+
+  /* No previous text, no delta */
+  pos_surrounding_text_set_previous (text, NULL);
+  g_assert_false (pos_surrounding_text_get_delta (text, NULL, NULL, NULL));
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/surrounding-text/views", test_surrounding_text_views);
+  g_test_add_func ("/pos/surrounding-text/delta", test_surrounding_text_delta);
+
+  return g_test_run ();
+}
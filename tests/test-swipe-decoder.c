@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-swipe-decoder.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <unistd.h>
+
+#define KEY_SIZE 10.0
+
+static const char *lexicon =
+  "hello 100\n"
+  "hell 10\n"
+  "help 50\n"
+  "world 80\n"
+  "word 40\n"
+  "wold 1\n"
+  "a 1000\n";
+
+static const char *const rows[] = { "qwertyuiop", "asdfghjkl", "zxcvbnm" };
+
+
+static GArray *
+make_keys (void)
+{
+  GArray *keys = g_array_new (FALSE, FALSE, sizeof (PosSwipeKey));
+
+  for (guint r = 0; r < G_N_ELEMENTS (rows); r++) {
+    for (int k = 0; rows[r][k]; k++) {
+      PosSwipeKey key = {
+        .symbol = g_intern_string ((char[]){ rows[r][k], '\0' }),
+        .x = (0.5 + 0.5 * r + k) * KEY_SIZE,
+        .y = (0.5 + r) * KEY_SIZE,
+      };
+      g_array_append_val (keys, key);
+    }
+  }
+
+  return keys;
+}
+
+/* A trace through the keys of the given letters */
+static GArray *
+make_trace (GArray *keys, const char *letters)
+{
+  GArray *trace = g_array_new (FALSE, FALSE, sizeof (PosSwipePoint));
+
+  for (const char *c = letters; *c; c++) {
+    for (guint i = 0; i < keys->len; i++) {
+      PosSwipeKey *key = &g_array_index (keys, PosSwipeKey, i);
+
+      if (key->symbol[0] == *c) {
+        /* Slightly off center like a real finger */
+        PosSwipePoint point = { key->x + 1.5, key->y - 1.0 };
+
+        g_array_append_val (trace, point);
+        break;
+      }
+    }
+  }
+
+  return trace;
+}
+
+
+static GStrv
+decode (PosSwipeDecoder *decoder, GArray *keys, GArray *trace)
+{
+  return pos_swipe_decoder_decode (decoder,
+                                   (PosSwipeKey *)keys->data,
+                                   keys->len,
+                                   KEY_SIZE,
+                                   (PosSwipePoint *)trace->data,
+                                   trace->len,
+                                   3);
+}
+
+
+static void
+test_swipe_decoder_decode (void)
+{
+  g_autoptr (PosSwipeDecoder) decoder = pos_swipe_decoder_new ();
+  g_autoptr (GError) err = NULL;
+  g_autoptr (GArray) keys = make_keys ();
+  g_autoptr (GArray) trace = NULL;
+  g_autofree char *path = NULL;
+  g_auto (GStrv) words = NULL;
+  int fd;
+
+  fd = g_file_open_tmp ("pos-swipe-lexicon-XXXXXX", &path, &err);
+  g_assert_no_error (err);
+  g_assert_true (g_file_set_contents (path, lexicon, -1, &err));
+  g_assert_no_error (err);
+  close (fd);
+
+  /* No lexicon, no words */
+  trace = make_trace (keys, "helo");
+  words = decode (decoder, keys, trace);
+  g_assert_null (words);
+
+  g_assert_true (pos_swipe_decoder_load_lexicon (decoder, path, &err));
+  g_assert_no_error (err);
+  /* Single letter words can't be swiped */
+  g_assert_cmpint (pos_swipe_decoder_get_n_words (decoder), ==, 6);
+
+  words = decode (decoder, keys, trace);
+  g_assert_nonnull (words);
+  g_assert_cmpstr (words[0], ==, "hello");
+  g_clear_pointer (&words, g_strfreev);
+  g_clear_pointer (&trace, g_array_unref);
+
+  trace = make_trace (keys, "world");
+  words = decode (decoder, keys, trace);
+  g_assert_nonnull (words);
+  g_assert_cmpstr (words[0], ==, "world");
+  g_assert_false (g_strv_contains ((const char * const *)words, "hello"));
+  g_clear_pointer (&words, g_strfreev);
+  g_clear_pointer (&trace, g_array_unref);
+
+  /* A tap isn't a swipe */
+  trace = make_trace (keys, "hh");
+  words = decode (decoder, keys, trace);
+  g_assert_null (words);
+
+  g_unlink (path);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/swipe-decoder/decode", test_swipe_decoder_decode);
+
+  return g_test_run ();
+}
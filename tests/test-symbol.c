@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "pos-symbol.h"
+
+#include <glib.h>
+
+static void
+test_symbol_intern (void)
+{
+  g_autofree char *dup = g_strdup ("ä");
+  PosSymbol symbol;
+
+  symbol = pos_symbol_from_string ("ä");
+  g_assert_cmpuint (symbol, !=, POS_SYMBOL_INVALID);
+  g_assert_cmpuint (pos_symbol_from_string (dup), ==, symbol);
+  g_assert_cmpuint (pos_symbol_from_unichar (g_utf8_get_char (dup)), ==, symbol);
+  g_assert_true (pos_symbol_to_string (symbol) == g_intern_string (dup));
+  g_assert_cmpuint (pos_symbol_from_string ("b"), !=, symbol);
+
+  g_assert_cmpuint (pos_symbol_from_string ("KEY_BACKSPACE"), ==, POS_SYMBOL_KEY_BACKSPACE);
+  g_assert_cmpuint (pos_symbol_from_string ("KEY_ENTER"), ==, POS_SYMBOL_KEY_ENTER);
+  g_assert_cmpuint (pos_symbol_from_string (" "), ==, POS_SYMBOL_SPACE);
+  g_assert_cmpuint (pos_symbol_from_unichar (' '), ==, POS_SYMBOL_SPACE);
+  g_assert_cmpstr (pos_symbol_to_string (POS_SYMBOL_KEY_DOWN), ==, "KEY_DOWN");
+}
+
+
+static void
+test_symbol_flags (void)
+{
+  PosSymbol symbol;
+
+  symbol = pos_symbol_from_string ("KEY_LEFT");
+  g_assert_cmpint (pos_symbol_get_flags (symbol), ==, POS_SYMBOL_FLAG_SPECIAL);
+  g_assert_cmpuint (pos_symbol_get_codepoint (symbol), ==, 0);
+
+  symbol = pos_symbol_from_string ("x");
+  g_assert_cmpint (pos_symbol_get_flags (symbol), ==, POS_SYMBOL_FLAG_CODEPOINT);
+  g_assert_cmpuint (pos_symbol_get_codepoint (symbol), ==, 'x');
+
+  symbol = pos_symbol_from_string (",");
+  g_assert_cmpint (pos_symbol_get_flags (symbol), ==,
+                   POS_SYMBOL_FLAG_CODEPOINT | POS_SYMBOL_FLAG_SEPARATOR);
+
+  symbol = pos_symbol_from_string ("\t");
+  g_assert_cmpint (pos_symbol_get_flags (symbol), ==,
+                   POS_SYMBOL_FLAG_CODEPOINT | POS_SYMBOL_FLAG_SEPARATOR |
+                   POS_SYMBOL_FLAG_WHITESPACE);
+
+  /* Classifying code points doesn't need interning */
+  g_assert_cmpint (pos_symbol_get_unichar_flags (','), ==, POS_SYMBOL_FLAG_SEPARATOR);
+  g_assert_cmpint (pos_symbol_get_unichar_flags ('\n'), ==,
+                   POS_SYMBOL_FLAG_SEPARATOR | POS_SYMBOL_FLAG_WHITESPACE);
+  g_assert_cmpint (pos_symbol_get_unichar_flags ('x'), ==, POS_SYMBOL_FLAG_NONE);
+  g_assert_cmpint (pos_symbol_get_unichar_flags (0x1F44D), ==, POS_SYMBOL_FLAG_NONE);
+
+  /* An emoji with a skin tone modifier */
+  symbol = pos_symbol_from_string ("👍🏽");
+  g_assert_cmpint (pos_symbol_get_flags (symbol), ==, POS_SYMBOL_FLAG_NONE);
+  g_assert_cmpuint (pos_symbol_get_codepoint (symbol), ==, 0x1F44D);
+}
+
+
+static void
+test_symbol_lookup (void)
+{
+  g_autofree char *dup = g_strdup ("ö");
+  PosSymbol symbol;
+
+  /* Looking up unknown symbols doesn't intern them */
+  g_assert_cmpuint (pos_symbol_lookup (dup), ==, POS_SYMBOL_INVALID);
+  g_assert_cmpuint (pos_symbol_lookup_unichar (0x00F6), ==, POS_SYMBOL_INVALID);
+  g_assert_cmpuint (g_quark_try_string (dup), ==, 0);
+
+  symbol = pos_symbol_from_string ("ö");
+  g_assert_cmpuint (pos_symbol_lookup (dup), ==, symbol);
+  g_assert_cmpuint (pos_symbol_lookup_unichar (0x00F6), ==, symbol);
+
+  g_assert_cmpuint (pos_symbol_lookup ("KEY_BACKSPACE"), ==, POS_SYMBOL_KEY_BACKSPACE);
+  g_assert_cmpuint (pos_symbol_lookup_unichar (' '), ==, POS_SYMBOL_SPACE);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pos/symbol/intern", test_symbol_intern);
+  g_test_add_func ("/pos/symbol/flags", test_symbol_flags);
+  g_test_add_func ("/pos/symbol/lookup", test_symbol_lookup);
+
+  return g_test_run ();
+}
@@ -0,0 +1,268 @@
+#!/usr/bin/python3
+#
+# Copyright (C) 2024 The Phosh Developers
+#
+# Compile the terminal keymap into static C lookup tables: symbol to
+# keycode and modifiers and GDK keyval to keycode. The tables use
+# minimal perfect hashing (hash and displace) so lookups need neither
+# allocations nor probing. The hash function must match pos-keycodes.c.
+
+import argparse
+import re
+import sys
+
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+# Keysyms of printable ASCII characters as used in xkb keymaps
+ASCII_KEYSYMS = {
+    "space": " ",
+    "exclam": "!",
+    "quotedbl": '"',
+    "numbersign": "#",
+    "dollar": "$",
+    "percent": "%",
+    "ampersand": "&",
+    "apostrophe": "'",
+    "parenleft": "(",
+    "parenright": ")",
+    "asterisk": "*",
+    "plus": "+",
+    "comma": ",",
+    "minus": "-",
+    "period": ".",
+    "slash": "/",
+    "colon": ":",
+    "semicolon": ";",
+    "less": "<",
+    "equal": "=",
+    "greater": ">",
+    "question": "?",
+    "at": "@",
+    "bracketleft": "[",
+    "backslash": "\\",
+    "bracketright": "]",
+    "asciicircum": "^",
+    "underscore": "_",
+    "grave": "`",
+    "braceleft": "{",
+    "bar": "|",
+    "braceright": "}",
+    "asciitilde": "~",
+}
+
+# Keysyms of special keys: The OSK's symbol and the keysym's value
+SPECIAL_KEYSYMS = {
+    "BackSpace": ("KEY_BACKSPACE", 0xFF08),
+    "Tab": ("KEY_TAB", 0xFF09),
+    "Return": ("KEY_ENTER", 0xFF0D),
+    "Escape": ("KEY_ESC", 0xFF1B),
+    "Left": ("KEY_LEFT", 0xFF51),
+    "Up": ("KEY_UP", 0xFF52),
+    "Right": ("KEY_RIGHT", 0xFF53),
+    "Down": ("KEY_DOWN", 0xFF54),
+}
+for n in range(1, 13):
+    SPECIAL_KEYSYMS[f"F{n}"] = (f"KEY_F{n}", 0xFFBE + n - 1)
+
+# Keys of the main block. Symbols are looked up there first so e.g.
+# `(` is sent as shifted `9` rather than via a keypad key.
+MAIN_KEYS = r"A[EDCB]\d\d|TLDE|BKSL|SPCE"
+
+# Shift levels of the keymap's single group
+MODIFIERS = [
+    "POS_KEYCODE_MODIFIER_NONE",
+    "POS_KEYCODE_MODIFIER_SHIFT",
+    "POS_KEYCODE_MODIFIER_ALTGR",
+]
+
+
+class KeymapError(Exception):
+    pass
+
+
+def fnv1a(data, seed):
+    h = FNV_OFFSET ^ seed
+    for b in data:
+        h ^= b
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+
+    # Mix the bits as short keys barely differ otherwise
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+def hash_str(key, seed):
+    return fnv1a(key.encode("utf-8"), seed)
+
+
+def hash_uint(key, seed):
+    return fnv1a(key.to_bytes(4, "little"), seed)
+
+
+def keysym_to_char(keysym):
+    if len(keysym) == 1:
+        return keysym
+    if keysym in ASCII_KEYSYMS:
+        return ASCII_KEYSYMS[keysym]
+    if re.fullmatch(r"U[0-9A-Fa-f]{4,6}", keysym):
+        return chr(int(keysym[1:], 16))
+    return None
+
+
+def parse_keymap(file):
+    with open(file, encoding="utf-8") as f:
+        keymap = f.read()
+
+    section = re.search(r'xkb_keycodes\s+"[^"]*"\s*\{(.*?)\n\};', keymap, re.S)
+    if not section:
+        raise KeymapError(f"{file}: no xkb_keycodes section")
+    keycodes = {
+        name: int(code)
+        for name, code in re.findall(r"^\s*<(\w+)>\s*=\s*(\d+);", section.group(1), re.M)
+    }
+
+    section = re.search(r'xkb_symbols\s+"[^"]*"\s*\{(.*?)\n\};', keymap, re.S)
+    if not section:
+        raise KeymapError(f"{file}: no xkb_symbols section")
+
+    keys = []
+    for name, body in re.findall(r"key\s+<(\w+)>\s*\{(.*?)\};", section.group(1), re.S):
+        # Either `[ a, A ]` or `symbols[Group1]= [ a, A ]`
+        levels = re.search(r"(?:^|=)\s*\[([^\]]*)\]", body)
+        if not levels:
+            continue
+        if name not in keycodes:
+            raise KeymapError(f"{file}: key <{name}> has no keycode")
+        # xkb keycodes have an offset of 8 to the evdev ones
+        keys.append((name, keycodes[name] - 8, [s.strip() for s in levels.group(1).split(",")]))
+
+    return keys
+
+
+def build_tables(keys):
+    symbols = {}
+    keyvals = {}
+
+    main = [key for key in keys if re.fullmatch(MAIN_KEYS, key[0])]
+    others = [key for key in keys if not re.fullmatch(MAIN_KEYS, key[0])]
+
+    # Prefer the main block and lower shift levels when a symbol is on several keys
+    for block in [main, others]:
+        for level, modifier in enumerate(MODIFIERS):
+            for name, keycode, keysyms in block:
+                if level >= len(keysyms):
+                    continue
+
+                keysym = keysyms[level]
+                if keysym in SPECIAL_KEYSYMS:
+                    symbol, keyval = SPECIAL_KEYSYMS[keysym]
+                    if level == 0:
+                        keyvals.setdefault(keyval, (keycode, name))
+                else:
+                    symbol = keysym_to_char(keysym)
+                    if symbol is None:
+                        continue
+                    # Latin-1 keysyms have the same value as the code point
+                    if level == 0 and ord(symbol) < 0x7F:
+                        keyvals.setdefault(ord(symbol), (keycode, name))
+
+                symbols.setdefault(symbol, (keycode, modifier, name))
+
+    return symbols, keyvals
+
+
+def perfect_hash(keys, hashfn):
+    n = len(keys)
+    n_disp = max(1, (n + 3) // 4)
+    buckets = [[] for _ in range(n_disp)]
+    for key in keys:
+        buckets[hashfn(key, 0) % n_disp].append(key)
+
+    disp = [0] * n_disp
+    slots = [None] * n
+    for b in sorted(range(n_disp), key=lambda i: -len(buckets[i])):
+        if not buckets[b]:
+            continue
+        for d in range(1, 1 << 20):
+            idx = [hashfn(key, d) % n for key in buckets[b]]
+            if len(set(idx)) == len(idx) and all(slots[i] is None for i in idx):
+                break
+        else:
+            raise KeymapError("Can't build perfect hash")
+        disp[b] = d
+        for key, i in zip(buckets[b], idx):
+            slots[i] = key
+
+    return disp, slots
+
+
+def c_str(s):
+    out = ""
+    for b in s.encode("utf-8"):
+        c = chr(b)
+        if c in '"\\':
+            out += "\\" + c
+        elif 0x20 <= b < 0x7F:
+            out += c
+        else:
+            out += "\\%03o" % b
+    return f'"{out}"'
+
+
+def write_disp(out, name, disp):
+    out.write(f"const guint32 {name}[] = {{\n")
+    for i in range(0, len(disp), 8):
+        out.write("  " + ", ".join(str(d) for d in disp[i : i + 8]) + ",\n")
+    out.write("};\n")
+    out.write(f"const guint {name}_n = {len(disp)};\n\n")
+
+
+def write_tables(out, symbols, keyvals):
+    out.write("/* Generated by compile-keycodes.py, do not edit */\n\n")
+    out.write('#include "pos-config.h"\n\n')
+    out.write('#include "pos-keycodes.h"\n\n')
+
+    disp, slots = perfect_hash(list(symbols), hash_str)
+    write_disp(out, "pos_keycodes_symbols_disp", disp)
+    out.write("const PosKeycode pos_keycodes_symbols[] = {\n")
+    for symbol in slots:
+        keycode, modifier, name = symbols[symbol]
+        out.write(f"  {{ {c_str(symbol)}, {keycode}, {modifier} }}, /* <{name}> */\n")
+    out.write("};\n")
+    out.write(f"const guint pos_keycodes_symbols_n = {len(slots)};\n\n")
+
+    disp, slots = perfect_hash(list(keyvals), hash_uint)
+    write_disp(out, "pos_keycodes_keyvals_disp", disp)
+    out.write("const PosKeycodeKeyval pos_keycodes_keyvals[] = {\n")
+    for keyval in slots:
+        keycode, name = keyvals[keyval]
+        out.write(f"  {{ 0x{keyval:04x}, {keycode} }}, /* <{name}> */\n")
+    out.write("};\n")
+    out.write(f"const guint pos_keycodes_keyvals_n = {len(slots)};\n")
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Compile keycode tables")
+    parser.add_argument("--keymap", action="store", default="data/keymap.txt")
+    parser.add_argument("--out", action="store", default="pos-keycodes-compiled.c")
+    args = parser.parse_args(argv[1:])
+
+    try:
+        symbols, keyvals = build_tables(parse_keymap(args.keymap))
+        with open(args.out, "w", encoding="utf-8") as f:
+            write_tables(f, symbols, keyvals)
+    except KeymapError as e:
+        print(f"Invalid keymap: {e}", file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,245 @@
+#!/usr/bin/python3
+#
+# Copyright (C) 2024 The Phosh Developers
+#
+# Author: Guido Günther <agx@sigxcpu.org>
+#
+# Validate the OSK layouts and compile them into static C tables so
+# they don't need to be parsed at runtime.
+
+import argparse
+import glob
+import os
+import sys
+import json
+
+
+MAX_ROWS = 5
+
+LEVELS = {
+    "": "POS_OSK_WIDGET_LAYER_NORMAL",
+    "shift": "POS_OSK_WIDGET_LAYER_CAPS",
+    "opt": "POS_OSK_WIDGET_LAYER_SYMBOLS",
+    "opt+shift": "POS_OSK_WIDGET_LAYER_SYMBOLS2",
+}
+
+KEY_PROPS = {
+    "symbol": str,
+    "label": str,
+    "icon": str,
+    "style": str,
+    "width": (int, float),
+}
+
+
+class LayoutError(Exception):
+    pass
+
+
+def check_type(value, types, where):
+    # bool is an int in Python, never accept it for numbers
+    if isinstance(value, bool) or not isinstance(value, types):
+        raise LayoutError(f"{where}: unexpected value {value!r}")
+
+
+def parse_key(key, where):
+    if isinstance(key, list):
+        if len(key) == 0:
+            raise LayoutError(f"{where}: empty key")
+        for sym in key:
+            check_type(sym, str, where)
+        return {
+            "symbol": key[0],
+            "symbols": key[1:],
+            "width": 1.0,
+        }
+    elif isinstance(key, dict):
+        for prop, value in key.items():
+            if prop not in KEY_PROPS:
+                raise LayoutError(f"{where}: unknown key property '{prop}'")
+            check_type(value, KEY_PROPS[prop], f"{where}: {prop}")
+        if "symbol" not in key and "label" not in key and "icon" not in key:
+            raise LayoutError(f"{where}: key has neither symbol, label nor icon")
+        width = float(key.get("width", 1.0))
+        if width < 1.0 or width > 10.0:
+            raise LayoutError(f"{where}: key width {width} out of range")
+        return {
+            "symbol": key.get("symbol"),
+            "symbols": [],
+            "label": key.get("label"),
+            "icon": key.get("icon"),
+            "style": key.get("style"),
+            "width": width,
+        }
+
+    raise LayoutError(f"{where}: unparseable key")
+
+
+def parse_layout(file):
+    layout_id = os.path.basename(file)[: -len(".json")]
+
+    with open(file, encoding="utf-8") as f:
+        try:
+            j = json.load(f)
+        except json.JSONDecodeError as e:
+            raise LayoutError(f"{file}: {e}")
+
+    if not isinstance(j, dict):
+        raise LayoutError(f"{file}: root node not an object")
+
+    for prop in ["name", "locale"]:
+        check_type(j.get(prop), str, f"{file}: {prop}")
+
+    locale_parts = j["locale"].split("-")
+    if len(locale_parts) > 2:
+        raise LayoutError(f"{file}: malformed locale '{j['locale']}'")
+
+    levels = j.get("levels")
+    if not isinstance(levels, list) or not levels:
+        raise LayoutError(f"{file}: malformed levels")
+
+    parsed_levels = []
+    seen = set()
+    for l, level in enumerate(levels):
+        where = f"{file}: level {l}"
+        if not isinstance(level, dict):
+            raise LayoutError(f"{where}: not an object")
+
+        name = level.get("level")
+        if name not in LEVELS:
+            raise LayoutError(f"{where}: unknown level '{name}'")
+        if name in seen:
+            raise LayoutError(f"{where}: duplicate level '{name}'")
+        seen.add(name)
+
+        rows = level.get("rows")
+        if not isinstance(rows, list) or not rows:
+            raise LayoutError(f"{where}: malformed rows")
+        if len(rows) > MAX_ROWS:
+            raise LayoutError(f"{where}: more than {MAX_ROWS} rows")
+
+        parsed_rows = []
+        for r, row in enumerate(rows):
+            if not isinstance(row, list):
+                raise LayoutError(f"{where}: row {r} not an array")
+            parsed_rows.append(
+                [parse_key(key, f"{where} row {r} key {k}") for k, key in enumerate(row)]
+            )
+
+        parsed_levels.append({"layer": LEVELS[name], "rows": parsed_rows})
+
+    return {
+        "id": layout_id,
+        "name": j["name"],
+        "locale": j["locale"],
+        "levels": parsed_levels,
+    }
+
+
+def c_str(s):
+    if s is None:
+        return "NULL"
+
+    out = ""
+    for b in s.encode("utf-8"):
+        c = chr(b)
+        if c in '"\\':
+            out += "\\" + c
+        elif 0x20 <= b < 0x7F:
+            out += c
+        else:
+            out += "\\%03o" % b
+    return f'"{out}"'
+
+
+def c_ident(layout_id):
+    return "".join(c if c.isalnum() else "_" for c in layout_id)
+
+
+def write_layout(out, layout):
+    ident = c_ident(layout["id"])
+
+    for l, level in enumerate(layout["levels"]):
+        for r, row in enumerate(level["rows"]):
+            for k, key in enumerate(row):
+                if not key["symbols"]:
+                    continue
+                syms = ", ".join([c_str(s) for s in key["symbols"]] + ["NULL"])
+                out.write(f"static const char *const {ident}_{l}_{r}_{k}_symbols[] = {{ {syms} }};\n")
+
+            out.write(f"static const PosLayoutKeyData {ident}_{l}_{r}_keys[] = {{\n")
+            for k, key in enumerate(row):
+                syms = f"{ident}_{l}_{r}_{k}_symbols" if key["symbols"] else "NULL"
+                out.write(
+                    "  {{ {}, {}, {}, {}, {}, {} }},\n".format(
+                        c_str(key.get("symbol")),
+                        syms,
+                        c_str(key.get("label")),
+                        c_str(key.get("icon")),
+                        c_str(key.get("style")),
+                        # repr () round trips so widths stay exact
+                        repr(key["width"]),
+                    )
+                )
+            out.write("};\n")
+
+        out.write(f"static const PosLayoutRowData {ident}_{l}_rows[] = {{\n")
+        for r, row in enumerate(level["rows"]):
+            out.write(f"  {{ {ident}_{l}_{r}_keys, {len(row)} }},\n")
+        out.write("};\n")
+
+    out.write(f"static const PosLayoutLevelData {ident}_levels[] = {{\n")
+    for l, level in enumerate(layout["levels"]):
+        out.write(f"  {{ {level['layer']}, {ident}_{l}_rows, {len(level['rows'])} }},\n")
+    out.write("};\n\n")
+
+
+def write_layouts(out, layouts):
+    out.write("/* Generated by compile-layouts.py, do not edit */\n\n")
+    out.write('#include "pos-config.h"\n\n')
+    out.write('#include "pos-layout-data.h"\n\n')
+
+    for layout in layouts:
+        write_layout(out, layout)
+
+    out.write("/* Sorted by id so we can bsearch */\n")
+    out.write("const PosLayoutData pos_layout_data[] = {\n")
+    for layout in layouts:
+        ident = c_ident(layout["id"])
+        out.write(
+            "  {{ {}, {}, {}, {}_levels, {} }},\n".format(
+                c_str(layout["id"]),
+                c_str(layout["name"]),
+                c_str(layout["locale"]),
+                ident,
+                len(layout["levels"]),
+            )
+        )
+    out.write("};\n")
+    out.write(f"const guint pos_layout_data_n = {len(layouts)};\n")
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Compile OSK layouts")
+    parser.add_argument("--layouts", action="store", default="src/layouts")
+    parser.add_argument("--out", action="store", default="pos-layout-data-compiled.c")
+    parser.add_argument("files", nargs="*", help="Layouts to compile, defaults to all in --layouts")
+    args = parser.parse_args(argv[1:])
+
+    files = args.files or glob.glob(os.path.join(args.layouts, "*.json"))
+    try:
+        layouts = [parse_layout(file) for file in files]
+    except LayoutError as e:
+        print(f"Invalid layout: {e}", file=sys.stderr)
+        return 1
+
+    # Byte wise sort to match strcmp () at runtime
+    layouts.sort(key=lambda layout: layout["id"].encode("utf-8"))
+    with open(args.out, "w", encoding="utf-8") as f:
+        write_layouts(f, layouts)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2024 The Phosh Developers
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Replay recorded touches against a layout and compare how many of
+ * them hit the intended key with plain geometric hit testing and with
+ * adaptive keys.
+ *
+ * The trace starts with a `# layout <id> <width> <height>` line followed
+ * by one `<x> <y> <intended-symbol>` line per touch. The word list has
+ * one `<word> [<count>]` per line.
+ */
+
+#include "pos-completer.h"
+#include "pos-completer-priv.h"
+#include "pos-main.h"
+#include "pos-osk-widget.h"
+
+#include <gtk/gtk.h>
+
+#include <stdlib.h>
+
+
+static gboolean
+load_words (const char *path, GStrv *words, double **weights, GError **err)
+{
+  g_autofree char *contents = NULL;
+  g_auto (GStrv) lines = NULL;
+  g_autoptr (GStrvBuilder) builder = g_strv_builder_new ();
+  g_autoptr (GArray) counts = g_array_new (FALSE, FALSE, sizeof (double));
+
+  if (!g_file_get_contents (path, &contents, NULL, err))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (int i = 0; lines[i]; i++) {
+    g_auto (GStrv) fields = g_strsplit_set (g_strstrip (lines[i]), " \t", 2);
+    double count = 1.0;
+
+    if (fields[0] == NULL || fields[0][0] == '\0')
+      continue;
+
+    if (fields[1])
+      count = g_ascii_strtod (fields[1], NULL);
+
+    g_strv_builder_add (builder, fields[0]);
+    g_array_append_val (counts, count);
+  }
+
+  *words = g_strv_builder_end (builder);
+  *weights = (double *)g_array_free (g_steal_pointer (&counts), FALSE);
+  return TRUE;
+}
+
+
+static PosOskWidget *
+create_osk_widget (const char *layout_id, int width, int height, GError **err)
+{
+  GtkWidget *window = gtk_offscreen_window_new ();
+  PosOskWidget *osk_widget = pos_osk_widget_new (PHOSH_OSK_FEATURE_ADAPTIVE_KEYS);
+
+  if (!pos_osk_widget_set_layout (osk_widget, layout_id, layout_id, layout_id,
+                                  layout_id, NULL, err)) {
+    g_object_unref (g_object_ref_sink (osk_widget));
+    gtk_widget_destroy (window);
+    return NULL;
+  }
+
+  gtk_widget_set_size_request (GTK_WIDGET (osk_widget), width, height);
+  gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (osk_widget));
+  gtk_widget_show_all (window);
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  return osk_widget;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  g_autoptr (GOptionContext) opt_context = NULL;
+  g_autoptr (GError) err = NULL;
+  g_autofree char *trace = NULL;
+  g_autofree char *words_path = NULL;
+  g_auto (GStrv) words = NULL;
+  g_autofree double *weights = NULL;
+  g_auto (GStrv) lines = NULL;
+  g_autoptr (GString) prefix = g_string_new ("");
+  PosOskWidget *osk_widget = NULL;
+  guint n_touches = 0, n_geometric = 0, n_adaptive = 0;
+
+  const GOptionEntry options [] = {
+    {"words", 'w', 0, G_OPTION_ARG_FILENAME, &words_path,
+     "Word list to estimate the next characters from", NULL},
+    { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+  };
+
+  opt_context = g_option_context_new ("TRACE - evaluate adaptive key hit targets");
+  g_option_context_add_main_entries (opt_context, options, NULL);
+  if (!g_option_context_parse (opt_context, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+
+  if (argc != 2 || words_path == NULL) {
+    g_printerr ("Usage: %s --words WORDS TRACE\n", g_get_prgname ());
+    return EXIT_FAILURE;
+  }
+
+  gtk_init (&argc, &argv);
+  pos_init ();
+
+  if (!load_words (words_path, &words, &weights, &err) ||
+      !g_file_get_contents (argv[1], &trace, NULL, &err)) {
+    g_printerr ("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+
+  lines = g_strsplit (trace, "\n", -1);
+  for (int i = 0; lines[i]; i++) {
+    g_auto (GStrv) fields = g_strsplit_set (g_strstrip (lines[i]), " \t", -1);
+    g_autoptr (GHashTable) next_chars = NULL;
+    g_autofree char *intended = NULL;
+    const char *geometric, *adaptive;
+    double x, y;
+
+    if (g_strv_length (fields) < 3)
+      continue;
+
+    if (g_str_equal (fields[0], "#")) {
+      if (g_str_equal (fields[1], "layout") && fields[3] && fields[4] && osk_widget == NULL) {
+        osk_widget = create_osk_widget (fields[2], atoi (fields[3]), atoi (fields[4]), &err);
+        if (osk_widget == NULL) {
+          g_printerr ("%s\n", err->message);
+          return EXIT_FAILURE;
+        }
+      }
+      continue;
+    }
+
+    if (osk_widget == NULL) {
+      g_printerr ("Trace lacks a layout line\n");
+      return EXIT_FAILURE;
+    }
+
+    x = g_ascii_strtod (fields[0], NULL);
+    y = g_ascii_strtod (fields[1], NULL);
+    intended = g_utf8_strdown (fields[2], -1);
+
+    pos_osk_widget_set_next_chars (osk_widget, NULL);
+    geometric = pos_osk_widget_get_symbol_at (osk_widget, x, y);
+
+    next_chars = pos_completer_next_chars_from_words (prefix->str,
+                                                      (const char * const *)words,
+                                                      weights);
+    pos_osk_widget_set_next_chars (osk_widget, next_chars);
+    adaptive = pos_osk_widget_get_symbol_at (osk_widget, x, y);
+
+    n_touches++;
+    if (g_strcmp0 (geometric, intended))
+      n_geometric++;
+    if (g_strcmp0 (adaptive, intended))
+      n_adaptive++;
+
+    /* Track the word typed so far as the completer would */
+    if (pos_completer_symbol_is_word_separator (intended, NULL))
+      g_string_truncate (prefix, 0);
+    else
+      g_string_append (prefix, intended);
+  }
+
+  if (n_touches == 0) {
+    g_printerr ("No touches in trace\n");
+    return EXIT_FAILURE;
+  }
+
+  g_print ("Touches:   %u\n", n_touches);
+  g_print ("Geometric: %u errors (%.2f%%)\n", n_geometric, 100.0 * n_geometric / n_touches);
+  g_print ("Adaptive:  %u errors (%.2f%%)\n", n_adaptive, 100.0 * n_adaptive / n_touches);
+
+  return EXIT_SUCCESS;
+}